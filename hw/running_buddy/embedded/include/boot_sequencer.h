@@ -0,0 +1,71 @@
+#ifndef BOOT_SEQUENCER
+#define BOOT_SEQUENCER
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BOOT_MAX_PHASES 12
+
+enum class boot_status : uint8_t
+{
+  DONE,
+  // run the phase again on the next step
+  WAIT,
+  FAILED
+};
+
+struct boot_phase
+{
+  const char *name;
+  // elapsed_ms counts from the first run of the phase
+  boot_status (*run)(uint32_t elapsed_ms);
+};
+
+/**
+ * runs boot phases one step at a time from loop()
+ *
+ * a phase that is waiting on hardware returns WAIT instead of blocking, so
+ * whatever earlier phases started (sampling, LEDs, logging) keeps running
+ * on the timer. the time spent in each phase is kept for report().
+ */
+class boot_sequencer
+{
+public:
+  boot_sequencer(const boot_phase *phases, size_t count);
+
+  void begin(uint32_t now_ms);
+  // runs the current phase once, true once every phase is done
+  bool step(uint32_t now_ms);
+
+  bool done() const
+  {
+    return current == count;
+  }
+
+  bool failed() const
+  {
+    return has_failed;
+  }
+
+  uint32_t total_ms() const
+  {
+    return finished_ms - start_ms;
+  }
+
+  // "boot,<phase>,<ms>" per phase then "boot,total,<ms>"
+  void report(Print &out) const;
+
+private:
+  const boot_phase *phases;
+  size_t count;
+  size_t current = 0;
+  bool has_failed = false;
+  bool phase_started = false;
+  uint32_t start_ms = 0;
+  uint32_t phase_start_ms = 0;
+  uint32_t finished_ms = 0;
+  uint32_t durations[BOOT_MAX_PHASES] = {};
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef CONFIG
+#define CONFIG
+
+// imu acquisition
+#define IMU_ODR_HZ 104
+// data sets buffered in the FIFO before it is drained, ~77 ms at 104 Hz
+#define IMU_FIFO_WATERMARK 8
+#define IMU_POLL_MS 10
+// fast mode I2C, which the LSM6DS3 and the carrier's other sensors support.
+// a drain of 9 sets then takes ~3 ms instead of ~11 ms, less than a poll
+#define IMU_I2C_CLOCK_HZ 400000
+// MCU pin wired to the LSM6DS3 INT1, -1 polls the FIFO status instead
+#ifndef IMU_INT_PIN
+#define IMU_INT_PIN -1
+#endif
+// 1 also prints every sample on serial as "x, y, z, gx, gy, gz" in g and
+// dps, the rows python/data_logger.py records
+#ifndef SERIAL_CSV
+#define SERIAL_CSV 0
+#endif
+
+// step detection, see include/step_detector.h
+// sampling period when the FIFO is not available
+#define STEP_SAMPLE_MS 100
+// time constants of the smoothing, the gravity baseline and the variance
+#define STEP_SMOOTH_MS 30
+#define STEP_BASELINE_MS 1500
+#define STEP_VARIANCE_MS 2000
+// peak and valley thresholds in standard deviations, peaks below
+// STEP_MIN_PEAK_G (g) are noise
+#define STEP_PEAK_SIGMA 0.6f
+#define STEP_VALLEY_SIGMA 0.2f
+#define STEP_MIN_PEAK_G 0.08f
+// a peak is over once the signal fell this share of the threshold below it
+#define STEP_PEAK_DROP 0.5f
+// peaks are ignored for this share of the step interval after a step
+#define STEP_REFRACTORY 0.6f
+// 300 and 30 steps/min, a longer pause resets the cadence
+#define STEP_MIN_INTERVAL_MS 200
+#define STEP_MAX_INTERVAL_MS 2000
+// intervals this many times the usual one are taken as missed steps
+#define STEP_LONG_INTERVAL 1.6f
+#define STEP_CADENCE_WEIGHT 0.3f
+
+// the moving mean detector the one above replaced, kept in tools/bench
+#define ACCEL_QUEUE_SIZE 20
+#define STEP_THRESHOLD 0.3
+#define DELTA_STEP_MS 350
+
+// turn detection, see include/turn_detector.h
+// time constants of the gravity estimate, the yaw rate, its mean over a
+// stride and the gyro bias
+#define TURN_GRAVITY_MS 1000
+#define TURN_SMOOTH_MS 150
+#define TURN_MEAN_MS 1000
+#define TURN_BIAS_MS 5000
+// the bias is learned while the mean yaw rate is below this
+#define TURN_BIAS_GATE_DPS 8.0f
+#define TURN_START_DPS 30.0f
+#define TURN_START_DEG 10.0f
+#define TURN_END_DPS 15.0f
+#define TURN_END_MS 200
+
+// stride and pace, see include/stride_estimator.h
+// Weinberg constant until the runner calibrated theirs, and its bounds
+#ifndef STRIDE_K
+#define STRIDE_K 0.5f
+#endif
+#define STRIDE_K_MIN 0.2f
+#define STRIDE_K_MAX 1.2f
+// time constant of the smoothed speed
+#define STRIDE_PACE_MS 10000
+// a calibration run is this long, one lap of a track
+#ifndef STRIDE_CALIBRATION_M
+#define STRIDE_CALIBRATION_M 400.0f
+#endif
+#define STRIDE_CALIBRATION_MIN_STEPS 20
+
+// the week2 accelerometer turn detector, kept in tools/bench
+#define TURN_QUEUE_SIZE 20
+#define LEFT_TURN_THRESHOLD -0.05
+#define RIGHT_TURN_THRESHOLD 0.05
+#define DELTA_TURN 100
+
+#endif
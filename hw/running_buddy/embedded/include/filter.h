@@ -0,0 +1,60 @@
+#ifndef FILTER
+#define FILTER
+
+#include <limits>
+
+#include "running_stats.h"
+#include "vec3.h"
+
+// magnitude of the sample when normalizing, otherwise the plain sum. single
+// precision and inv_sqrt(), the SAMD21 emulates every float operation
+inline float sample_value(const float *data, size_t len, bool normalize = true)
+{
+  float sum = 0.0f;
+  for (size_t i = 0; i < len; i++)
+  {
+    sum += normalize ? data[i] * data[i] : data[i];
+  }
+  if (!normalize)
+  {
+    return sum;
+  }
+  return sum > 0.0f ? sum * inv_sqrt(sum) : 0.0f;
+}
+
+/**
+ * pushes val into the window and checks it against the window mean
+ *
+ * returns true when the mean-removed value lies within
+ * [max_threshold, min_threshold] and at least delta ms have passed since
+ * last_time. nothing is reported until the window has been filled and
+ * one sample has left it.
+ */
+template <typename T, size_t N>
+bool data_filter(running_stats<T, N> &hist_data, const int &delta,
+                 const T &val, uint32_t &last_time, const uint32_t &curr_time,
+                 const T &min_threshold = std::numeric_limits<T>::max(),
+                 const T &max_threshold = std::numeric_limits<T>::min())
+{
+  hist_data.push(val);
+  if (hist_data.count() <= N)
+  {
+    return false;
+  }
+  if (last_time + delta > curr_time)
+  {
+    return false;
+  }
+  T avg = hist_data.mean();
+  avg = avg < 0 ? -avg : avg;
+  T normalized_val = val + (val < 0 ? avg : -avg);
+
+  if (normalized_val > min_threshold || normalized_val < max_threshold)
+  {
+    return false;
+  }
+  last_time = curr_time;
+  return true;
+}
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef FIXED_STRING
+#define FIXED_STRING
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * fixed-capacity string with stream style formatting and no heap use
+ *
+ * output past the capacity is dropped and flagged by truncated(). floats
+ * are formatted by hand since newlib's printf allocates for them.
+ */
+template <size_t N>
+class fixed_string
+{
+  static_assert(N > 1, "capacity must leave room for the terminator");
+
+public:
+  fixed_string()
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    len = 0;
+    buf[0] = '\0';
+    overflow = false;
+  }
+
+  const char *c_str() const
+  {
+    return buf;
+  }
+
+  size_t size() const
+  {
+    return len;
+  }
+
+  static constexpr size_t capacity()
+  {
+    return N - 1;
+  }
+
+  bool truncated() const
+  {
+    return overflow;
+  }
+
+  // digits after the decimal point for floats, 2 like Arduino's Print
+  void set_precision(uint8_t digits)
+  {
+    precision = digits > 9 ? 9 : digits;
+  }
+
+  fixed_string &operator<<(const char *str)
+  {
+    while (*str)
+    {
+      put(*str++);
+    }
+    return *this;
+  }
+
+  fixed_string &operator<<(char c)
+  {
+    put(c);
+    return *this;
+  }
+
+  fixed_string &operator<<(int val)
+  {
+    return append_signed(val);
+  }
+
+  fixed_string &operator<<(long val)
+  {
+    return append_signed(val);
+  }
+
+  fixed_string &operator<<(long long val)
+  {
+    return append_signed(val);
+  }
+
+  fixed_string &operator<<(unsigned int val)
+  {
+    return append_unsigned(val);
+  }
+
+  fixed_string &operator<<(unsigned long val)
+  {
+    return append_unsigned(val);
+  }
+
+  fixed_string &operator<<(unsigned long long val)
+  {
+    return append_unsigned(val);
+  }
+
+  fixed_string &operator<<(double val)
+  {
+    if (val != val)
+    {
+      return *this << "nan";
+    }
+    if (val < 0)
+    {
+      put('-');
+      val = -val;
+    }
+    if (val > 4294967295.0)
+    {
+      return *this << "ovf";
+    }
+    uint32_t scale = 1;
+    for (uint8_t i = 0; i < precision; i++)
+    {
+      scale *= 10;
+    }
+    uint32_t whole = static_cast<uint32_t>(val);
+    double rest = (val - whole) * scale + 0.5;
+    uint32_t frac = static_cast<uint32_t>(rest);
+    if (frac >= scale)
+    {
+      whole++;
+      frac -= scale;
+    }
+    append_unsigned(whole);
+    if (precision > 0)
+    {
+      put('.');
+      for (uint32_t div = scale / 10; div > 0; div /= 10)
+      {
+        put(static_cast<char>('0' + (frac / div) % 10));
+      }
+    }
+    return *this;
+  }
+
+  fixed_string &operator<<(float val)
+  {
+    return *this << static_cast<double>(val);
+  }
+
+private:
+  void put(char c)
+  {
+    if (len + 1 >= N)
+    {
+      overflow = true;
+      return;
+    }
+    buf[len++] = c;
+    buf[len] = '\0';
+  }
+
+  fixed_string &append_signed(long long val)
+  {
+    if (val < 0)
+    {
+      put('-');
+      return append_unsigned(0ULL - static_cast<unsigned long long>(val));
+    }
+    return append_unsigned(static_cast<unsigned long long>(val));
+  }
+
+  fixed_string &append_unsigned(unsigned long long val)
+  {
+    char digits[20];
+    size_t n = 0;
+    // stay on 32 bit division when possible, it is much cheaper on the M0+
+    if (val <= UINT32_MAX)
+    {
+      uint32_t small = static_cast<uint32_t>(val);
+      do
+      {
+        digits[n++] = static_cast<char>('0' + small % 10);
+        small /= 10;
+      } while (small > 0);
+    }
+    else
+    {
+      do
+      {
+        digits[n++] = static_cast<char>('0' + val % 10);
+        val /= 10;
+      } while (val > 0);
+    }
+    while (n > 0)
+    {
+      put(digits[--n]);
+    }
+    return *this;
+  }
+
+  char buf[N];
+  size_t len;
+  uint8_t precision = 2;
+  bool overflow;
+};
+
+#endif
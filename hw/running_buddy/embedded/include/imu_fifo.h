@@ -0,0 +1,100 @@
+#ifndef IMU_FIFO
+#define IMU_FIFO
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vec3.h"
+
+// LSM6DS3 on the carrier's I2C bus
+#define IMU_I2C_ADDRESS 0x6A
+
+#define IMU_REG_FIFO_CTRL1 0x06
+#define IMU_REG_FIFO_CTRL2 0x07
+#define IMU_REG_FIFO_CTRL3 0x08
+#define IMU_REG_FIFO_CTRL4 0x09
+#define IMU_REG_FIFO_CTRL5 0x0A
+#define IMU_REG_INT1_CTRL 0x0D
+#define IMU_REG_WHO_AM_I 0x0F
+#define IMU_REG_CTRL1_XL 0x10
+#define IMU_REG_CTRL2_G 0x11
+#define IMU_REG_CTRL3_C 0x12
+#define IMU_REG_FIFO_STATUS1 0x3A
+#define IMU_REG_FIFO_DATA_OUT_L 0x3E
+
+#define IMU_FIFO_STATUS2_FTH 0x80
+#define IMU_FIFO_STATUS2_OVER 0x40
+#define IMU_FIFO_STATUS2_EMPTY 0x10
+
+// gyroscope x, y, z then accelerometer x, y, z
+#define IMU_FIFO_SET_WORDS 6
+#define IMU_FIFO_BATCH 32
+// sets per I2C burst, keeps each read inside the Wire buffer
+#define IMU_FIFO_CHUNK_SETS 8
+
+struct imu_sample
+{
+  uint32_t t_us;
+  vec3 accel; // g
+  vec3 gyro;  // dps
+};
+
+struct imu_fifo_stats
+{
+  uint32_t drains = 0;
+  uint32_t batches = 0;
+  uint32_t samples = 0;
+  uint32_t overruns = 0;
+  uint32_t realigned_words = 0;
+  uint32_t i2c_errors = 0;
+  uint32_t max_fifo_sets = 0;
+  uint32_t last_drain_us = 0;
+  uint32_t max_drain_us = 0;
+};
+
+typedef void (*imu_batch_handler)(const imu_sample *samples, size_t count);
+
+/**
+ * LSM6DS3 FIFO acquisition
+ *
+ * accelerometer (+-4 g) and gyroscope (2000 dps) run at odr_hz and are
+ * queued in the sensor's FIFO in continuous mode. poll() drains the FIFO in
+ * I2C bursts once it holds watermark_sets data sets, either when the INT1
+ * watermark interrupt fired or INT1 is still high, or, without an interrupt
+ * pin, when FIFO_STATUS2 reports the watermark. samples reach the handler
+ * in batches of up to IMU_FIFO_BATCH, timestamped from the drain time and
+ * the ODR.
+ */
+class imu_fifo
+{
+public:
+  bool begin(uint16_t odr_hz, uint16_t watermark_sets, int interrupt_pin = -1);
+  // returns the number of samples handed to the handler
+  size_t poll(imu_batch_handler handler);
+
+  uint32_t sample_period_us() const
+  {
+    return period_us;
+  }
+
+  const imu_fifo_stats &stats() const
+  {
+    return counters;
+  }
+
+private:
+  bool read_registers(uint8_t reg, uint8_t *data, size_t len);
+  bool write_register(uint8_t reg, uint8_t val);
+  uint32_t stamp(uint32_t anchor_us);
+
+  uint32_t period_us = 0;
+  uint16_t watermark = 0;
+  int interrupt_pin = -1;
+  bool timed = false;
+  uint32_t last_t_us = 0;
+
+  imu_sample batch[IMU_FIFO_BATCH];
+  imu_fifo_stats counters;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef LED_EFFECTS
+#define LED_EFFECTS
+
+#include <Adafruit_DotStar.h>
+#include <FastLED.h>
+#include <stdint.h>
+
+#define LED_CARRIER_PIXELS 5
+// carrier pixels plus the strip, which is animated as a whole
+#define LED_CHANNELS (LED_CARRIER_PIXELS + 1)
+#define LED_STRIP_CHANNEL LED_CARRIER_PIXELS
+
+enum class effect_kind : uint8_t
+{
+  SOLID,
+  BLINK,
+  FADE,
+  PULSE
+};
+
+/**
+ * time based animation of one channel
+ *
+ * blink and pulse repeat every period_ms for cycles periods (0 repeats
+ * forever) and then go dark, fade goes from `from` to `color` over
+ * period_ms and holds it.
+ */
+struct led_effect
+{
+  effect_kind kind = effect_kind::SOLID;
+  CRGB color;
+  CRGB from;
+  uint16_t period_ms = 0;
+  uint16_t cycles = 0;
+
+  static led_effect solid(const CRGB &color);
+  static led_effect blink(const CRGB &color, uint16_t period_ms, uint16_t cycles = 0);
+  static led_effect fade(const CRGB &from, const CRGB &to, uint16_t duration_ms);
+  // triangle wave in brightness, for turn signals
+  static led_effect pulse(const CRGB &color, uint16_t period_ms, uint16_t cycles = 0);
+
+  // color elapsed_ms into the effect
+  CRGB at(uint32_t elapsed_ms) const;
+  bool finished(uint32_t elapsed_ms) const;
+};
+
+struct led_stats
+{
+  uint32_t frames = 0;
+  uint32_t carrier_shows = 0;
+  uint32_t strip_shows = 0;
+  uint32_t last_frame_us = 0;
+  uint32_t max_frame_us = 0;
+};
+
+/**
+ * non-blocking LED animator for the carrier pixels and the FastLED strip
+ *
+ * play() only records the effect, frame() is called from the timer at a
+ * fixed rate, renders every channel and shows a device only when one of
+ * its colors changed.
+ */
+class led_engine
+{
+public:
+  void begin(Adafruit_DotStar &carrier_leds, CRGB *strip, uint16_t strip_len);
+
+  // channel is a carrier pixel or LED_STRIP_CHANNEL
+  void play(uint8_t channel, const led_effect &effect);
+  // the color the channel currently shows
+  CRGB color(uint8_t channel) const;
+  void frame(uint32_t now_ms);
+
+  const led_stats &stats() const
+  {
+    return counters;
+  }
+
+private:
+  struct channel_state
+  {
+    led_effect effect;
+    uint32_t start_ms = 0;
+    bool started = false;
+    bool done = true;
+    CRGB shown;
+  };
+
+  Adafruit_DotStar *carrier_leds = nullptr;
+  CRGB *strip = nullptr;
+  uint16_t strip_len = 0;
+  channel_state channels[LED_CHANNELS];
+  led_stats counters;
+};
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef LOG_FORMAT
+#define LOG_FORMAT
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * binary log records written to the SD card
+ *
+ * every record starts with a record_header whose length covers the whole
+ * record, so readers can skip types they do not know. each logging session
+ * starts with a session record carrying the magic, format version and the
+ * fixed point scale of the sensor payloads, readers that lose their place
+ * resync on it. all fields are little endian.
+ *
+ * records do not cross the SD card's 512 byte blocks. a 0 where a record
+ * would start is one byte of padding up to the end of a block.
+ *
+ * version 2 added the gyro record, gyro_lsb_per_dps to the session and the
+ * padding.
+ */
+
+#define LOG_MAGIC 0x4252 // "RB"
+#define LOG_FORMAT_VERSION 2
+
+// LSM6DS3 at +-4 g, as configured by Arduino_LSM6DS3
+#define ACCEL_LSB_PER_G 8192
+// the FIFO runs the gyroscope at +-2000 dps, which fits +-2048
+#define GYRO_LSB_PER_DPS 16
+
+enum class record_type : uint8_t
+{
+  SESSION = 0,
+  ACCEL = 1,
+  STEP = 2,
+  MODE = 3,
+  TOUCH = 4,
+  TURN = 5,
+  STRIDE = 6,
+  GYRO = 7,
+};
+
+enum class mode_kind : uint8_t
+{
+  DISPLAY = 0,
+  LIGHT = 1,
+};
+
+#define LIGHT_OFF 0
+#define LIGHT_NIGHT 1
+#define LIGHT_DAY 2
+
+struct __attribute__((packed)) record_header
+{
+  uint8_t length;
+  uint8_t type;
+  uint32_t timestamp_ms;
+};
+
+struct __attribute__((packed)) session_record
+{
+  record_header header;
+  uint16_t magic;
+  uint8_t version;
+  uint8_t reserved;
+  uint16_t accel_lsb_per_g;
+  // since version 2
+  uint16_t gyro_lsb_per_dps;
+};
+
+// a version 1 session ends before gyro_lsb_per_dps
+#define SESSION_RECORD_V1_SIZE (sizeof(session_record) - sizeof(uint16_t))
+
+struct __attribute__((packed)) accel_record
+{
+  record_header header;
+  int16_t accel[3];
+};
+
+// written with every accel record, same timestamp
+struct __attribute__((packed)) gyro_record
+{
+  record_header header;
+  int16_t gyro[3];
+};
+
+struct __attribute__((packed)) step_record
+{
+  record_header header;
+  uint32_t steps;
+};
+
+struct __attribute__((packed)) mode_record
+{
+  record_header header;
+  uint8_t kind;
+  uint8_t value;
+};
+
+struct __attribute__((packed)) touch_record
+{
+  record_header header;
+  uint8_t pad;
+};
+
+// written when a turn ends
+struct __attribute__((packed)) turn_record
+{
+  record_header header;
+  // heading change in 0.1 degrees, positive to the left
+  int16_t angle_ddeg;
+  uint16_t duration_ms;
+};
+
+// written with every step
+struct __attribute__((packed)) stride_record
+{
+  record_header header;
+  uint16_t stride_mm;
+  // since the session started, in 0.1 m
+  uint32_t distance_dm;
+  // smoothed, 0 while stopped
+  uint16_t pace_s_per_km;
+};
+
+template <typename R>
+void init_record(R &record, record_type type, uint32_t timestamp_ms)
+{
+  static_assert(sizeof(R) <= UINT8_MAX, "record too long for its length prefix");
+  record.header.length = sizeof(R);
+  record.header.type = static_cast<uint8_t>(type);
+  record.header.timestamp_ms = timestamp_ms;
+}
+
+inline int16_t to_fixed(float val, int32_t lsb_per_unit)
+{
+  float scaled = val * lsb_per_unit;
+  scaled += scaled < 0 ? -0.5f : 0.5f;
+  if (scaled > INT16_MAX)
+  {
+    return INT16_MAX;
+  }
+  if (scaled < INT16_MIN)
+  {
+    return INT16_MIN;
+  }
+  return static_cast<int16_t>(scaled);
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef MEM_STATS
+#define MEM_STATS
+
+#include <stdint.h>
+
+/**
+ * heap instrumentation
+ *
+ * malloc, calloc, realloc and free are wrapped (with -Wl,--wrap on the
+ * device, by interposing glibc on the native build) so every heap
+ * allocation, including operator new, is counted. allocations made inside
+ * newlib through _malloc_r are not seen on the device.
+ */
+struct mem_stats
+{
+  uint32_t allocations;
+  uint32_t frees;
+  uint32_t heap_in_use;
+  uint32_t heap_high_water;
+};
+
+const mem_stats &get_mem_stats();
+
+inline uint32_t allocation_count()
+{
+  return get_mem_stats().allocations;
+}
+
+// restarts the high water mark from the current heap use
+void reset_heap_high_water();
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef ORIENTATION
+#define ORIENTATION
+
+#include <stdint.h>
+
+#include "vec3.h"
+
+// filter gain, the rate in rad/s at which the accelerometer pulls the
+// integrated gyro towards gravity
+#ifndef ORIENTATION_BETA
+#define ORIENTATION_BETA 0.1f
+#endif
+// the gain fades out as |accel| moves this far from 1 g, so impacts do not
+// tilt the estimate
+#ifndef ORIENTATION_ACCEL_TOLERANCE_G
+#define ORIENTATION_ACCEL_TOLERANCE_G 0.5f
+#endif
+// longer gaps between samples are not integrated
+#define ORIENTATION_MAX_DT_US 100000
+
+struct quat
+{
+  float w = 1.0f;
+  float x = 0.0f;
+  float y = 0.0f;
+  float z = 0.0f;
+};
+
+/**
+ * accelerometer + gyroscope orientation, Madgwick's gradient descent filter
+ *
+ * the gyroscope is integrated into a quaternion and one gradient step per
+ * sample pulls it towards the tilt the accelerometer measures. yaw is not
+ * observable without a magnetometer and drifts with the gyro bias, which
+ * is fine for turns, they are short.
+ *
+ * single precision throughout with no doubles, sqrtf or divisions in the
+ * update, the SAMD21 emulates every float operation.
+ * world frame is z up, x/y an arbitrary horizontal heading.
+ */
+class orientation
+{
+public:
+  // accel in g, gyro in dps, t_us the sample time
+  void update(const vec3 &accel, const vec3 &gyro, uint32_t t_us);
+  void reset();
+
+  bool ready() const
+  {
+    return started;
+  }
+
+  const quat &attitude() const
+  {
+    return q;
+  }
+
+  // a sensor frame vector in the world frame
+  vec3 to_world(const vec3 &v) const;
+  // acceleration without gravity in the world frame, g
+  vec3 linear_accel(const vec3 &accel) const;
+  // rate of turn about world up, dps, positive counterclockwise from above
+  float yaw_rate(const vec3 &gyro) const;
+
+private:
+  bool started = false;
+  uint32_t last_us = 0;
+  quat q;
+};
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef RUNNING_STATS
+#define RUNNING_STATS
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * fixed-capacity sliding window over the last N samples
+ *
+ * sum, mean, variance, min and max are all O(1) per push with no heap use.
+ * min / max are tracked with monotonic wedges (amortized O(1)), and the
+ * running sums are recomputed from the buffer once per lap of the ring so
+ * floating point drift from add / subtract never accumulates.
+ */
+template <typename T, size_t N>
+class running_stats
+{
+  static_assert(N > 0, "window size must be positive");
+
+public:
+  running_stats()
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    head = 0;
+    pushed = 0;
+    total = 0;
+    total_sq = 0;
+    min_front = min_len = 0;
+    max_front = max_len = 0;
+  }
+
+  void push(const T &val)
+  {
+    if (full())
+    {
+      const T &old = data[head];
+      total -= old;
+      total_sq -= old * old;
+      // the slot being overwritten holds the sample leaving the window
+      if (min_len > 0 && min_idx[min_front] == head)
+      {
+        min_front = (min_front + 1) % N;
+        min_len--;
+      }
+      if (max_len > 0 && max_idx[max_front] == head)
+      {
+        max_front = (max_front + 1) % N;
+        max_len--;
+      }
+    }
+
+    while (min_len > 0 && !(at(min_idx[(min_front + min_len - 1) % N]) < val))
+    {
+      min_len--;
+    }
+    while (max_len > 0 && !(val < at(max_idx[(max_front + max_len - 1) % N])))
+    {
+      max_len--;
+    }
+
+    data[head] = val;
+    total += val;
+    total_sq += val * val;
+    min_idx[(min_front + min_len) % N] = head;
+    min_len++;
+    max_idx[(max_front + max_len) % N] = head;
+    max_len++;
+
+    head = (head + 1) % N;
+    if (pushed != UINT32_MAX)
+    {
+      pushed++;
+    }
+    if (head == 0)
+    {
+      resync();
+    }
+  }
+
+  // number of samples currently in the window
+  size_t size() const
+  {
+    return pushed < N ? pushed : N;
+  }
+
+  // number of samples pushed since the last reset, saturating
+  uint32_t count() const
+  {
+    return pushed;
+  }
+
+  bool full() const
+  {
+    return pushed >= N;
+  }
+
+  static constexpr size_t capacity()
+  {
+    return N;
+  }
+
+  T sum() const
+  {
+    return total;
+  }
+
+  T mean() const
+  {
+    return size() == 0 ? T(0) : total / T(size());
+  }
+
+  // population variance of the window
+  T variance() const
+  {
+    const size_t n = size();
+    if (n == 0)
+    {
+      return T(0);
+    }
+    const T avg = total / T(n);
+    const T var = total_sq / T(n) - avg * avg;
+    return var < T(0) ? T(0) : var;
+  }
+
+  T min() const
+  {
+    return min_len == 0 ? T(0) : at(min_idx[min_front]);
+  }
+
+  T max() const
+  {
+    return max_len == 0 ? T(0) : at(max_idx[max_front]);
+  }
+
+  // most recently pushed sample
+  T last() const
+  {
+    return pushed == 0 ? T(0) : data[(head + N - 1) % N];
+  }
+
+private:
+  const T &at(size_t slot) const
+  {
+    return data[slot];
+  }
+
+  void resync()
+  {
+    T new_total = 0;
+    T new_total_sq = 0;
+    for (size_t i = 0; i < N; i++)
+    {
+      new_total += data[i];
+      new_total_sq += data[i] * data[i];
+    }
+    total = new_total;
+    total_sq = new_total_sq;
+  }
+
+  T data[N];
+  size_t head;
+  uint32_t pushed;
+  T total;
+  T total_sq;
+
+  size_t min_idx[N];
+  size_t min_front;
+  size_t min_len;
+  size_t max_idx[N];
+  size_t max_front;
+  size_t max_len;
+};
+
+#endif
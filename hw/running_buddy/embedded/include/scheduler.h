@@ -0,0 +1,100 @@
+#ifndef SCHEDULER
+#define SCHEDULER
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCHEDULER_MAX_TASKS 8
+
+// lower runs first when several tasks are due
+enum class task_priority : uint8_t
+{
+  // IMU draining, a late drain loses samples
+  SENSOR,
+  // LED frames
+  LEDS,
+  // display redraws
+  DISPLAY,
+  // stats and reports
+  BACKGROUND,
+};
+
+// counted since the task was added
+struct task_stats
+{
+  uint32_t runs;
+  uint64_t total_us;
+  uint32_t max_us;
+  // from the time the task was due to the time it started
+  uint32_t max_late_us;
+  // finished more than a period after it was due
+  uint32_t deadline_misses;
+  // ran longer than its budget
+  uint32_t overruns;
+  // periods that passed without a run, the task was a whole period late
+  uint32_t skipped;
+};
+
+struct task
+{
+  const char *name;
+  void (*run)();
+  uint32_t period_us;
+  task_priority priority;
+  // longest run expected, 0 for no budget
+  uint32_t budget_us;
+  uint32_t due_us;
+  task_stats stats;
+};
+
+/**
+ * cooperative fixed priority scheduler for the periodic work of loop()
+ *
+ * tick() runs the tasks that are due, highest priority first, and looks at
+ * the clock again after each one, so a sensor task that came due while the
+ * display was redrawing goes before any other display or background task. a
+ * task cannot be interrupted, but long work can call yield() between steps
+ * to let due tasks of a higher priority run first.
+ *
+ * a task's deadline is its next release: finishing later is a miss, and
+ * releases that passed entirely are skipped rather than run back to back.
+ */
+class scheduler
+{
+public:
+  // false when the table is full. the first run is one period from now
+  bool every(const char *name, uint32_t period_ms, task_priority priority, void (*run)(), uint32_t budget_us = 0);
+
+  // runs every due task, returns how many ran
+  size_t tick();
+  // runs the due tasks of a higher priority than the caller, and than the
+  // task running if yield() is called from inside one
+  void yield(task_priority caller);
+
+  size_t count() const
+  {
+    return task_count;
+  }
+
+  const task &at(size_t i) const
+  {
+    return tasks[i];
+  }
+
+  // "sched,<name>,runs=...,avg_us=...,max_us=...,max_late_us=...,
+  // deadline_misses=...,overruns=...,skipped=..." per task
+  void report(Print &out) const;
+
+private:
+  // highest priority due task above the limit and not in the skip mask, or -1
+  int next_due(uint32_t now_us, uint8_t below, uint32_t skip) const;
+  void run(task &t, uint32_t start_us);
+
+  task tasks[SCHEDULER_MAX_TASKS];
+  size_t task_count = 0;
+  // priority of the task running, one past the lowest when none is
+  uint8_t running = static_cast<uint8_t>(task_priority::BACKGROUND) + 1;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef SD_LOGGER
+#define SD_LOGGER
+
+#include <Arduino.h>
+#include <SD.h>
+
+#define SD_BLOCK_SIZE 512
+
+struct logger_stats
+{
+  uint32_t records = 0;
+  uint32_t dropped_records = 0;
+  uint32_t bytes_written = 0;
+  uint32_t flushes = 0;
+  uint32_t syncs = 0;
+  uint32_t write_errors = 0;
+  // zeros at the end of blocks that had no room for the next record
+  uint32_t padding_bytes = 0;
+  uint32_t last_flush_us = 0;
+  uint32_t max_flush_us = 0;
+  uint32_t total_flush_us = 0;
+};
+
+/**
+ * append-only SD logger with a persistent file handle
+ *
+ * records are copied into one of two SD_BLOCK_SIZE buffers. a buffer is
+ * sealed once it reaches the next block boundary of the file, and sealed
+ * buffers are written from poll(), outside of the sampling callbacks.
+ * poll() also writes partial buffers once they hold flush_size bytes or
+ * are older than flush_interval_ms, and then syncs the directory entry.
+ * a record never spans two blocks: when it does not fit in the rest of the
+ * block, the rest is filled with zeros (see log_format.h) and the block is
+ * sealed, so everything written to the card ends on a record boundary and
+ * the next session appends whole records after it. records that do not fit
+ * in the free buffer space are dropped and counted. end() writes what is
+ * buffered and closes the file, call it before the power goes.
+ */
+class sd_logger
+{
+public:
+  bool begin(const char *file_name, uint32_t flush_interval_ms = 1000,
+             size_t flush_size = SD_BLOCK_SIZE);
+  // len at most SD_BLOCK_SIZE
+  bool write(const void *data, size_t len);
+  void poll();
+  void flush();
+  void end();
+
+  bool is_open() const
+  {
+    return open;
+  }
+
+  const logger_stats &stats() const
+  {
+    return counters;
+  }
+
+private:
+  void seal();
+  void write_out(const uint8_t *data, size_t len);
+
+  File file;
+  bool open = false;
+  uint32_t flush_interval_ms = 0;
+  size_t flush_size = SD_BLOCK_SIZE;
+  uint32_t file_pos = 0;
+
+  alignas(4) uint8_t buffers[2][SD_BLOCK_SIZE];
+  uint8_t active = 0;
+  size_t fill = 0;
+  size_t limit = SD_BLOCK_SIZE;
+  uint32_t first_write_ms = 0;
+
+  bool pending = false;
+  size_t pending_len = 0;
+
+  logger_stats counters;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef STEP_DETECTOR
+#define STEP_DETECTOR
+
+#include <stdint.h>
+
+#include "config.h"
+#include "vec3.h"
+
+/**
+ * counts steps and estimates cadence from accelerometer samples, O(1) per
+ * sample at the sample period it was set up for
+ *
+ * the vertical acceleration, or the magnitude, is smoothed and its
+ * baseline removed. a step is a peak of that signal higher than
+ * STEP_PEAK_SIGMA standard deviations, tracked over the last couple of
+ * seconds, that follows a valley below
+ * -STEP_VALLEY_SIGMA of them. after a step, peaks are ignored for
+ * STEP_REFRACTORY of the usual step interval, so the window narrows at a
+ * sprint and widens when walking.
+ *
+ * the moving average weights are worked out once for the sample period,
+ * so samples are expected evenly spaced, as the IMU FIFO delivers them.
+ */
+class step_detector
+{
+public:
+  explicit step_detector(uint32_t period_us = STEP_SAMPLE_MS * 1000UL);
+  // keeps the counts, only the smoothing changes
+  void set_period_us(uint32_t period_us);
+
+  // returns true when the sample completes a step. counts on the magnitude
+  bool update(const vec3 &accel, uint32_t now_ms);
+  // counts on one axis instead, vertical acceleration from an orientation
+  // estimate, which leaves out the sway and braking the magnitude picks up
+  bool update(float accel_g, uint32_t now_ms);
+  void reset();
+
+  uint32_t steps() const
+  {
+    return count;
+  }
+
+  // steps per minute over the last few steps, 0 when stopped
+  float cadence_spm() const
+  {
+    return interval_ms > 0 ? 60000.0f / interval_ms : 0.0f;
+  }
+
+  // time of the last step's peak, a sample or so before update() reported it
+  uint32_t last_step_ms() const
+  {
+    return step_ms;
+  }
+
+private:
+  void add_interval(uint32_t ms);
+
+  uint32_t period_us;
+  float smooth_weight;
+  float baseline_weight;
+  float variance_weight;
+
+  bool started = false;
+  float smooth = 0;
+  float baseline = 0;
+  float variance = 0;
+
+  // a valley was seen since the last step
+  bool armed = true;
+  bool has_peak = false;
+  float peak = 0;
+  uint32_t peak_ms = 0;
+
+  uint32_t count = 0;
+  uint32_t step_ms = 0;
+  // smoothed step interval, 0 until two steps were close enough together
+  float interval_ms = 0;
+  // intervals in a row much longer than interval_ms
+  uint8_t long_intervals = 0;
+  // a peak came in the refractory window since the last step
+  bool blocked = false;
+  // steps in a row that had one
+  uint8_t blocked_steps = 0;
+};
+
+#endif
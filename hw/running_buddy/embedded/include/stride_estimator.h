@@ -0,0 +1,92 @@
+#ifndef STRIDE_ESTIMATOR
+#define STRIDE_ESTIMATOR
+
+#include <stdint.h>
+
+#include "config.h"
+
+/**
+ * stride length, distance and pace from step events, O(1) per sample
+ *
+ * between two steps update() keeps only the highest and lowest vertical
+ * acceleration. at a step, Weinberg's model turns their difference into
+ * the length of that step (what running watches call the stride),
+ * k * (max - min)^(1/4) with the difference in m/s^2. k depends on the
+ * runner's legs and gait and is calibrated by running a known distance.
+ * speed is each stride times the cadence, which the step detector keeps
+ * steady over a missed step, smoothed with a time constant of
+ * STRIDE_PACE_MS. no run history is kept.
+ */
+class stride_estimator
+{
+public:
+  // vertical acceleration without gravity, every sample
+  void update(float vertical_g);
+  // a step was detected, returns its stride in m. cadence_spm is 0 while
+  // the step detector has none
+  float step(uint32_t now_ms, float cadence_spm);
+  // clears the run, keeps k
+  void reset();
+
+  float k() const
+  {
+    return weinberg_k;
+  }
+
+  // false when k is out of STRIDE_K_MIN..STRIDE_K_MAX
+  bool set_k(float k);
+
+  float stride_m() const
+  {
+    return stride;
+  }
+
+  float distance_m() const
+  {
+    return distance;
+  }
+
+  // smoothed, 0 while stopped
+  float speed_mps(uint32_t now_ms) const;
+  // seconds per km, 0 while stopped
+  float pace_s_per_km(uint32_t now_ms) const;
+
+  // starts counting strides towards a calibration
+  void calibrate_start();
+  // the distance really run since calibrate_start(), sets k so the strides
+  // add up to it. false when too few steps were taken or k would be out of
+  // range, k is kept then
+  bool calibrate_end(float actual_m);
+
+  bool calibrating() const
+  {
+    return calibrating_now;
+  }
+
+  uint32_t calibration_steps() const
+  {
+    return calibration_count;
+  }
+
+private:
+  float weinberg_k = STRIDE_K;
+
+  // extremes since the last step
+  bool window_empty = true;
+  float window_max = 0;
+  float window_min = 0;
+
+  bool stepped = false;
+  uint32_t step_ms = 0;
+  float stride = 0;
+  float distance = 0;
+  // 0 without a cadence
+  float speed = 0;
+
+  bool calibrating_now = false;
+  uint32_t calibration_count = 0;
+  // sum of (max - min)^(1/4), the strides for k = 1
+  float calibration_sum = 0;
+};
+
+#endif
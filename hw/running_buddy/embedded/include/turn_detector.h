@@ -0,0 +1,102 @@
+#ifndef TURN_DETECTOR
+#define TURN_DETECTOR
+
+#include <stdint.h>
+
+#include "config.h"
+#include "vec3.h"
+
+enum class turn_event : uint8_t
+{
+  NONE,
+  STARTED,
+  ENDED
+};
+
+/**
+ * detects turns from the gyroscope yaw rate, O(1) per sample
+ *
+ * yaw is the rotation about gravity, taken from a low passed accelerometer,
+ * so it does not matter how the carrier is worn. the gyroscope's bias about
+ * that axis is learned while the yaw rate averages out over a stride. a turn starts once
+ * the smoothed rate passed TURN_START_DPS and TURN_START_DEG were turned,
+ * and ends when the rate stayed below TURN_END_DPS for TURN_END_MS or
+ * reversed. angles are positive to the left (counterclockwise from above).
+ */
+class turn_detector
+{
+public:
+  // yaw about gravity from a low passed accel
+  turn_event update(const vec3 &accel, const vec3 &gyro, uint32_t now_ms);
+  // yaw rate about world up in dps, from an orientation estimate. its bias
+  // is learned all the same
+  turn_event update(float yaw_dps, uint32_t now_ms);
+  void reset();
+
+  bool turning() const
+  {
+    return state == TURNING;
+  }
+
+  // 1 for left, -1 for right, of the current or last turn
+  int8_t direction() const
+  {
+    return angle < 0 ? -1 : 1;
+  }
+
+  // angle of the current or last turn
+  float turn_deg() const
+  {
+    return angle;
+  }
+
+  // time from the start to the end of the last turn
+  uint32_t turn_ms() const
+  {
+    return end_ms - start_ms;
+  }
+
+  // integrated since reset, in [0, 360)
+  float heading_deg() const
+  {
+    return heading;
+  }
+
+  float bias_dps() const
+  {
+    return bias;
+  }
+
+  uint32_t turns() const
+  {
+    return count;
+  }
+
+private:
+  enum phase : uint8_t
+  {
+    IDLE,
+    // rate above TURN_START_DPS, not turned far enough yet
+    ONSET,
+    TURNING
+  };
+
+  bool started = false;
+  uint32_t last_ms = 0;
+  vec3 gravity;
+  float bias = 0;
+  float rate = 0;
+  // over about a stride
+  float mean_rate = 0;
+  float heading = 0;
+
+  phase state = IDLE;
+  float angle = 0;
+  uint32_t start_ms = 0;
+  uint32_t end_ms = 0;
+  // rate below TURN_END_DPS since
+  uint32_t slow_ms = 0;
+  uint32_t count = 0;
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef UI
+#define UI
+
+#include <Adafruit_ST7789.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fixed_string.h"
+
+#define UI_CHAR_WIDTH 6
+#define UI_CHAR_HEIGHT 8
+#define UI_MAX_CHARS 16
+#define UI_MAX_TEXT_SIZE 3
+#define UI_MAX_WIDGETS 8
+// width of the line band glyphs are rendered into, the panel width
+#define UI_LINE_WIDTH 240
+// rows cleared at a time after a show(), the render yields between bands
+#define UI_CLEAR_ROWS 40
+
+struct ui_stats
+{
+  // renders that pushed pixels, and those that found nothing to do
+  uint32_t frames = 0;
+  uint32_t idle_frames = 0;
+  uint32_t windows = 0;
+  uint32_t pixels_pushed = 0;
+  uint32_t bytes_pushed = 0;
+  uint32_t last_frame_us = 0;
+  uint32_t max_frame_us = 0;
+};
+
+class ui_screen;
+
+class ui_widget
+{
+public:
+  virtual ~ui_widget() {}
+  // draws whatever changed since the last render
+  virtual void render(ui_screen &screen) = 0;
+  // the panel was cleared to the screen background
+  virtual void invalidate() = 0;
+};
+
+/**
+ * text in a fixed box of capacity characters
+ *
+ * set() only records the text; render() compares it with what the panel
+ * shows and redraws the span of changed glyphs. shorter text is padded
+ * with spaces so stale glyphs are cleared. bg should match the screen
+ * background, the box is assumed blank after the screen is cleared.
+ */
+class ui_label : public ui_widget
+{
+public:
+  ui_label(int16_t x, int16_t y, uint8_t capacity, uint8_t size, uint16_t color, uint16_t bg = 0x0000);
+
+  void set(const char *str);
+  void render(ui_screen &screen) override;
+  void invalidate() override;
+
+private:
+  int16_t x;
+  int16_t y;
+  uint8_t capacity;
+  uint8_t size;
+  uint16_t color;
+  uint16_t bg;
+  char text[UI_MAX_CHARS];
+  char shown[UI_MAX_CHARS];
+};
+
+// label showing a number followed by a unit
+class ui_value : public ui_label
+{
+public:
+  using ui_label::ui_label;
+
+  template <typename T>
+  void set(T val, const char *unit = "", uint8_t precision = 2)
+  {
+    fixed_string<UI_MAX_CHARS + 1> str;
+    str.set_precision(precision);
+    str << val << unit;
+    ui_label::set(str.c_str());
+  }
+};
+
+// 1 bit bitmap drawn once after the screen is cleared
+class ui_bitmap : public ui_widget
+{
+public:
+  ui_bitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color)
+      : x(x), y(y), bitmap(bitmap), w(w), h(h), color(color)
+  {
+  }
+
+  void render(ui_screen &screen) override;
+
+  void invalidate() override
+  {
+    drawn = false;
+  }
+
+private:
+  int16_t x;
+  int16_t y;
+  const uint8_t *bitmap;
+  int16_t w;
+  int16_t h;
+  uint16_t color;
+  bool drawn = false;
+};
+
+/**
+ * retained mode renderer for the ST7789
+ *
+ * show() selects the widgets on the panel, render() clears the panel after
+ * a show() and then lets every widget push what changed. glyphs go out
+ * through a line band as one address window per changed span. between
+ * bands of the clear and between widgets render() calls the yield hook, so
+ * a full redraw does not hold up sampling.
+ */
+class ui_screen
+{
+public:
+  explicit ui_screen(Adafruit_ST7789 &display, uint16_t bg = 0x0000) : display(display), bg(bg) {}
+
+  void show(ui_widget *const *widgets, size_t count);
+  void render();
+
+  void set_yield(void (*fn)())
+  {
+    yield_fn = fn;
+  }
+
+  const ui_stats &stats() const
+  {
+    return counters;
+  }
+
+  // for widgets
+  void draw_text(int16_t x, int16_t y, const char *chars, uint8_t count, uint8_t size, uint16_t color, uint16_t bg);
+  void draw_bitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color);
+
+private:
+  void pushed(uint32_t pixels);
+  void pause();
+
+  Adafruit_ST7789 &display;
+  uint16_t bg;
+  ui_widget *widgets[UI_MAX_WIDGETS] = {};
+  size_t widget_count = 0;
+  bool cleared = false;
+  void (*yield_fn)() = nullptr;
+  uint32_t yielded_us = 0;
+  ui_stats counters;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef VEC3
+#define VEC3
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// one three axis IMU sample, kept on the stack
+struct vec3
+{
+  float v[3] = {0.0f, 0.0f, 0.0f};
+
+  float &operator[](size_t i)
+  {
+    return v[i];
+  }
+
+  const float &operator[](size_t i) const
+  {
+    return v[i];
+  }
+
+  float *data()
+  {
+    return v;
+  }
+
+  const float *data() const
+  {
+    return v;
+  }
+};
+
+// 1 / sqrt(x) from the float bit pattern and two Newton steps, ~5e-6 off
+inline float inv_sqrt(float x)
+{
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  bits = 0x5f3759df - (bits >> 1);
+  float y;
+  memcpy(&y, &bits, sizeof(y));
+  const float half = 0.5f * x;
+  y = y * (1.5f - half * y * y);
+  y = y * (1.5f - half * y * y);
+  return y;
+}
+
+#endif
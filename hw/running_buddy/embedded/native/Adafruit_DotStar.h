@@ -0,0 +1,45 @@
+#ifndef ADAFRUIT_DOTSTAR_NATIVE
+#define ADAFRUIT_DOTSTAR_NATIVE
+
+/**
+ * DotStar stand-in, show() appends the pixel state to leds.log and takes
+ * the time the bit banged SPI needs
+ */
+
+#include "Arduino.h"
+
+class Adafruit_DotStar
+{
+public:
+  explicit Adafruit_DotStar(uint16_t count);
+  ~Adafruit_DotStar();
+
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b)
+  {
+    return (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b;
+  }
+
+  void begin() {}
+  void show();
+  void clear();
+  void fill(uint32_t color, uint16_t first = 0, uint16_t count = 0);
+  void setPixelColor(uint16_t n, uint32_t color);
+  void setBrightness(uint8_t b);
+
+  uint32_t getPixelColor(uint16_t n) const
+  {
+    return n < count ? pixels[n] : 0;
+  }
+
+  uint16_t numPixels() const
+  {
+    return count;
+  }
+
+private:
+  uint16_t count;
+  uint32_t *pixels;
+  uint8_t brightness = 0;
+};
+
+#endif
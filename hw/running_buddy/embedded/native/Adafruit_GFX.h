@@ -0,0 +1,115 @@
+#ifndef ADAFRUIT_GFX_NATIVE
+#define ADAFRUIT_GFX_NATIVE
+
+/**
+ * Adafruit_GFX stand-in for the native simulation
+ *
+ * geometry, cursor and text metrics follow the classic 6x8 built-in font,
+ * but glyphs are drawn as solid 5x7 cells since the font table is not
+ * shipped here.
+ */
+
+#include "Arduino.h"
+
+class Adafruit_GFX : public Print
+{
+public:
+  Adafruit_GFX(int16_t w, int16_t h);
+
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  virtual void fillScreen(uint16_t color);
+  virtual void setRotation(uint8_t r);
+
+  void drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[], int16_t w, int16_t h, uint16_t color);
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size);
+
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  void setCursor(int16_t x, int16_t y)
+  {
+    cursor_x = x;
+    cursor_y = y;
+  }
+
+  void setTextSize(uint8_t s)
+  {
+    textsize = s > 0 ? s : 1;
+  }
+
+  void setTextColor(uint16_t c)
+  {
+    textcolor = textbgcolor = c;
+  }
+
+  void setTextColor(uint16_t c, uint16_t bg)
+  {
+    textcolor = c;
+    textbgcolor = bg;
+  }
+
+  void setTextWrap(bool w)
+  {
+    wrap = w;
+  }
+
+  int16_t width() const
+  {
+    return _width;
+  }
+
+  int16_t height() const
+  {
+    return _height;
+  }
+
+  uint8_t getRotation() const
+  {
+    return rotation;
+  }
+
+  int16_t getCursorX() const
+  {
+    return cursor_x;
+  }
+
+  int16_t getCursorY() const
+  {
+    return cursor_y;
+  }
+
+protected:
+  const int16_t WIDTH;
+  const int16_t HEIGHT;
+  int16_t _width;
+  int16_t _height;
+  int16_t cursor_x = 0;
+  int16_t cursor_y = 0;
+  uint16_t textcolor = 0xFFFF;
+  uint16_t textbgcolor = 0xFFFF;
+  uint8_t textsize = 1;
+  uint8_t rotation = 0;
+  bool wrap = true;
+};
+
+// RGB565 offscreen buffer
+class GFXcanvas16 : public Adafruit_GFX
+{
+public:
+  GFXcanvas16(uint16_t w, uint16_t h);
+  ~GFXcanvas16();
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+  void fillScreen(uint16_t color) override;
+
+  uint16_t *getBuffer() const
+  {
+    return buffer;
+  }
+
+private:
+  uint16_t *buffer;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef ADAFRUIT_ST7789_NATIVE
+#define ADAFRUIT_ST7789_NATIVE
+
+/**
+ * ST7789 stand-in that renders into a 240x240 RGB565 framebuffer, which
+ * is written to display.ppm when the simulation ends. SPI traffic takes
+ * its bus time on the virtual clock: a lone pixel pays for an address
+ * window, windowed pixels and fills only for their two bytes.
+ */
+
+#include <vector>
+
+#include "Adafruit_GFX.h"
+
+class Adafruit_ST7789 : public Adafruit_GFX
+{
+public:
+  Adafruit_ST7789();
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+
+  // windowed writes as in Adafruit_SPITFT, pixels fill the window row by row
+  void startWrite() {}
+  void endWrite() {}
+  void setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+  void writePixels(uint16_t *colors, uint32_t len, bool block = true, bool bigEndian = false);
+
+  // pixels pushed to the panel since boot, each one is two bytes over SPI
+  uint32_t pixels_pushed() const
+  {
+    return pushed;
+  }
+
+  bool save_ppm(const char *path) const;
+
+private:
+  void plot(int16_t x, int16_t y, uint16_t color);
+  void bus_time(uint32_t bytes);
+
+  std::vector<uint16_t> framebuffer;
+  uint32_t bus_bytes = 0;
+  uint32_t pushed = 0;
+  uint16_t window_x = 0;
+  uint16_t window_y = 0;
+  uint16_t window_w = 0;
+  uint16_t window_h = 0;
+  uint32_t window_pos = 0;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include <stdio.h>
+
+#include "Arduino.h"
+#include "sim.h"
+
+HardwareSerial Serial;
+
+unsigned long millis()
+{
+  return static_cast<unsigned long>(sim_time_us() / 1000);
+}
+
+unsigned long micros()
+{
+  return static_cast<unsigned long>(sim_time_us());
+}
+
+void delay(unsigned long ms)
+{
+  sim_advance_us(static_cast<uint64_t>(ms) * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  sim_advance_us(us);
+}
+
+#define SIM_PINS 32
+
+static bool pin_levels[SIM_PINS];
+static void (*pin_isrs[SIM_PINS])();
+static int pin_modes[SIM_PINS];
+
+void pinMode(uint8_t, uint8_t)
+{
+}
+
+int digitalRead(uint8_t pin)
+{
+  return pin < SIM_PINS && pin_levels[pin] ? HIGH : LOW;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode)
+{
+  if (interrupt < SIM_PINS)
+  {
+    pin_isrs[interrupt] = isr;
+    pin_modes[interrupt] = mode;
+  }
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+  if (interrupt < SIM_PINS)
+  {
+    pin_isrs[interrupt] = nullptr;
+  }
+}
+
+void sim_set_pin(int pin, bool level)
+{
+  if (pin < 0 || pin >= SIM_PINS || pin_levels[pin] == level)
+  {
+    return;
+  }
+  pin_levels[pin] = level;
+  const int mode = pin_modes[pin];
+  const bool fire = mode == CHANGE || (mode == RISING && level) || (mode == FALLING && !level);
+  if (pin_isrs[pin] && fire)
+  {
+    pin_isrs[pin]();
+  }
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--)
+  {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(const char *str)
+{
+  return write(str);
+}
+
+size_t Print::print(const String &str)
+{
+  return write(str.c_str());
+}
+
+size_t Print::print(char c)
+{
+  return write(static_cast<uint8_t>(c));
+}
+
+size_t Print::print(int val, int base)
+{
+  return print(static_cast<long long>(val), base);
+}
+
+size_t Print::print(unsigned int val, int base)
+{
+  return print(static_cast<unsigned long long>(val), base);
+}
+
+size_t Print::print(long val, int base)
+{
+  return print(static_cast<long long>(val), base);
+}
+
+size_t Print::print(unsigned long val, int base)
+{
+  return print(static_cast<unsigned long long>(val), base);
+}
+
+size_t Print::print(long long val, int base)
+{
+  if (base != DEC)
+  {
+    return print(static_cast<unsigned long long>(val), base);
+  }
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%lld", val);
+  return write(buf);
+}
+
+size_t Print::print(unsigned long long val, int base)
+{
+  char buf[24];
+  snprintf(buf, sizeof(buf), base == HEX ? "%llX" : "%llu", val);
+  return write(buf);
+}
+
+size_t Print::print(double val, int digits)
+{
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", digits, val);
+  return write(buf);
+}
+
+size_t Print::println()
+{
+  return write("\r\n");
+}
+
+void HardwareSerial::begin(unsigned long)
+{
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  if (!sim.quiet && c != '\r')
+  {
+    fputc(c, stdout);
+  }
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  if (!sim.quiet)
+  {
+    for (size_t i = 0; i < size; i++)
+    {
+      if (buffer[i] != '\r')
+      {
+        fputc(buffer[i], stdout);
+      }
+    }
+  }
+  return size;
+}
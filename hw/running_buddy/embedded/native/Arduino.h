@@ -0,0 +1,140 @@
+#ifndef ARDUINO_NATIVE
+#define ARDUINO_NATIVE
+
+/**
+ * minimal Arduino core for the native simulation
+ *
+ * time comes from the virtual clock in sim.h and Serial writes to stdout.
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*reinterpret_cast<const uint8_t *>(addr))
+#define DEC 10
+#define HEX 16
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define CHANGE 2
+#define FALLING 3
+#define RISING 4
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+inline int digitalPinToInterrupt(uint8_t pin)
+{
+  return pin;
+}
+
+class String
+{
+public:
+  String(const char *str = "") : str(str) {}
+  String(const std::string &str) : str(str) {}
+
+  const char *c_str() const
+  {
+    return str.c_str();
+  }
+
+  unsigned int length() const
+  {
+    return str.size();
+  }
+
+  String &operator+=(const String &other)
+  {
+    str += other.str;
+    return *this;
+  }
+
+private:
+  std::string str;
+};
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+
+  size_t write(const char *str)
+  {
+    return write(reinterpret_cast<const uint8_t *>(str), strlen(str));
+  }
+
+  size_t print(const char *str);
+  size_t print(const String &str);
+  size_t print(char c);
+  size_t print(int val, int base = DEC);
+  size_t print(unsigned int val, int base = DEC);
+  size_t print(long val, int base = DEC);
+  size_t print(unsigned long val, int base = DEC);
+  size_t print(long long val, int base = DEC);
+  size_t print(unsigned long long val, int base = DEC);
+  size_t print(double val, int digits = 2);
+
+  size_t println();
+
+  template <typename T>
+  size_t println(const T &val)
+  {
+    size_t n = print(val);
+    return n + println();
+  }
+
+  template <typename T>
+  size_t println(const T &val, int format)
+  {
+    size_t n = print(val, format);
+    return n + println();
+  }
+};
+
+class HardwareSerial : public Print
+{
+public:
+  void begin(unsigned long baud);
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+
+  int available()
+  {
+    return 0;
+  }
+
+  int read()
+  {
+    return -1;
+  }
+
+  explicit operator bool() const
+  {
+    return true;
+  }
+};
+
+extern HardwareSerial Serial;
+
+#endif
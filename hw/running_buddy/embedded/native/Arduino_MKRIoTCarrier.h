@@ -0,0 +1,133 @@
+#ifndef ARDUINO_MKRIOTCARRIER_NATIVE
+#define ARDUINO_MKRIOTCARRIER_NATIVE
+
+/**
+ * MKRIoTCarrier stand-in for the native simulation
+ *
+ * the IMU replays a csv trace, touch pads replay a button script, and the
+ * display, LEDs and SD card are backed by files, see sim.h.
+ */
+
+#include <vector>
+
+#include "Arduino.h"
+#include "Adafruit_DotStar.h"
+#include "Adafruit_ST7789.h"
+#include "SD.h"
+
+extern bool CARRIER_CASE;
+
+enum touchButtons
+{
+  TOUCH0 = 0,
+  TOUCH1,
+  TOUCH2,
+  TOUCH3,
+  TOUCH4,
+};
+
+class LSM6DS3Class
+{
+public:
+  int begin();
+  int readAcceleration(float &x, float &y, float &z);
+  int readGyroscope(float &x, float &y, float &z);
+  int accelerationAvailable();
+  int gyroscopeAvailable();
+
+  float accelerationSampleRate()
+  {
+    return 104.0f;
+  }
+
+  float gyroscopeSampleRate()
+  {
+    return 104.0f;
+  }
+
+  // trace values at now_ms, read by the fake FIFO behind Wire
+  void sample(uint32_t now_ms, float accel[3], float gyro[3]);
+
+private:
+  struct trace_row
+  {
+    uint32_t t_ms;
+    float accel[3];
+    float gyro[3];
+  };
+
+  const trace_row *row_at(uint32_t now_ms);
+
+  std::vector<trace_row> rows;
+  bool started = false;
+  uint32_t start_ms = 0;
+  size_t cursor = 0;
+};
+
+class HTS221Class
+{
+public:
+  float readTemperature();
+  float readHumidity();
+};
+
+class MKRIoTCarrierQtouch
+{
+public:
+  bool begin();
+  void update();
+  bool onTouchDown(touchButtons pad);
+  bool onTouchUp(touchButtons pad);
+  bool getTouch(touchButtons pad);
+
+private:
+  struct event
+  {
+    uint32_t t_ms;
+    uint8_t pad;
+  };
+
+  std::vector<event> script;
+  size_t next = 0;
+  bool down[5] = {};
+  bool was_down[5] = {};
+};
+
+class MKRIoTCarrier_Relay
+{
+public:
+  explicit MKRIoTCarrier_Relay(uint8_t index) : index(index) {}
+  void open();
+  void close();
+
+  bool getStatus() const
+  {
+    return closed;
+  }
+
+private:
+  uint8_t index;
+  bool closed = false;
+};
+
+class MKRIoTCarrier
+{
+public:
+  MKRIoTCarrier();
+  ~MKRIoTCarrier();
+
+  int begin();
+
+  LSM6DS3Class &IMUmodule;
+  HTS221Class &Env;
+  MKRIoTCarrierQtouch Buttons;
+  MKRIoTCarrier_Relay Relay1;
+  MKRIoTCarrier_Relay Relay2;
+  Adafruit_DotStar leds;
+  Adafruit_ST7789 display;
+};
+
+extern LSM6DS3Class IMU;
+extern HTS221Class HTS;
+
+#endif
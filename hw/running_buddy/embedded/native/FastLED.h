@@ -0,0 +1,132 @@
+#ifndef FASTLED_NATIVE
+#define FASTLED_NATIVE
+
+/**
+ * FastLED stand-in for the native simulation, show() appends the strip
+ * state to leds.log and takes the time the WS2811 data needs on the wire
+ */
+
+#include "Arduino.h"
+
+struct CRGB
+{
+  uint8_t r = 0;
+  uint8_t g = 0;
+  uint8_t b = 0;
+
+  enum HTMLColorCode : uint32_t
+  {
+    Black = 0x000000,
+    Aqua = 0x00FFFF,
+    Blue = 0x0000FF,
+    Green = 0x008000,
+    Orange = 0xFFA500,
+    Red = 0xFF0000,
+    White = 0xFFFFFF,
+    Yellow = 0xFFFF00,
+  };
+
+  CRGB() {}
+  CRGB(uint8_t r, uint8_t g, uint8_t b) : r(r), g(g), b(b) {}
+  CRGB(uint32_t code) : r((code >> 16) & 0xFF), g((code >> 8) & 0xFF), b(code & 0xFF) {}
+  CRGB(HTMLColorCode code) : CRGB(static_cast<uint32_t>(code)) {}
+
+  bool operator==(const CRGB &other) const
+  {
+    return r == other.r && g == other.g && b == other.b;
+  }
+
+  bool operator!=(const CRGB &other) const
+  {
+    return !(*this == other);
+  }
+
+  CRGB &nscale8(uint8_t scale)
+  {
+    r = (static_cast<uint16_t>(r) * (scale + 1)) >> 8;
+    g = (static_cast<uint16_t>(g) * (scale + 1)) >> 8;
+    b = (static_cast<uint16_t>(b) * (scale + 1)) >> 8;
+    return *this;
+  }
+};
+
+template <int N>
+class CRGBArray
+{
+public:
+  CRGB &operator[](int i)
+  {
+    return pixels[i];
+  }
+
+  operator CRGB *()
+  {
+    return pixels;
+  }
+
+private:
+  CRGB pixels[N];
+};
+
+enum EOrder
+{
+  RGB = 0012,
+  GRB = 0102,
+};
+
+enum LEDColorCorrection : uint32_t
+{
+  TypicalLEDStrip = 0xFFB0F0,
+  UncorrectedColor = 0xFFFFFF,
+};
+
+template <uint8_t DATA_PIN, EOrder RGB_ORDER>
+class WS2811
+{
+};
+
+class CLEDController
+{
+public:
+  CLEDController &setCorrection(LEDColorCorrection)
+  {
+    return *this;
+  }
+
+  CRGB *leds = nullptr;
+  int count = 0;
+};
+
+class CFastLED
+{
+public:
+  template <template <uint8_t, EOrder> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+  CLEDController &addLeds(CRGB *leds, int count)
+  {
+    controller.leds = leds;
+    controller.count = count;
+    return controller;
+  }
+
+  void setBrightness(uint8_t scale)
+  {
+    brightness = scale;
+  }
+
+  uint8_t getBrightness() const
+  {
+    return brightness;
+  }
+
+  void show();
+
+private:
+  CLEDController controller;
+  uint8_t brightness = 255;
+};
+
+extern CFastLED FastLED;
+
+void fill_solid(CRGB *leds, int count, const CRGB &color);
+
+#endif
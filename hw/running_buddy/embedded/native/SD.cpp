@@ -0,0 +1,97 @@
+#include <sys/stat.h>
+
+#include "SD.h"
+#include "sim.h"
+
+SDClass SD;
+
+File::File(FILE *handle, const std::string &name) : handle(handle, fclose), path(name)
+{
+}
+
+size_t File::write(uint8_t c)
+{
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buffer, size_t size)
+{
+  if (!handle)
+  {
+    return 0;
+  }
+  return fwrite(buffer, 1, size, handle.get());
+}
+
+int File::read()
+{
+  return handle ? fgetc(handle.get()) : -1;
+}
+
+int File::available()
+{
+  if (!handle)
+  {
+    return 0;
+  }
+  const long pos = ftell(handle.get());
+  return static_cast<int>(size() - pos);
+}
+
+uint32_t File::size()
+{
+  if (!handle)
+  {
+    return 0;
+  }
+  fflush(handle.get());
+  struct stat info;
+  if (fstat(fileno(handle.get()), &info) != 0)
+  {
+    return 0;
+  }
+  return static_cast<uint32_t>(info.st_size);
+}
+
+void File::flush()
+{
+  if (handle)
+  {
+    fflush(handle.get());
+  }
+}
+
+void File::close()
+{
+  handle.reset();
+}
+
+bool SDClass::begin(uint8_t)
+{
+  root = sim_path("sd");
+  mkdir(root.c_str(), 0755);
+  struct stat info;
+  return stat(root.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+File SDClass::open(const char *path, uint8_t mode)
+{
+  const std::string full = root + "/" + path;
+  FILE *handle = fopen(full.c_str(), mode == FILE_WRITE ? "ab+" : "rb");
+  if (!handle)
+  {
+    return File();
+  }
+  return File(handle, path);
+}
+
+bool SDClass::exists(const char *path)
+{
+  struct stat info;
+  return stat((root + "/" + path).c_str(), &info) == 0;
+}
+
+bool SDClass::remove(const char *path)
+{
+  return ::remove((root + "/" + path).c_str()) == 0;
+}
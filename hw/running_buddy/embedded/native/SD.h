@@ -0,0 +1,63 @@
+#ifndef SD_NATIVE
+#define SD_NATIVE
+
+/**
+ * SD library stand-in backed by a directory on the host
+ */
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+
+#include "Arduino.h"
+
+#define FILE_READ 0
+#define FILE_WRITE 1
+
+class File : public Print
+{
+public:
+  File() {}
+  File(FILE *handle, const std::string &name);
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+
+  int read();
+  int available();
+  uint32_t size();
+  void flush();
+  void close();
+
+  const char *name() const
+  {
+    return path.c_str();
+  }
+
+  explicit operator bool() const
+  {
+    return handle != nullptr;
+  }
+
+private:
+  std::shared_ptr<FILE> handle;
+  std::string path;
+};
+
+class SDClass
+{
+public:
+  bool begin(uint8_t cs_pin = 0);
+  File open(const char *path, uint8_t mode = FILE_READ);
+  bool exists(const char *path);
+  bool remove(const char *path);
+
+private:
+  std::string root;
+};
+
+extern SDClass SD;
+
+#endif
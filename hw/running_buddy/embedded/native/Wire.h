@@ -0,0 +1,46 @@
+#ifndef WIRE_NATIVE
+#define WIRE_NATIVE
+
+/**
+ * I2C bus for the native simulation
+ *
+ * the only device on it is a register level LSM6DS3 at 0x6A whose FIFO
+ * fills from the IMU trace at the configured ODR, see lsm6ds3_sim.cpp.
+ * transfers advance the virtual clock by their time on the bus.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+class TwoWire
+{
+public:
+  void begin() {}
+
+  void setClock(uint32_t hz)
+  {
+    clock_hz = hz;
+  }
+
+  void beginTransmission(uint8_t address);
+  size_t write(uint8_t data);
+  uint8_t endTransmission(bool stop = true);
+  uint8_t requestFrom(uint8_t address, size_t quantity, bool stop = true);
+  int available();
+  int read();
+
+private:
+  void bus_time(size_t bytes);
+
+  uint32_t clock_hz = 100000;
+  uint8_t address = 0;
+  uint8_t tx[32];
+  size_t tx_len = 0;
+  uint8_t rx[256];
+  size_t rx_len = 0;
+  size_t rx_pos = 0;
+};
+
+extern TwoWire Wire;
+
+#endif
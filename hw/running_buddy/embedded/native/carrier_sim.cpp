@@ -0,0 +1,361 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "Arduino_MKRIoTCarrier.h"
+#include "FastLED.h"
+#include "sim.h"
+
+#define CARRIER_LEDS 5
+// WS2811 at 800 kbit/s, 24 bits per pixel then a 50 us latch
+#define WS2811_US_PER_PIXEL 30
+#define WS2811_LATCH_US 50
+// the carrier's DotStars are bit banged at about 1 MHz
+#define DOTSTAR_US_PER_BYTE 8
+
+bool CARRIER_CASE = false;
+
+LSM6DS3Class IMU;
+HTS221Class HTS;
+CFastLED FastLED;
+
+static MKRIoTCarrier *carrier_instance = nullptr;
+static FILE *led_log = nullptr;
+
+static void log_leds(const char *device, const std::string &state, std::string &last)
+{
+  if (state == last)
+  {
+    return;
+  }
+  last = state;
+  if (!led_log)
+  {
+    led_log = fopen(sim_path("leds.log").c_str(), "w");
+    if (!led_log)
+    {
+      return;
+    }
+  }
+  fprintf(led_log, "%lu,%s,%s\n", millis(), device, state.c_str());
+}
+
+// splits a csv line into floats, false if any field is not a number
+static bool parse_row(const std::string &line, std::vector<float> &fields)
+{
+  fields.clear();
+  std::stringstream stream(line);
+  std::string field;
+  while (std::getline(stream, field, ','))
+  {
+    const char *start = field.c_str();
+    char *end = nullptr;
+    const float val = strtof(start, &end);
+    while (*end == ' ' || *end == '\t' || *end == '\r')
+    {
+      end++;
+    }
+    if (end == start || *end != '\0')
+    {
+      return false;
+    }
+    fields.push_back(val);
+  }
+  return !fields.empty();
+}
+
+int LSM6DS3Class::begin()
+{
+  rows.clear();
+  cursor = 0;
+  started = false;
+  if (sim.trace_path.empty())
+  {
+    return 1;
+  }
+  std::ifstream trace(sim.trace_path);
+  if (!trace)
+  {
+    fprintf(stderr, "could not open trace %s\n", sim.trace_path.c_str());
+    return 0;
+  }
+  // rows are x, y, z[, gx, gy, gz] at sample_period_ms, or prefixed with t_ms
+  std::string line;
+  std::vector<float> fields;
+  while (std::getline(trace, line))
+  {
+    if (!parse_row(line, fields))
+    {
+      continue;
+    }
+    const bool timed = fields.size() == 4 || fields.size() == 7;
+    const size_t offset = timed ? 1 : 0;
+    if (fields.size() - offset != 3 && fields.size() - offset != 6)
+    {
+      continue;
+    }
+    trace_row row = {};
+    row.t_ms = timed ? static_cast<uint32_t>(fields[0]) : rows.size() * sim.sample_period_ms;
+    for (size_t i = 0; i < 3; i++)
+    {
+      row.accel[i] = fields[offset + i];
+      row.gyro[i] = fields.size() - offset == 6 ? fields[offset + 3 + i] : 0.0f;
+    }
+    rows.push_back(row);
+  }
+  if (!sim.quiet)
+  {
+    fprintf(stderr, "loaded %zu trace rows from %s\n", rows.size(), sim.trace_path.c_str());
+  }
+  return 1;
+}
+
+const LSM6DS3Class::trace_row *LSM6DS3Class::row_at(uint32_t now_ms)
+{
+  if (rows.empty())
+  {
+    return nullptr;
+  }
+  // playback starts with the first read, not at boot
+  if (!started)
+  {
+    started = true;
+    start_ms = now_ms;
+  }
+  const uint32_t elapsed = now_ms - start_ms;
+  while (cursor + 1 < rows.size() && rows[cursor + 1].t_ms <= elapsed)
+  {
+    cursor++;
+  }
+  if (cursor + 1 == rows.size() && elapsed >= rows[cursor].t_ms + sim.sample_period_ms)
+  {
+    sim_trace_done();
+  }
+  return &rows[cursor];
+}
+
+void LSM6DS3Class::sample(uint32_t now_ms, float accel[3], float gyro[3])
+{
+  const trace_row *row = row_at(now_ms);
+  for (size_t i = 0; i < 3; i++)
+  {
+    accel[i] = row ? row->accel[i] : (i == 2 ? 1.0f : 0.0f);
+    gyro[i] = row ? row->gyro[i] : 0.0f;
+  }
+}
+
+int LSM6DS3Class::readAcceleration(float &x, float &y, float &z)
+{
+  const trace_row *row = row_at(millis());
+  x = row ? row->accel[0] : 0.0f;
+  y = row ? row->accel[1] : 0.0f;
+  z = row ? row->accel[2] : 1.0f;
+  return 1;
+}
+
+int LSM6DS3Class::readGyroscope(float &x, float &y, float &z)
+{
+  const trace_row *row = row_at(millis());
+  x = row ? row->gyro[0] : 0.0f;
+  y = row ? row->gyro[1] : 0.0f;
+  z = row ? row->gyro[2] : 0.0f;
+  return 1;
+}
+
+int LSM6DS3Class::accelerationAvailable()
+{
+  return 1;
+}
+
+int LSM6DS3Class::gyroscopeAvailable()
+{
+  return 1;
+}
+
+float HTS221Class::readTemperature()
+{
+  return sim.temperature;
+}
+
+float HTS221Class::readHumidity()
+{
+  return 50.0f;
+}
+
+bool MKRIoTCarrierQtouch::begin()
+{
+  script.clear();
+  next = 0;
+  if (sim.buttons_path.empty())
+  {
+    return true;
+  }
+  std::ifstream file(sim.buttons_path);
+  std::string line;
+  std::vector<float> fields;
+  while (std::getline(file, line))
+  {
+    if (parse_row(line, fields) && fields.size() == 2 && fields[1] >= 0 && fields[1] < 5)
+    {
+      script.push_back({static_cast<uint32_t>(fields[0]), static_cast<uint8_t>(fields[1])});
+    }
+  }
+  return true;
+}
+
+void MKRIoTCarrierQtouch::update()
+{
+  for (size_t i = 0; i < 5; i++)
+  {
+    was_down[i] = down[i];
+    down[i] = false;
+  }
+  // a scripted touch holds its pad down for a single update
+  while (next < script.size() && script[next].t_ms <= millis())
+  {
+    down[script[next].pad] = true;
+    next++;
+  }
+}
+
+bool MKRIoTCarrierQtouch::onTouchDown(touchButtons pad)
+{
+  return down[pad] && !was_down[pad];
+}
+
+bool MKRIoTCarrierQtouch::onTouchUp(touchButtons pad)
+{
+  return !down[pad] && was_down[pad];
+}
+
+bool MKRIoTCarrierQtouch::getTouch(touchButtons pad)
+{
+  return down[pad];
+}
+
+void MKRIoTCarrier_Relay::open()
+{
+  closed = false;
+}
+
+void MKRIoTCarrier_Relay::close()
+{
+  closed = true;
+}
+
+Adafruit_DotStar::Adafruit_DotStar(uint16_t count) : count(count), pixels(new uint32_t[count]())
+{
+}
+
+Adafruit_DotStar::~Adafruit_DotStar()
+{
+  delete[] pixels;
+}
+
+void Adafruit_DotStar::show()
+{
+  static std::string last;
+  std::string state;
+  char buf[16];
+  for (uint16_t i = 0; i < count; i++)
+  {
+    snprintf(buf, sizeof(buf), "%s%06lX", i == 0 ? "" : " ", static_cast<unsigned long>(pixels[i]));
+    state += buf;
+  }
+  log_leds("carrier", state, last);
+  // start frame, a word per pixel, end frame
+  sim_advance_us((4 + 4 * count + (count + 15) / 16) * DOTSTAR_US_PER_BYTE);
+}
+
+void Adafruit_DotStar::clear()
+{
+  fill(0);
+}
+
+void Adafruit_DotStar::fill(uint32_t color, uint16_t first, uint16_t n)
+{
+  const uint16_t end = n == 0 || first + n > count ? count : first + n;
+  for (uint16_t i = first; i < end; i++)
+  {
+    pixels[i] = color;
+  }
+}
+
+void Adafruit_DotStar::setPixelColor(uint16_t n, uint32_t color)
+{
+  if (n < count)
+  {
+    pixels[n] = color;
+  }
+}
+
+void Adafruit_DotStar::setBrightness(uint8_t b)
+{
+  brightness = b;
+}
+
+void CFastLED::show()
+{
+  static std::string last;
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u", brightness);
+  std::string state = buf;
+  for (int i = 0; i < controller.count; i++)
+  {
+    const CRGB &pixel = controller.leds[i];
+    snprintf(buf, sizeof(buf), " %02X%02X%02X", pixel.r, pixel.g, pixel.b);
+    state += buf;
+  }
+  log_leds("strip", state, last);
+  sim_advance_us(controller.count * WS2811_US_PER_PIXEL + WS2811_LATCH_US);
+}
+
+void fill_solid(CRGB *leds, int count, const CRGB &color)
+{
+  for (int i = 0; i < count; i++)
+  {
+    leds[i] = color;
+  }
+}
+
+MKRIoTCarrier::MKRIoTCarrier()
+    : IMUmodule(IMU), Env(HTS), Relay1(1), Relay2(2), leds(CARRIER_LEDS)
+{
+  carrier_instance = this;
+}
+
+MKRIoTCarrier::~MKRIoTCarrier()
+{
+  if (carrier_instance == this)
+  {
+    carrier_instance = nullptr;
+  }
+}
+
+int MKRIoTCarrier::begin()
+{
+  if (!SD.begin())
+  {
+    Serial.println("Sd card not detected");
+  }
+  leds.begin();
+  leds.show();
+  Buttons.begin();
+  return IMUmodule.begin();
+}
+
+void sim_shutdown()
+{
+  if (carrier_instance)
+  {
+    carrier_instance->display.save_ppm(sim_path("display.ppm").c_str());
+  }
+  if (led_log)
+  {
+    fclose(led_log);
+    led_log = nullptr;
+  }
+}
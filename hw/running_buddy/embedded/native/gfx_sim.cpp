@@ -0,0 +1,229 @@
+#include <stdio.h>
+
+#include "Adafruit_GFX.h"
+#include "Adafruit_ST7789.h"
+#include "sim.h"
+
+#define CHAR_WIDTH 6
+#define CHAR_HEIGHT 8
+
+// 24 MHz SPI clock, and the CASET / RASET / RAMWR commands of a window
+#define SPI_BYTES_PER_US 3
+#define WINDOW_BYTES 11
+
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h) : WIDTH(w), HEIGHT(h), _width(w), _height(h)
+{
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+  for (int16_t j = y; j < y + h; j++)
+  {
+    for (int16_t i = x; i < x + w; i++)
+    {
+      drawPixel(i, j, color);
+    }
+  }
+}
+
+void Adafruit_GFX::fillScreen(uint16_t color)
+{
+  fillRect(0, 0, _width, _height, color);
+}
+
+void Adafruit_GFX::setRotation(uint8_t r)
+{
+  rotation = r & 3;
+  _width = rotation % 2 == 0 ? WIDTH : HEIGHT;
+  _height = rotation % 2 == 0 ? HEIGHT : WIDTH;
+}
+
+void Adafruit_GFX::drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[], int16_t w, int16_t h, uint16_t color)
+{
+  const int16_t byte_width = (w + 7) / 8;
+  for (int16_t j = 0; j < h; j++)
+  {
+    for (int16_t i = 0; i < w; i++)
+    {
+      if (bitmap[j * byte_width + i / 8] & (0x80 >> (i & 7)))
+      {
+        drawPixel(x + i, y + j, color);
+      }
+    }
+  }
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size)
+{
+  if (bg != color)
+  {
+    fillRect(x, y, CHAR_WIDTH * size, CHAR_HEIGHT * size, bg);
+  }
+  if (c != ' ')
+  {
+    fillRect(x, y, (CHAR_WIDTH - 1) * size, (CHAR_HEIGHT - 1) * size, color);
+  }
+}
+
+size_t Adafruit_GFX::write(uint8_t c)
+{
+  if (c == '\n')
+  {
+    cursor_x = 0;
+    cursor_y += textsize * CHAR_HEIGHT;
+    return 1;
+  }
+  if (c == '\r')
+  {
+    return 1;
+  }
+  if (wrap && cursor_x + textsize * CHAR_WIDTH > _width)
+  {
+    cursor_x = 0;
+    cursor_y += textsize * CHAR_HEIGHT;
+  }
+  drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize);
+  cursor_x += textsize * CHAR_WIDTH;
+  return 1;
+}
+
+GFXcanvas16::GFXcanvas16(uint16_t w, uint16_t h) : Adafruit_GFX(w, h), buffer(new uint16_t[w * h]())
+{
+}
+
+GFXcanvas16::~GFXcanvas16()
+{
+  delete[] buffer;
+}
+
+void GFXcanvas16::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+  if (x < 0 || y < 0 || x >= _width || y >= _height)
+  {
+    return;
+  }
+  buffer[y * WIDTH + x] = color;
+}
+
+void GFXcanvas16::fillScreen(uint16_t color)
+{
+  for (int32_t i = 0; i < WIDTH * HEIGHT; i++)
+  {
+    buffer[i] = color;
+  }
+}
+
+Adafruit_ST7789::Adafruit_ST7789() : Adafruit_GFX(240, 240), framebuffer(240 * 240, 0)
+{
+}
+
+void Adafruit_ST7789::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+  if (x < 0 || y < 0 || x >= _width || y >= _height)
+  {
+    return;
+  }
+  bus_time(WINDOW_BYTES + 2);
+  plot(x, y, color);
+}
+
+void Adafruit_ST7789::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+  const int16_t x0 = x < 0 ? 0 : x;
+  const int16_t y0 = y < 0 ? 0 : y;
+  const int16_t x1 = x + w > _width ? _width : x + w;
+  const int16_t y1 = y + h > _height ? _height : y + h;
+  if (x0 >= x1 || y0 >= y1)
+  {
+    return;
+  }
+  bus_time(WINDOW_BYTES + 2 * (x1 - x0) * (y1 - y0));
+  for (int16_t j = y0; j < y1; j++)
+  {
+    for (int16_t i = x0; i < x1; i++)
+    {
+      plot(i, j, color);
+    }
+  }
+}
+
+void Adafruit_ST7789::plot(int16_t x, int16_t y, uint16_t color)
+{
+  if (x < 0 || y < 0 || x >= _width || y >= _height)
+  {
+    return;
+  }
+  int16_t px = x;
+  int16_t py = y;
+  switch (rotation)
+  {
+  case 1:
+    px = WIDTH - 1 - y;
+    py = x;
+    break;
+  case 2:
+    px = WIDTH - 1 - x;
+    py = HEIGHT - 1 - y;
+    break;
+  case 3:
+    px = y;
+    py = HEIGHT - 1 - x;
+    break;
+  default:
+    break;
+  }
+  framebuffer[py * WIDTH + px] = color;
+  pushed++;
+}
+
+void Adafruit_ST7789::bus_time(uint32_t bytes)
+{
+  bus_bytes += bytes;
+  sim_advance_us(bus_bytes / SPI_BYTES_PER_US);
+  bus_bytes %= SPI_BYTES_PER_US;
+}
+
+void Adafruit_ST7789::setAddrWindow(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+  window_x = x;
+  window_y = y;
+  window_w = w;
+  window_h = h;
+  window_pos = 0;
+  bus_time(WINDOW_BYTES);
+}
+
+void Adafruit_ST7789::writePixels(uint16_t *colors, uint32_t len, bool, bool)
+{
+  bus_time(2 * len);
+  for (uint32_t i = 0; i < len && window_w > 0; i++, window_pos++)
+  {
+    const uint32_t row = window_pos / window_w;
+    if (row >= window_h)
+    {
+      break;
+    }
+    plot(window_x + window_pos % window_w, window_y + row, colors[i]);
+  }
+}
+
+bool Adafruit_ST7789::save_ppm(const char *path) const
+{
+  FILE *out = fopen(path, "wb");
+  if (!out)
+  {
+    return false;
+  }
+  fprintf(out, "P6\n%d %d\n255\n", WIDTH, HEIGHT);
+  for (uint16_t pixel : framebuffer)
+  {
+    const uint8_t rgb[3] = {
+        static_cast<uint8_t>(((pixel >> 11) & 0x1F) * 255 / 31),
+        static_cast<uint8_t>(((pixel >> 5) & 0x3F) * 255 / 63),
+        static_cast<uint8_t>((pixel & 0x1F) * 255 / 31),
+    };
+    fwrite(rgb, 1, sizeof(rgb), out);
+  }
+  fclose(out);
+  return true;
+}
@@ -0,0 +1,249 @@
+#include <math.h>
+
+#include "Arduino_MKRIoTCarrier.h"
+#include "Wire.h"
+#include "imu_fifo.h"
+#include "sim.h"
+
+#define FIFO_WORDS 4096
+
+TwoWire Wire;
+
+/**
+ * LSM6DS3 register model: CTRL1_XL / CTRL2_G full scales, the FIFO threshold
+ * and continuous mode, the gyro then accel FIFO pattern, FIFO_STATUS1-4 and
+ * the INT1 watermark line. other registers just store what is written.
+ */
+class lsm6ds3_sim
+{
+public:
+  lsm6ds3_sim()
+  {
+    regs[IMU_REG_WHO_AM_I] = 0x69;
+    regs[IMU_REG_CTRL3_C] = 0x04;
+  }
+
+  void update()
+  {
+    const uint64_t now = sim_time_us();
+    static const float odr_hz[] = {0.0f, 12.5f, 26.0f, 52.0f, 104.0f, 208.0f, 416.0f, 833.0f, 1660.0f};
+    const uint8_t odr = (regs[IMU_REG_FIFO_CTRL5] >> 3) & 0x0F;
+    if ((regs[IMU_REG_FIFO_CTRL5] & 0x07) != 0x06 || odr == 0 || odr > 8)
+    {
+      next_us = now;
+      return;
+    }
+    const uint64_t period = static_cast<uint64_t>(1e6f / odr_hz[odr]);
+    while (next_us <= now)
+    {
+      push_set(static_cast<uint32_t>(next_us / 1000));
+      next_us += period;
+    }
+    const bool level = (regs[IMU_REG_INT1_CTRL] & 0x08) && words >= threshold();
+    sim_set_pin(sim.imu_int_pin, level);
+  }
+
+  void write(uint8_t reg, uint8_t val)
+  {
+    regs[reg & 0x7F] = val;
+    if (reg == IMU_REG_FIFO_CTRL5 && (val & 0x07) == 0)
+    {
+      words = 0;
+      read_words = 0;
+      over = false;
+    }
+  }
+
+  uint8_t read(uint8_t reg)
+  {
+    switch (reg)
+    {
+    case IMU_REG_FIFO_STATUS1:
+      return words & 0xFF;
+    case IMU_REG_FIFO_STATUS1 + 1:
+    {
+      uint8_t status = (words >> 8) & 0x0F;
+      status |= words >= threshold() ? IMU_FIFO_STATUS2_FTH : 0;
+      status |= over ? IMU_FIFO_STATUS2_OVER : 0;
+      status |= words == 0 ? IMU_FIFO_STATUS2_EMPTY : 0;
+      over = false;
+      return status;
+    }
+    case IMU_REG_FIFO_STATUS1 + 2:
+      return (read_words % IMU_FIFO_SET_WORDS) & 0xFF;
+    case IMU_REG_FIFO_STATUS1 + 3:
+      return 0;
+    case IMU_REG_FIFO_DATA_OUT_L:
+      high = 0;
+      if (words > 0)
+      {
+        const uint16_t word = static_cast<uint16_t>(fifo[head]);
+        head = (head + 1) % FIFO_WORDS;
+        words--;
+        read_words++;
+        high = word >> 8;
+        return word & 0xFF;
+      }
+      return 0;
+    case IMU_REG_FIFO_DATA_OUT_L + 1:
+      return high;
+    default:
+      return regs[reg & 0x7F];
+    }
+  }
+
+  bool auto_increment() const
+  {
+    return regs[IMU_REG_CTRL3_C] & 0x04;
+  }
+
+  // auto increment wraps the FIFO output back onto its low byte
+  static uint8_t next_reg(uint8_t reg)
+  {
+    return reg == IMU_REG_FIFO_DATA_OUT_L + 1 ? IMU_REG_FIFO_DATA_OUT_L : reg + 1;
+  }
+
+private:
+  size_t threshold() const
+  {
+    const size_t words = regs[IMU_REG_FIFO_CTRL1] | ((regs[IMU_REG_FIFO_CTRL2] & 0x0F) << 8);
+    return words == 0 ? FIFO_WORDS : words;
+  }
+
+  static int16_t to_raw(float val, float full_scale)
+  {
+    const float raw = roundf(val * 32768.0f / full_scale);
+    return static_cast<int16_t>(raw > 32767.0f ? 32767.0f : (raw < -32768.0f ? -32768.0f : raw));
+  }
+
+  void push_set(uint32_t t_ms)
+  {
+    static const float accel_fs[4] = {2.0f, 16.0f, 4.0f, 8.0f};
+    static const float gyro_fs[4] = {245.0f, 500.0f, 1000.0f, 2000.0f};
+    float accel[3];
+    float gyro[3];
+    IMU.sample(t_ms, accel, gyro);
+    // continuous mode overwrites the oldest set once the FIFO is full
+    if (words + IMU_FIFO_SET_WORDS > FIFO_WORDS)
+    {
+      head = (head + IMU_FIFO_SET_WORDS) % FIFO_WORDS;
+      words -= IMU_FIFO_SET_WORDS;
+      over = true;
+    }
+    for (size_t i = 0; i < 3; i++)
+    {
+      push(to_raw(gyro[i], gyro_fs[(regs[IMU_REG_CTRL2_G] >> 2) & 0x03]));
+    }
+    for (size_t i = 0; i < 3; i++)
+    {
+      push(to_raw(accel[i], accel_fs[(regs[IMU_REG_CTRL1_XL] >> 2) & 0x03]));
+    }
+  }
+
+  void push(int16_t word)
+  {
+    fifo[(head + words) % FIFO_WORDS] = word;
+    words++;
+  }
+
+  uint8_t regs[128] = {};
+  int16_t fifo[FIFO_WORDS] = {};
+  size_t head = 0;
+  size_t words = 0;
+  uint64_t next_us = 0;
+  uint32_t read_words = 0;
+  uint8_t high = 0;
+  bool over = false;
+};
+
+static lsm6ds3_sim imu_device;
+static uint8_t reg_pointer = 0;
+static uint32_t reads = 0;
+
+void sim_imu_update()
+{
+  imu_device.update();
+}
+
+void TwoWire::bus_time(size_t bytes)
+{
+  // start, address and a 9 bit frame per byte
+  sim_advance_us((bytes + 1) * 9 * 1000000ULL / clock_hz);
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+  this->address = address;
+  tx_len = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+  if (tx_len == sizeof(tx))
+  {
+    return 0;
+  }
+  tx[tx_len++] = data;
+  return 1;
+}
+
+uint8_t TwoWire::endTransmission(bool)
+{
+  bus_time(tx_len);
+  if (address != IMU_I2C_ADDRESS)
+  {
+    return 2;
+  }
+  imu_device.update();
+  if (tx_len > 0)
+  {
+    reg_pointer = tx[0];
+  }
+  const bool increment = imu_device.auto_increment();
+  for (size_t i = 1; i < tx_len; i++)
+  {
+    imu_device.write(reg_pointer, tx[i]);
+    if (increment)
+    {
+      reg_pointer++;
+    }
+  }
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, size_t quantity, bool)
+{
+  rx_len = 0;
+  rx_pos = 0;
+  bus_time(quantity);
+  if (address != IMU_I2C_ADDRESS)
+  {
+    return 0;
+  }
+  reads++;
+  if (sim.i2c_fail_every > 0 && reads % sim.i2c_fail_every == 0)
+  {
+    return 0;
+  }
+  imu_device.update();
+  const bool increment = imu_device.auto_increment();
+  while (rx_len < quantity && rx_len < sizeof(rx))
+  {
+    rx[rx_len++] = imu_device.read(reg_pointer);
+    if (increment)
+    {
+      reg_pointer = lsm6ds3_sim::next_reg(reg_pointer);
+    }
+  }
+  return rx_len;
+}
+
+int TwoWire::available()
+{
+  return rx_len - rx_pos;
+}
+
+int TwoWire::read()
+{
+  return rx_pos < rx_len ? rx[rx_pos++] : -1;
+}
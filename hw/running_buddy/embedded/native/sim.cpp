@@ -0,0 +1,41 @@
+/**
+ * @file sim.cpp
+ *
+ * virtual clock and settings of the native simulation, kept apart from
+ * sim_main.cpp so tests can drive setup() / loop() themselves.
+ */
+#include "sim.h"
+
+sim_config sim;
+
+static uint64_t now_us = 0;
+static bool trace_done = false;
+
+uint64_t sim_time_us()
+{
+  return now_us;
+}
+
+void sim_advance_us(uint64_t us)
+{
+  now_us += us;
+}
+
+void sim_trace_done()
+{
+  trace_done = true;
+}
+
+bool sim_finished()
+{
+  if (sim.duration_ms > 0)
+  {
+    return now_us / 1000 >= sim.duration_ms;
+  }
+  return trace_done;
+}
+
+std::string sim_path(const std::string &name)
+{
+  return sim.out_dir + "/" + name;
+}
@@ -0,0 +1,66 @@
+#ifndef SIM
+#define SIM
+
+#include <stdint.h>
+
+#include <string>
+
+/**
+ * settings and virtual clock of the native simulation
+ *
+ * the firmware runs against a virtual clock: delay() and every loop()
+ * iteration advance it without sleeping, so runs are faster than real time
+ * and fully deterministic for a given trace and button script.
+ */
+struct sim_config
+{
+  // accelerometer (and optional gyroscope) csv trace fed to the IMU
+  std::string trace_path;
+  // spacing of trace rows without a timestamp column
+  uint32_t sample_period_ms = 100;
+  // "t_ms,pad" lines replayed as touch events
+  std::string buttons_path;
+  // leds.log, display.ppm and the sd/ card directory are written here
+  std::string out_dir = "sim_out";
+  // stop after this much virtual time, 0 runs until the trace is consumed
+  uint32_t duration_ms = 0;
+  // virtual time spent per loop() iteration
+  uint32_t loop_us = 1000;
+  // MCU pin the fake LSM6DS3 drives with INT1, -1 leaves it unconnected
+  int imu_int_pin = -1;
+  // every nth I2C read from the fake LSM6DS3 is not acknowledged, 0 off
+  uint32_t i2c_fail_every = 0;
+  float temperature = 21.5f;
+  // synthetic display priority task busy for slow_task_ms every
+  // slow_task_period_ms, yielding to the scheduler between slices
+  uint32_t slow_task_ms = 0;
+  uint32_t slow_task_period_ms = 200;
+  uint32_t slow_task_slices = 1;
+  // exit with an error when a sensor task started later than this, 0 off
+  uint32_t max_sensor_late_us = 0;
+  // exit with an error when two IMU ticks were further apart than this, 0 off
+  uint32_t max_tick_gap_us = 0;
+  bool quiet = false;
+};
+
+extern sim_config sim;
+
+uint64_t sim_time_us();
+void sim_advance_us(uint64_t us);
+
+// true once the trace has been replayed or duration_ms has passed
+bool sim_finished();
+
+// called by the simulated peripherals
+void sim_trace_done();
+std::string sim_path(const std::string &name);
+// drives an input pin, running its interrupt handler on a matching edge
+void sim_set_pin(int pin, bool level);
+
+// lets the fake LSM6DS3 fill its FIFO up to the current time
+void sim_imu_update();
+
+// writes display.ppm and closes leds.log
+void sim_shutdown();
+
+#endif
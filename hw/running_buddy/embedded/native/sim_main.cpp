@@ -0,0 +1,205 @@
+/**
+ * @file sim_main.cpp
+ *
+ * runs the firmware's setup() / loop() on the host against the simulated
+ * carrier in virtual time.
+ *
+ * usage: program [--trace file.csv] [--period ms] [--buttons file.csv]
+ *                [--out dir] [--duration ms] [--loop-us us]
+ *                [--imu-int-pin pin] [--i2c-fail-every n] [--temperature c] [--quiet]
+ *                [--slow-task ms[,period_ms[,slices]]]
+ *                [--max-sensor-late-us us] [--max-tick-gap-us us]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <chrono>
+
+#include "scheduler.h"
+#include "sim.h"
+
+void setup();
+void loop();
+
+extern scheduler tasks;
+extern uint32_t worst_tick_gap_us;
+
+void end_session();
+
+// stands in for work like a long redraw, what it delays shows in the
+// sched,... lines
+static void slow_task()
+{
+  const uint64_t slice_us = sim.slow_task_ms * 1000ULL / sim.slow_task_slices;
+  for (uint32_t i = 0; i < sim.slow_task_slices; i++)
+  {
+    if (i > 0)
+    {
+      tasks.yield(task_priority::DISPLAY);
+    }
+    sim_advance_us(slice_us);
+  }
+}
+
+static bool parse_slow_task(const char *arg)
+{
+  char *end;
+  sim.slow_task_ms = strtoul(arg, &end, 10);
+  if (*end == ',')
+  {
+    sim.slow_task_period_ms = strtoul(end + 1, &end, 10);
+  }
+  if (*end == ',')
+  {
+    sim.slow_task_slices = strtoul(end + 1, &end, 10);
+  }
+  return *end == '\0' && sim.slow_task_ms > 0 && sim.slow_task_period_ms > 0 && sim.slow_task_slices > 0;
+}
+
+// worst start delay of the sensor tasks against --max-sensor-late-us
+static bool check_sensor_tasks()
+{
+  bool ok = true;
+  for (size_t i = 0; i < tasks.count(); i++)
+  {
+    const task &t = tasks.at(i);
+    if (t.priority != task_priority::SENSOR)
+    {
+      continue;
+    }
+    fprintf(stderr, "%s: max_late_us=%u deadline_misses=%u skipped=%u\n", t.name,
+            static_cast<unsigned>(t.stats.max_late_us), static_cast<unsigned>(t.stats.deadline_misses),
+            static_cast<unsigned>(t.stats.skipped));
+    if (sim.max_sensor_late_us > 0 && t.stats.max_late_us > sim.max_sensor_late_us)
+    {
+      fprintf(stderr, "%s started %u us late, more than %u us\n", t.name,
+              static_cast<unsigned>(t.stats.max_late_us), static_cast<unsigned>(sim.max_sensor_late_us));
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+// longest pause between IMU ticks, e.g. behind a LED frame, against
+// --max-tick-gap-us
+static bool check_tick_gap()
+{
+  fprintf(stderr, "imu: max_tick_gap_us=%u\n", static_cast<unsigned>(worst_tick_gap_us));
+  if (sim.max_tick_gap_us > 0 && worst_tick_gap_us > sim.max_tick_gap_us)
+  {
+    fprintf(stderr, "imu ticks were %u us apart, more than %u us\n", static_cast<unsigned>(worst_tick_gap_us),
+            static_cast<unsigned>(sim.max_tick_gap_us));
+    return false;
+  }
+  return true;
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [--trace file.csv] [--period ms] [--buttons file.csv] [--out dir]\n"
+          "          [--duration ms] [--loop-us us] [--imu-int-pin pin] [--i2c-fail-every n]\n"
+          "          [--temperature c] [--quiet] [--slow-task ms[,period_ms[,slices]]]\n"
+          "          [--max-sensor-late-us us] [--max-tick-gap-us us]\n",
+          name);
+}
+
+int main(int argc, char **argv)
+{
+  for (int i = 1; i < argc; i++)
+  {
+    const bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--quiet") == 0)
+    {
+      sim.quiet = true;
+    }
+    else if (strcmp(argv[i], "--trace") == 0 && has_value)
+    {
+      sim.trace_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--period") == 0 && has_value)
+    {
+      sim.sample_period_ms = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--buttons") == 0 && has_value)
+    {
+      sim.buttons_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--out") == 0 && has_value)
+    {
+      sim.out_dir = argv[++i];
+    }
+    else if (strcmp(argv[i], "--duration") == 0 && has_value)
+    {
+      sim.duration_ms = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--loop-us") == 0 && has_value)
+    {
+      sim.loop_us = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--imu-int-pin") == 0 && has_value)
+    {
+      sim.imu_int_pin = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--i2c-fail-every") == 0 && has_value)
+    {
+      sim.i2c_fail_every = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--temperature") == 0 && has_value)
+    {
+      sim.temperature = strtof(argv[++i], nullptr);
+    }
+    else if (strcmp(argv[i], "--slow-task") == 0 && has_value && parse_slow_task(argv[i + 1]))
+    {
+      i++;
+    }
+    else if (strcmp(argv[i], "--max-sensor-late-us") == 0 && has_value)
+    {
+      sim.max_sensor_late_us = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--max-tick-gap-us") == 0 && has_value)
+    {
+      sim.max_tick_gap_us = strtoul(argv[++i], nullptr, 10);
+    }
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (sim.trace_path.empty() && sim.duration_ms == 0)
+  {
+    sim.duration_ms = 60000;
+  }
+  if (sim.loop_us == 0 || sim.sample_period_ms == 0)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+  mkdir(sim.out_dir.c_str(), 0755);
+
+  const auto start = std::chrono::steady_clock::now();
+  setup();
+  if (sim.slow_task_ms > 0)
+  {
+    tasks.every("slow", sim.slow_task_period_ms, task_priority::DISPLAY, slow_task);
+  }
+  while (!sim_finished())
+  {
+    sim_imu_update();
+    loop();
+    sim_advance_us(sim.loop_us);
+  }
+  // like ending the session with pads 1 and 3 before switching off
+  end_session();
+  sim_shutdown();
+  const double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const double sim_s = sim_time_us() / 1e6;
+
+  fprintf(stderr, "simulated %.1f s in %.3f s (%.0fx real time)\n",
+          sim_s, wall_s, wall_s > 0 ? sim_s / wall_s : 0.0);
+  const bool sensors_ok = check_sensor_tasks();
+  return check_tick_gap() && sensors_ok ? 0 : 1;
+}
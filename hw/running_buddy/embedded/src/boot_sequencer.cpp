@@ -0,0 +1,65 @@
+#include "boot_sequencer.h"
+
+boot_sequencer::boot_sequencer(const boot_phase *phases, size_t count)
+    : phases(phases), count(count > BOOT_MAX_PHASES ? BOOT_MAX_PHASES : count)
+{
+}
+
+void boot_sequencer::begin(uint32_t now_ms)
+{
+  current = 0;
+  has_failed = false;
+  phase_started = false;
+  start_ms = now_ms;
+  finished_ms = now_ms;
+}
+
+bool boot_sequencer::step(uint32_t now_ms)
+{
+  if (done() || has_failed)
+  {
+    return done();
+  }
+  if (!phase_started)
+  {
+    phase_started = true;
+    phase_start_ms = now_ms;
+  }
+  const boot_status status = phases[current].run(now_ms - phase_start_ms);
+  if (status == boot_status::WAIT)
+  {
+    return false;
+  }
+  // the phase itself may have taken a while
+  const uint32_t end_ms = millis();
+  durations[current] = end_ms - phase_start_ms;
+  if (status == boot_status::FAILED)
+  {
+    has_failed = true;
+    finished_ms = end_ms;
+    return false;
+  }
+  current++;
+  phase_started = false;
+  if (done())
+  {
+    finished_ms = end_ms;
+    return true;
+  }
+  return false;
+}
+
+void boot_sequencer::report(Print &out) const
+{
+  const size_t ran = has_failed ? current + 1 : current;
+  for (size_t i = 0; i < ran; i++)
+  {
+    out.print("boot,");
+    out.print(phases[i].name);
+    out.print(",");
+    out.print(durations[i]);
+    out.println(i == current ? ",failed" : "");
+  }
+  out.print("boot,total,");
+  out.println(finished_ms - start_ms);
+}
@@ -0,0 +1,245 @@
+#include "imu_fifo.h"
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// full scales set in begin()
+#define ACCEL_G_PER_LSB (4.0f / 32768.0f)
+#define GYRO_DPS_PER_LSB (2000.0f / 32768.0f)
+
+// CTRL1_XL / CTRL2_G low nibbles: +-4 g with 100 Hz anti-aliasing, 2000 dps
+#define CTRL1_XL_FS_4G_BW_100 0x0A
+#define CTRL2_G_FS_2000 0x0C
+// CTRL3_C: block data update, register address auto increment
+#define CTRL3_C_BDU_IF_INC 0x44
+// FIFO_CTRL3: both sensors in the FIFO without decimation
+#define FIFO_CTRL3_NO_DECIMATION 0x09
+#define FIFO_MODE_BYPASS 0x00
+#define FIFO_MODE_CONTINUOUS 0x06
+#define INT1_FTH 0x08
+
+// FIFO holds 4096 words
+#define FIFO_MAX_SETS (4096 / IMU_FIFO_SET_WORDS)
+
+static volatile bool watermark_irq = false;
+
+static void on_watermark()
+{
+  watermark_irq = true;
+}
+
+// ODR code shared by CTRL1_XL, CTRL2_G and FIFO_CTRL5, 0 if unsupported
+static uint8_t odr_code(uint16_t odr_hz)
+{
+  switch (odr_hz)
+  {
+  case 13:
+    return 1;
+  case 26:
+    return 2;
+  case 52:
+    return 3;
+  case 104:
+    return 4;
+  case 208:
+    return 5;
+  case 416:
+    return 6;
+  case 833:
+    return 7;
+  case 1660:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+static int16_t word_at(const uint8_t *data, size_t i)
+{
+  return static_cast<int16_t>(data[2 * i] | (data[2 * i + 1] << 8));
+}
+
+bool imu_fifo::read_registers(uint8_t reg, uint8_t *data, size_t len)
+{
+  Wire.beginTransmission(IMU_I2C_ADDRESS);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0 || Wire.requestFrom(IMU_I2C_ADDRESS, len) != len)
+  {
+    counters.i2c_errors++;
+    return false;
+  }
+  for (size_t i = 0; i < len; i++)
+  {
+    data[i] = Wire.read();
+  }
+  return true;
+}
+
+bool imu_fifo::write_register(uint8_t reg, uint8_t val)
+{
+  Wire.beginTransmission(IMU_I2C_ADDRESS);
+  Wire.write(reg);
+  Wire.write(val);
+  if (Wire.endTransmission() != 0)
+  {
+    counters.i2c_errors++;
+    return false;
+  }
+  return true;
+}
+
+bool imu_fifo::begin(uint16_t odr_hz, uint16_t watermark_sets, int interrupt_pin)
+{
+  const uint8_t odr = odr_code(odr_hz);
+  if (odr == 0 || watermark_sets == 0 || watermark_sets > FIFO_MAX_SETS)
+  {
+    return false;
+  }
+  period_us = 1000000UL / odr_hz;
+  watermark = watermark_sets;
+  this->interrupt_pin = interrupt_pin;
+  timed = false;
+  counters = imu_fifo_stats();
+
+  // the FIFO threshold counts 16 bit words
+  const uint16_t threshold = watermark_sets * IMU_FIFO_SET_WORDS;
+  const bool ok = write_register(IMU_REG_FIFO_CTRL5, FIFO_MODE_BYPASS) &&
+                  write_register(IMU_REG_CTRL3_C, CTRL3_C_BDU_IF_INC) &&
+                  write_register(IMU_REG_CTRL1_XL, (odr << 4) | CTRL1_XL_FS_4G_BW_100) &&
+                  write_register(IMU_REG_CTRL2_G, (odr << 4) | CTRL2_G_FS_2000) &&
+                  write_register(IMU_REG_FIFO_CTRL1, threshold & 0xFF) &&
+                  write_register(IMU_REG_FIFO_CTRL2, (threshold >> 8) & 0x0F) &&
+                  write_register(IMU_REG_FIFO_CTRL3, FIFO_CTRL3_NO_DECIMATION) &&
+                  write_register(IMU_REG_FIFO_CTRL4, 0) &&
+                  write_register(IMU_REG_INT1_CTRL, interrupt_pin >= 0 ? INT1_FTH : 0) &&
+                  write_register(IMU_REG_FIFO_CTRL5, (odr << 3) | FIFO_MODE_CONTINUOUS);
+  if (!ok)
+  {
+    return false;
+  }
+  if (interrupt_pin >= 0)
+  {
+    watermark_irq = false;
+    pinMode(interrupt_pin, INPUT);
+    attachInterrupt(digitalPinToInterrupt(interrupt_pin), on_watermark, RISING);
+  }
+  return true;
+}
+
+uint32_t imu_fifo::stamp(uint32_t anchor_us)
+{
+  // follow the drain time slowly so I2C and scheduling jitter does not leak
+  // into the sample spacing, but resync after a gap or overrun
+  if (timed)
+  {
+    const uint32_t expected = last_t_us + period_us;
+    const int32_t error = static_cast<int32_t>(anchor_us - expected);
+    if (error < 4 * static_cast<int32_t>(period_us) && error > -4 * static_cast<int32_t>(period_us))
+    {
+      anchor_us = expected + error / 16;
+    }
+  }
+  timed = true;
+  last_t_us = anchor_us;
+  return anchor_us;
+}
+
+size_t imu_fifo::poll(imu_batch_handler handler)
+{
+  if (period_us == 0)
+  {
+    return 0;
+  }
+  if (interrupt_pin >= 0)
+  {
+    // INT1 stays high while the FIFO is over the watermark and only a new
+    // RISING edge sets the flag, so after a failed or short drain the level
+    // is what says to drain again
+    if (!watermark_irq && digitalRead(interrupt_pin) != HIGH)
+    {
+      return 0;
+    }
+    watermark_irq = false;
+  }
+
+  const uint32_t start = micros();
+  uint8_t status[4];
+  if (!read_registers(IMU_REG_FIFO_STATUS1, status, sizeof(status)))
+  {
+    return 0;
+  }
+  if (interrupt_pin < 0 && !(status[1] & IMU_FIFO_STATUS2_FTH))
+  {
+    return 0;
+  }
+  if (status[1] & IMU_FIFO_STATUS2_OVER)
+  {
+    counters.overruns++;
+    timed = false;
+  }
+  uint16_t words = status[0] | ((status[1] & 0x0F) << 8);
+  const uint16_t pattern = status[2] | ((status[3] & 0x03) << 8);
+
+  // drop the tail of a partly read set so the next word is a gyro x
+  uint8_t data[IMU_FIFO_CHUNK_SETS * IMU_FIFO_SET_WORDS * 2];
+  if (pattern != 0 && words > 0)
+  {
+    const uint16_t skip = IMU_FIFO_SET_WORDS - pattern;
+    if (skip > words || !read_registers(IMU_REG_FIFO_DATA_OUT_L, data, skip * 2))
+    {
+      return 0;
+    }
+    words -= skip;
+    counters.realigned_words += skip;
+  }
+
+  const uint16_t sets = words / IMU_FIFO_SET_WORDS;
+  if (sets > counters.max_fifo_sets)
+  {
+    counters.max_fifo_sets = sets;
+  }
+  size_t pending = 0;
+  size_t delivered = 0;
+  for (uint16_t done = 0; done < sets;)
+  {
+    const uint16_t chunk = sets - done < IMU_FIFO_CHUNK_SETS ? sets - done : IMU_FIFO_CHUNK_SETS;
+    if (!read_registers(IMU_REG_FIFO_DATA_OUT_L, data, chunk * IMU_FIFO_SET_WORDS * 2))
+    {
+      timed = false;
+      break;
+    }
+    for (uint16_t i = 0; i < chunk; i++, done++)
+    {
+      // the newest set was sampled just before the status read
+      imu_sample &sample = batch[pending++];
+      sample.t_us = stamp(start - (sets - 1 - done) * period_us);
+      for (size_t axis = 0; axis < 3; axis++)
+      {
+        sample.gyro[axis] = word_at(data, i * IMU_FIFO_SET_WORDS + axis) * GYRO_DPS_PER_LSB;
+        sample.accel[axis] = word_at(data, i * IMU_FIFO_SET_WORDS + 3 + axis) * ACCEL_G_PER_LSB;
+      }
+      if (pending == IMU_FIFO_BATCH)
+      {
+        handler(batch, pending);
+        counters.batches++;
+        delivered += pending;
+        pending = 0;
+      }
+    }
+  }
+  if (pending > 0)
+  {
+    handler(batch, pending);
+    counters.batches++;
+    delivered += pending;
+  }
+
+  counters.drains++;
+  counters.samples += delivered;
+  counters.last_drain_us = micros() - start;
+  if (counters.last_drain_us > counters.max_drain_us)
+  {
+    counters.max_drain_us = counters.last_drain_us;
+  }
+  return delivered;
+}
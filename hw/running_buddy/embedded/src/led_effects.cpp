@@ -0,0 +1,175 @@
+#include "led_effects.h"
+
+#include <Arduino.h>
+
+static uint8_t lerp8(uint8_t a, uint8_t b, uint8_t frac)
+{
+  return a + ((static_cast<int16_t>(b) - a) * frac) / 255;
+}
+
+led_effect led_effect::solid(const CRGB &color)
+{
+  led_effect effect;
+  effect.color = color;
+  return effect;
+}
+
+led_effect led_effect::blink(const CRGB &color, uint16_t period_ms, uint16_t cycles)
+{
+  led_effect effect;
+  effect.kind = effect_kind::BLINK;
+  effect.color = color;
+  effect.period_ms = period_ms > 0 ? period_ms : 1;
+  effect.cycles = cycles;
+  return effect;
+}
+
+led_effect led_effect::fade(const CRGB &from, const CRGB &to, uint16_t duration_ms)
+{
+  led_effect effect;
+  effect.kind = effect_kind::FADE;
+  effect.from = from;
+  effect.color = to;
+  effect.period_ms = duration_ms;
+  return effect;
+}
+
+led_effect led_effect::pulse(const CRGB &color, uint16_t period_ms, uint16_t cycles)
+{
+  led_effect effect = blink(color, period_ms, cycles);
+  effect.kind = effect_kind::PULSE;
+  return effect;
+}
+
+bool led_effect::finished(uint32_t elapsed_ms) const
+{
+  switch (kind)
+  {
+  case effect_kind::SOLID:
+    return true;
+  case effect_kind::FADE:
+    return elapsed_ms >= period_ms;
+  default:
+    return cycles > 0 && elapsed_ms >= static_cast<uint32_t>(period_ms) * cycles;
+  }
+}
+
+CRGB led_effect::at(uint32_t elapsed_ms) const
+{
+  const CRGB off = CRGB::Black;
+  switch (kind)
+  {
+  case effect_kind::SOLID:
+    return color;
+  case effect_kind::FADE:
+  {
+    if (elapsed_ms >= period_ms)
+    {
+      return color;
+    }
+    const uint8_t frac = elapsed_ms * 255 / period_ms;
+    return CRGB(lerp8(from.r, color.r, frac), lerp8(from.g, color.g, frac), lerp8(from.b, color.b, frac));
+  }
+  case effect_kind::BLINK:
+    if (finished(elapsed_ms))
+    {
+      return off;
+    }
+    return elapsed_ms % period_ms < period_ms / 2 ? color : off;
+  case effect_kind::PULSE:
+  {
+    if (finished(elapsed_ms))
+    {
+      return off;
+    }
+    // 0 -> 255 -> 0 over a period
+    const uint32_t phase = elapsed_ms % period_ms * 510 / period_ms;
+    CRGB scaled = color;
+    scaled.nscale8(phase > 255 ? 510 - phase : phase);
+    return scaled;
+  }
+  default:
+    return off;
+  }
+}
+
+void led_engine::begin(Adafruit_DotStar &carrier_leds, CRGB *strip, uint16_t strip_len)
+{
+  this->carrier_leds = &carrier_leds;
+  this->strip = strip;
+  this->strip_len = strip_len;
+}
+
+void led_engine::play(uint8_t channel, const led_effect &effect)
+{
+  if (channel >= LED_CHANNELS)
+  {
+    return;
+  }
+  channel_state &state = channels[channel];
+  state.effect = effect;
+  state.started = false;
+  state.done = false;
+}
+
+CRGB led_engine::color(uint8_t channel) const
+{
+  return channel < LED_CHANNELS ? channels[channel].shown : CRGB(CRGB::Black);
+}
+
+void led_engine::frame(uint32_t now_ms)
+{
+  const uint32_t start = micros();
+  bool carrier_dirty = false;
+  bool strip_dirty = false;
+  for (uint8_t i = 0; i < LED_CHANNELS; i++)
+  {
+    channel_state &state = channels[i];
+    if (state.done)
+    {
+      continue;
+    }
+    // effects start on the frame after play(), so timing does not depend
+    // on where in the frame they were requested
+    if (!state.started)
+    {
+      state.started = true;
+      state.start_ms = now_ms;
+    }
+    const uint32_t elapsed = now_ms - state.start_ms;
+    const CRGB next = state.effect.at(elapsed);
+    state.done = state.effect.finished(elapsed);
+    if (next == state.shown)
+    {
+      continue;
+    }
+    state.shown = next;
+    if (i == LED_STRIP_CHANNEL)
+    {
+      fill_solid(strip, strip_len, next);
+      strip_dirty = true;
+    }
+    else
+    {
+      carrier_leds->setPixelColor(i, carrier_leds->Color(next.r, next.g, next.b));
+      carrier_dirty = true;
+    }
+  }
+
+  if (carrier_dirty)
+  {
+    carrier_leds->show();
+    counters.carrier_shows++;
+  }
+  if (strip_dirty)
+  {
+    FastLED.show();
+    counters.strip_shows++;
+  }
+  counters.frames++;
+  counters.last_frame_us = micros() - start;
+  if (counters.last_frame_us > counters.max_frame_us)
+  {
+    counters.max_frame_us = counters.last_frame_us;
+  }
+}
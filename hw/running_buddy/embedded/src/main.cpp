@@ -1,29 +1,49 @@
 #include <Arduino.h>
 #include <Arduino_MKRIoTCarrier.h>
 #include <FastLED.h>
-#include <sstream>
-#include <arduino-timer.h>
+#include <Wire.h>
 #include <math.h>
-#include <deque>
-#include <numeric>
-#include <iterator>
 #include <limits>
 #include <vector>
 
+#include "boot_sequencer.h"
 #include "carriers.h"
+#include "config.h"
+#include "fixed_string.h"
+#include "imu_fifo.h"
+#include "led_effects.h"
+#include "log_format.h"
+#include "mem_stats.h"
+#include "orientation.h"
+#include "scheduler.h"
+#include "sd_logger.h"
+#include "step_detector.h"
+#include "stride_estimator.h"
+#include "turn_detector.h"
+#include "ui.h"
+#include "vec3.h"
 
 #define NUM_LEDS 16
 
 #define BAUD_RATE 115200
 
-#define ACCEL_QUEUE_SIZE 20
-#define STEP_THRESHOLD 0.3
-#define DELTA_STEP_MS 350
+#define LOG_FLUSH_MS 2000
+#define LOG_STATS_MS 10000
+#define DISPLAY_MS 500
 
-#define TURN_QUEUE_SIZE 20
-#define LEFT_TURN_THRESHOLD -0.05
-#define RIGHT_TURN_THRESHOLD 0.05
-#define DELTA_TURN 100
+// longest expected runs, longer ones count as overruns in the sched,...
+// lines. a FIFO drain of 9 samples takes ~3 ms at IMU_I2C_CLOCK_HZ
+#define IMU_BUDGET_US 5000
+#define LED_BUDGET_US 2000
+#define DISPLAY_BUDGET_US 50000
+
+// power up margin before carrier.begin(), this used to be a 1.5 s delay
+#define BOOT_SETTLE_MS 100
+// the splash stays up at least this long, sampling already runs behind it
+#define BOOT_SPLASH_MS 1000
+// loading_logo in carriers.h
+#define LOGO_WIDTH 120
+#define LOGO_HEIGHT 121
 
 #define LEFT_LED 3
 #define RIGHT_LED 1
@@ -32,20 +52,31 @@
 #define LED_TYPE WS2811
 #define COLOR_ORDER GRB
 
+// 50 fps
+#define LED_FRAME_MS 20
+#define LED_FADE_MS 300
+// turn signal on LEFT_LED / RIGHT_LED while a turn lasts
+#define TURN_PULSE_MS 500
+#define SESSION_END_BLINK_MS 400
+
+// the calibrated Weinberg constant, kept on the SD card across sessions
+#define STRIDE_FILE "stride.txt"
+
 CRGBArray<NUM_LEDS> leds;
 
 uint8_t brightness = 128;
 
 MKRIoTCarrier carrier;
 
-std::ostringstream ss;
+ui_screen screen(carrier.display);
 
-auto timer = timer_create_default();
+scheduler tasks;
 
-void clear_ss()
+// display work is broken up with this, sampling and LED frames that come
+// due in between run first
+void yield_to_sensors()
 {
-  ss.str("");
-  ss.clear();
+  tasks.yield(task_priority::DISPLAY);
 }
 
 void update_brightness()
@@ -53,172 +84,380 @@ void update_brightness()
   FastLED.setBrightness(brightness);
 }
 
+led_engine led_fx;
+
 void setup_LEDs()
 {
   FastLED.addLeds<LED_TYPE, LED_PIN, COLOR_ORDER>(leds, NUM_LEDS).setCorrection(TypicalLEDStrip);
   update_brightness();
+  led_fx.begin(carrier.leds, leds, NUM_LEDS);
 }
 
-void setup_carrier()
+void handle_leds()
 {
-  delay(1500);
-  CARRIER_CASE = false;
-  if (!carrier.begin())
-  {
-    Serial.println("Carrier not connected, check connections");
-    for (;;)
-    {
-      delay(1000);
-    }
-  }
-  while (!carrier.IMUmodule.accelerationAvailable())
-  {
-    Serial.println("wait accel");
-    delay(100);
-  }
-  Serial.println("done with setup");
-  delay(1000);
+  led_fx.frame(millis());
+}
 
-  // show loading screen
-  carrier.display.fillScreen(0x0000);
-  carrier.display.setRotation(2); // rotate 180 degrees
-  carrier.display.setTextWrap(true);
-  carrier.display.drawBitmap(60, 30, loading_logo, 120, 121, 0xFFFF);
-  carrier.display.setTextColor(0xFFFF);
-  carrier.display.setTextSize(3);
-  carrier.display.setCursor(35, 160);
-  carrier.display.print("Loading...");
-  delay(4000);
+sd_logger logger;
+const String file_name = "data.bin";
+
+template <typename R>
+void log_record(R &record, record_type type, uint32_t timestamp_ms = millis())
+{
+  init_record(record, type, timestamp_ms);
+  logger.write(&record, sizeof(record));
+}
+
+void log_session()
+{
+  session_record record;
+  record.magic = LOG_MAGIC;
+  record.version = LOG_FORMAT_VERSION;
+  record.reserved = 0;
+  record.accel_lsb_per_g = ACCEL_LSB_PER_G;
+  record.gyro_lsb_per_dps = GYRO_LSB_PER_DPS;
+  log_record(record, record_type::SESSION);
 }
 
-double mean(const std::deque<double> &vec)
+void log_touch(uint8_t pad, const char *name)
 {
-  double avg = std::accumulate(vec.begin(), vec.end(), 0.0) / vec.size();
-  return avg;
+  Serial.println(name);
+  touch_record record;
+  record.pad = pad;
+  log_record(record, record_type::TOUCH);
 }
 
-bool data_filter(std::deque<double> &hist_data, const size_t &queue_size, const int &delta,
-                 const std::vector<float> &data, uint32_t &last_time, bool normalize = true,
-                 const double &min_threshold = std::numeric_limits<double>::max(),
-                 const double &max_threshold = std::numeric_limits<double>::min())
+void log_mode(mode_kind kind, uint8_t value)
 {
-  double sum = std::accumulate(data.begin(), data.end(), 0.0, [normalize](double total, double curr)
-                               { return total + (normalize ? pow(curr, 2) : curr); });
-  double val = normalize ? sqrt(sum) : sum;
-  hist_data.push_back(val);
-  if (hist_data.size() <= queue_size)
+  mode_record record;
+  record.kind = static_cast<uint8_t>(kind);
+  record.value = value;
+  log_record(record, record_type::MODE);
+}
+
+imu_fifo imu;
+// false when the FIFO could not be set up and the accelerometer is polled
+bool imu_fifo_active = false;
+
+// allocations made inside the sensor tick since boot, expected to stay 0
+uint32_t tick_allocations = 0;
+// longest time between two sensor ticks since the last stats report
+uint32_t last_tick_us = 0;
+uint32_t max_tick_gap_us = 0;
+// the same since boot, the native sim checks it against --max-tick-gap-us
+uint32_t worst_tick_gap_us = 0;
+
+void handle_stats()
+{
+  const logger_stats &stats = logger.stats();
+  Serial.print("logger,records=");
+  Serial.print(stats.records);
+  Serial.print(",dropped=");
+  Serial.print(stats.dropped_records);
+  Serial.print(",bytes=");
+  Serial.print(stats.bytes_written);
+  Serial.print(",padding=");
+  Serial.print(stats.padding_bytes);
+  Serial.print(",flushes=");
+  Serial.print(stats.flushes);
+  Serial.print(",max_flush_us=");
+  Serial.print(stats.max_flush_us);
+  Serial.print(",avg_flush_us=");
+  Serial.println(stats.flushes == 0 ? 0 : stats.total_flush_us / stats.flushes);
+
+  const mem_stats &mem = get_mem_stats();
+  Serial.print("mem,allocations=");
+  Serial.print(mem.allocations);
+  Serial.print(",frees=");
+  Serial.print(mem.frees);
+  Serial.print(",heap=");
+  Serial.print(mem.heap_in_use);
+  Serial.print(",heap_high_water=");
+  Serial.print(mem.heap_high_water);
+  Serial.print(",tick_allocations=");
+  Serial.println(tick_allocations);
+
+  const imu_fifo_stats &fifo = imu.stats();
+  Serial.print("imu,samples=");
+  Serial.print(fifo.samples);
+  Serial.print(",drains=");
+  Serial.print(fifo.drains);
+  Serial.print(",overruns=");
+  Serial.print(fifo.overruns);
+  Serial.print(",max_fifo_sets=");
+  Serial.print(fifo.max_fifo_sets);
+  Serial.print(",max_drain_us=");
+  Serial.print(fifo.max_drain_us);
+  Serial.print(",i2c_errors=");
+  Serial.print(fifo.i2c_errors);
+  Serial.print(",max_tick_gap_us=");
+  Serial.println(max_tick_gap_us);
+  max_tick_gap_us = 0;
+
+  const ui_stats &ui = screen.stats();
+  Serial.print("display,frames=");
+  Serial.print(ui.frames);
+  Serial.print(",idle_frames=");
+  Serial.print(ui.idle_frames);
+  Serial.print(",windows=");
+  Serial.print(ui.windows);
+  Serial.print(",bytes=");
+  Serial.print(ui.bytes_pushed);
+  Serial.print(",last_frame_us=");
+  Serial.print(ui.last_frame_us);
+  Serial.print(",max_frame_us=");
+  Serial.println(ui.max_frame_us);
+
+  const led_stats &led = led_fx.stats();
+  Serial.print("leds,frames=");
+  Serial.print(led.frames);
+  Serial.print(",carrier_shows=");
+  Serial.print(led.carrier_shows);
+  Serial.print(",strip_shows=");
+  Serial.print(led.strip_shows);
+  Serial.print(",last_frame_us=");
+  Serial.print(led.last_frame_us);
+  Serial.print(",max_frame_us=");
+  Serial.println(led.max_frame_us);
+
+  tasks.report(Serial);
+}
+
+void log_data(const vec3 &accel, const vec3 &gyro, uint32_t timestamp_ms)
+{
+  accel_record accel_rec;
+  gyro_record gyro_rec;
+  for (size_t i = 0; i < 3; i++)
+  {
+    accel_rec.accel[i] = to_fixed(accel[i], ACCEL_LSB_PER_G);
+    gyro_rec.gyro[i] = to_fixed(gyro[i], GYRO_LSB_PER_DPS);
+  }
+  log_record(accel_rec, record_type::ACCEL, timestamp_ms);
+  log_record(gyro_rec, record_type::GYRO, timestamp_ms);
+
+#if SERIAL_CSV
+  for (size_t i = 0; i < 3; i++)
   {
-    return false;
+    Serial.print(accel[i], 3);
+    Serial.print(", ");
   }
-  hist_data.pop_front();
-  uint32_t curr_time = millis();
-  if (last_time + delta > curr_time)
+  for (size_t i = 0; i < 3; i++)
   {
-    return false;
+    Serial.print(gyro[i], 2);
+    Serial.print(i < 2 ? ", " : "\r\n");
   }
-  double avg = abs(mean(hist_data));
-  double normalized_val = val + (val < 0 ? avg : -avg);
+#endif
+}
 
-  if (normalized_val > min_threshold || normalized_val < max_threshold)
+uint64_t steps = 0;
+orientation fusion;
+step_detector detector;
+turn_detector turns;
+stride_estimator strides;
+uint32_t first_sample_ms = 0;
+
+// the indicator a turn took over and what it showed before
+uint8_t turn_led = LEFT_LED;
+CRGB turn_led_color;
+
+void handle_turn(turn_event event, uint32_t now_ms)
+{
+  if (event == turn_event::STARTED)
   {
-    return false;
+    turn_led = turns.direction() > 0 ? LEFT_LED : RIGHT_LED;
+    turn_led_color = led_fx.color(turn_led);
+    led_fx.play(turn_led, led_effect::pulse(CRGB(255, 96, 0), TURN_PULSE_MS));
+    return;
   }
-  last_time = curr_time;
-  return true;
+  led_fx.play(turn_led, led_effect::solid(turn_led_color));
+
+  Serial.print(turns.direction() > 0 ? "turn,left,deg=" : "turn,right,deg=");
+  Serial.print(static_cast<int>(fabsf(turns.turn_deg()) + 0.5f));
+  Serial.print(",ms=");
+  Serial.print(turns.turn_ms());
+  Serial.print(",heading=");
+  Serial.println(static_cast<int>(turns.heading_deg() + 0.5f));
+  turn_record record;
+  record.angle_ddeg = to_fixed(turns.turn_deg(), 10);
+  record.duration_ms = turns.turn_ms() > UINT16_MAX ? UINT16_MAX : turns.turn_ms();
+  log_record(record, record_type::TURN, now_ms);
 }
 
-File file;
-const String file_name = "data.csv";
+void handle_stride(uint32_t now_ms)
+{
+  const float stride_m = strides.step(now_ms, detector.cadence_spm());
+  const float pace = strides.pace_s_per_km(now_ms);
+  Serial.print("stride,m=");
+  Serial.print(stride_m);
+  Serial.print(",distance=");
+  Serial.print(static_cast<unsigned long>(strides.distance_m()));
+  Serial.print(",pace=");
+  Serial.println(static_cast<unsigned long>(pace + 0.5f));
+  stride_record record;
+  record.stride_mm = static_cast<uint16_t>(stride_m * 1000.0f + 0.5f);
+  record.distance_dm = static_cast<uint32_t>(strides.distance_m() * 10.0f);
+  record.pace_s_per_km = pace > UINT16_MAX ? UINT16_MAX : static_cast<uint16_t>(pace + 0.5f);
+  log_record(record, record_type::STRIDE, now_ms);
+}
 
-void log_data_sd(String data)
+// one IMU sample feeds every detector, t_us is when it was taken and now_ms
+// the same on the millis() clock
+void handle_sample(const vec3 &accel, const vec3 &gyro, uint32_t t_us, uint32_t now_ms)
 {
-  file = SD.open(file_name.c_str(), FILE_WRITE);
+  if (first_sample_ms == 0)
+  {
+    first_sample_ms = now_ms;
+  }
+  log_data(accel, gyro, now_ms);
 
-  if (file)
+  // the detectors see the world frame, the same however the carrier is worn
+  fusion.update(accel, gyro, t_us);
+  const float vertical_g = fusion.linear_accel(accel)[2];
+  strides.update(vertical_g);
+  if (detector.update(vertical_g, now_ms))
   {
-    Serial.println(data);
-    file.println(data);
-    file.close();
+    steps++;
+    Serial.print("step,");
+    Serial.print((unsigned long)steps);
+    Serial.print(",cadence=");
+    Serial.println(static_cast<int>(detector.cadence_spm() + 0.5f));
+    step_record record;
+    record.steps = steps;
+    log_record(record, record_type::STEP, now_ms);
+    handle_stride(now_ms);
   }
-  else
+
+  const turn_event event = turns.update(fusion.yaw_rate(gyro), now_ms);
+  if (event != turn_event::NONE)
   {
-    Serial.println(data);
+    handle_turn(event, now_ms);
   }
 }
 
-void log_data(std::vector<float> &data)
+void handle_imu_batch(const imu_sample *samples, size_t count)
 {
-  std::ostringstream oss;
-  oss << "gyro,";
-  std::copy(data.begin(), data.end(), std::ostream_iterator<int>(oss, ", "));
-  log_data_sd(oss.str().c_str());
+  // move sample times onto millis() by their age, micros() wraps after 71 min
+  const uint32_t now_us = micros();
+  const uint32_t now_ms = millis();
+  for (size_t i = 0; i < count; i++)
+  {
+    handle_sample(samples[i].accel, samples[i].gyro, samples[i].t_us, now_ms - (now_us - samples[i].t_us) / 1000);
+  }
 }
 
-uint64_t steps = 0;
-uint32_t last_step = millis();
-std::deque<double> hist_accel;
-
-bool handle_step(void *)
+void handle_imu()
 {
-  std::vector<float> data(3, 0);
-  carrier.IMUmodule.readAcceleration(data[0], data[1], data[2]);
-  log_data(data);
-
-  if (data_filter(hist_accel, ACCEL_QUEUE_SIZE, DELTA_STEP_MS,
-                  data, last_step, true,
-                  std::numeric_limits<double>::max(), STEP_THRESHOLD))
+  const uint32_t now_us = micros();
+  if (last_tick_us != 0 && now_us - last_tick_us > max_tick_gap_us)
   {
-    steps++;
-    ss << "step," << steps;
-    log_data_sd(ss.str().c_str());
-    clear_ss();
+    max_tick_gap_us = now_us - last_tick_us;
+    worst_tick_gap_us = max_tick_gap_us > worst_tick_gap_us ? max_tick_gap_us : worst_tick_gap_us;
   }
+  last_tick_us = now_us;
 
-  return true;
+  const uint32_t allocations = allocation_count();
+  if (imu_fifo_active)
+  {
+    imu.poll(handle_imu_batch);
+  }
+  else
+  {
+    vec3 accel;
+    vec3 gyro;
+    carrier.IMUmodule.readAcceleration(accel[0], accel[1], accel[2]);
+    carrier.IMUmodule.readGyroscope(gyro[0], gyro[1], gyro[2]);
+    handle_sample(accel, gyro, micros(), millis());
+  }
+  tick_allocations += allocation_count() - allocations;
 }
 
 const int text_size = 3;
-const int text_size_x = text_size * 6;
-const int text_size_y = text_size * 8;
+
+// the old 15 character box at x = 80 ran off the panel and wrapped
+const int value_x = 24;
+const int value_y = 160;
+const int value_chars = 11;
+
+ui_label steps_title(54, 40, 5, text_size, 0xFFFF);
+ui_bitmap steps_icon(70, 60, steps_logo, 100, 100, 0xF621);
+ui_value steps_value(value_x, value_y, value_chars, text_size, 0xFFFF);
+ui_widget *steps_widgets[] = {&steps_title, &steps_icon, &steps_value};
+
+ui_label temperature_title(54, 40, 5, text_size, 0xFFFF);
+ui_bitmap temperature_icon(70, 60, temperature_logo, 100, 100, 0xF621);
+ui_value temperature_value(value_x, value_y, value_chars, text_size, 0xFFFF);
+ui_widget *temperature_widgets[] = {&temperature_title, &temperature_icon, &temperature_value};
+
+// the run modes have no icon, a second smaller line goes under the value
+const int run_value_y = 100;
+const int detail_size = 2;
+
+ui_label distance_title(54, 40, 5, text_size, 0xFFFF);
+ui_value distance_value(value_x, run_value_y, value_chars, text_size, 0xFFFF);
+ui_label distance_detail(value_x, value_y, UI_MAX_CHARS, detail_size, 0xF621);
+ui_widget *distance_widgets[] = {&distance_title, &distance_value, &distance_detail};
+
+ui_label pace_title(54, 40, 5, text_size, 0xFFFF);
+ui_label pace_value(value_x, run_value_y, value_chars, text_size, 0xFFFF);
+ui_value pace_detail(value_x, value_y, UI_MAX_CHARS, detail_size, 0xF621);
+ui_widget *pace_widgets[] = {&pace_title, &pace_value, &pace_detail};
 
 void show_steps()
 {
-  const int start = 80;
-  const int line = 160;
-  const int message_space = 15;
+  steps_value.set(steps, " steps");
+}
 
-  carrier.display.setCursor(start, line);
-  carrier.display.fillRect(start, line - 5, message_space * text_size_x, text_size_y + 5, 0x0000);
-  ss << steps << " steps";
-  carrier.display.setCursor(start, line);
-  carrier.display.print(ss.str().c_str());
-  clear_ss();
+void show_distance()
+{
+  distance_value.set(strides.distance_m() / 1000.0f, " km");
+  fixed_string<UI_MAX_CHARS + 1> detail;
+  if (strides.calibrating())
+  {
+    detail << "cal " << static_cast<unsigned long>(strides.calibration_steps()) << " steps";
+  }
+  else
+  {
+    detail << "stride " << strides.stride_m() << " m";
+  }
+  distance_detail.set(detail.c_str());
 }
 
-void show_temperature()
+void show_pace()
 {
-  const int start = 80;
-  const int line = 160;
-  const int message_space = 15;
+  const uint32_t pace = static_cast<uint32_t>(strides.pace_s_per_km(millis()) + 0.5f);
+  fixed_string<UI_MAX_CHARS + 1> value;
+  if (pace == 0 || pace >= 100 * 60)
+  {
+    value << "--:--";
+  }
+  else
+  {
+    value << static_cast<unsigned long>(pace / 60) << (pace % 60 < 10 ? ":0" : ":") << static_cast<unsigned long>(pace % 60);
+  }
+  value << " /km";
+  pace_value.set(value.c_str());
+  pace_detail.set(static_cast<int>(detector.cadence_spm() + 0.5f), " spm");
+}
 
-  carrier.display.fillRect(start, line - 5, message_space * text_size_x, text_size_y + 5, 0x0000);
-  float temperature = carrier.Env.readTemperature();
-  carrier.display.setCursor(start, line);
-  carrier.display.print(temperature);
-  carrier.display.print(" C");
+void show_temperature()
+{
+  temperature_value.set(carrier.Env.readTemperature(), " C");
 }
 
+// the values are logged, new modes go at the end
 enum class mode_type
 {
   STEPS,
-  TEMPERATURE
+  TEMPERATURE,
+  DISTANCE,
+  PACE
 };
 
-std::vector<mode_type> modes = {mode_type::STEPS, mode_type::TEMPERATURE};
+std::vector<mode_type> modes = {mode_type::STEPS, mode_type::DISTANCE, mode_type::PACE, mode_type::TEMPERATURE};
 
 size_t curr_mode_idx = modes.size() - 1;
 
-bool handle_display(void *)
+void handle_display()
 {
   mode_type curr_mode = modes[curr_mode_idx];
   switch (curr_mode)
@@ -226,13 +465,19 @@ bool handle_display(void *)
   case mode_type::STEPS:
     show_steps();
     break;
+  case mode_type::DISTANCE:
+    show_distance();
+    break;
+  case mode_type::PACE:
+    show_pace();
+    break;
   case mode_type::TEMPERATURE:
     show_temperature();
     break;
   default:
     break;
   }
-  return true;
+  screen.render();
 }
 
 CRGB off_color = CRGB::Black;
@@ -241,53 +486,72 @@ CRGB curr_color = off_color;
 
 void handle_color(CRGB on_color, uint16_t pixel)
 {
-  const uint32_t led_color = curr_color == off_color ? carrier.leds.Color(255, 0, 0) : carrier.leds.Color(0, 0, 0);
-  carrier.leds.setPixelColor(pixel, led_color);
-  carrier.leds.show();
-  curr_color = curr_color == off_color ? on_color : off_color;
-  fill_solid(leds, NUM_LEDS, curr_color);
-  FastLED.show();
-  delay(50);
+  const bool turn_on = curr_color == off_color;
+  led_fx.play(pixel, led_effect::solid(turn_on ? CRGB(255, 0, 0) : off_color));
+  const CRGB next_color = turn_on ? on_color : off_color;
+  led_fx.play(LED_STRIP_CHANNEL, led_effect::fade(led_fx.color(LED_STRIP_CHANNEL), next_color, LED_FADE_MS));
+  curr_color = next_color;
 }
 
 void setup_steps_display()
 {
-  carrier.display.fillScreen(0x0000);
-  carrier.display.setCursor(54, 40);
-  carrier.display.setTextSize(text_size);
-  carrier.display.print("Steps");
-  carrier.display.drawBitmap(70, 60, steps_logo, 100, 100, 0xF621);
+  steps_title.set("Steps");
+  show_steps();
+  screen.show(steps_widgets, sizeof(steps_widgets) / sizeof(steps_widgets[0]));
+  screen.render();
+}
+
+void setup_distance_display()
+{
+  distance_title.set("Dist");
+  show_distance();
+  screen.show(distance_widgets, sizeof(distance_widgets) / sizeof(distance_widgets[0]));
+  screen.render();
+}
+
+void setup_pace_display()
+{
+  pace_title.set("Pace");
+  show_pace();
+  screen.show(pace_widgets, sizeof(pace_widgets) / sizeof(pace_widgets[0]));
+  screen.render();
 }
 
 void setup_temperature_display()
 {
-  carrier.display.fillScreen(0x0000);
-  carrier.display.setCursor(54, 40);
-  carrier.display.setTextSize(text_size);
-  carrier.display.print("Temp");
-  carrier.display.drawBitmap(70, 60, temperature_logo, 100, 100, 0xF621);
+  temperature_title.set("Temp");
+  show_temperature();
+  screen.show(temperature_widgets, sizeof(temperature_widgets) / sizeof(temperature_widgets[0]));
+  screen.render();
 }
 
 void toggle_display(bool right_direction = true)
 {
-  curr_mode_idx = (curr_mode_idx + (right_direction ? 1 : -1)) % modes.size();
+  curr_mode_idx = (curr_mode_idx + (right_direction ? 1 : modes.size() - 1)) % modes.size();
   mode_type curr_mode = modes[curr_mode_idx];
-  uint32_t led_color = 0;
+  CRGB led_color = off_color;
   switch (curr_mode)
   {
   case mode_type::STEPS:
-    led_color = carrier.leds.Color(0, 64, 0);
+    led_color = CRGB(0, 64, 0);
     setup_steps_display();
     break;
+  case mode_type::DISTANCE:
+    led_color = CRGB(0, 0, 64);
+    setup_distance_display();
+    break;
+  case mode_type::PACE:
+    led_color = CRGB(64, 32, 0);
+    setup_pace_display();
+    break;
   case mode_type::TEMPERATURE:
-    led_color = carrier.leds.Color(64, 0, 0);
+    led_color = CRGB(64, 0, 0);
     setup_temperature_display();
   default:
     break;
   }
-  carrier.leds.setPixelColor(right_direction ? 1 : 3, led_color);
-  carrier.leds.show();
-  delay(50);
+  log_mode(mode_kind::DISPLAY, static_cast<uint8_t>(curr_mode));
+  led_fx.play(right_direction ? RIGHT_LED : LEFT_LED, led_effect::solid(led_color));
 }
 
 // TODO - use relay to activate buzzer
@@ -296,54 +560,279 @@ void setup_buzzer()
   carrier.Relay1.close();
 }
 
+void setup_imu()
+{
+  Wire.setClock(IMU_I2C_CLOCK_HZ);
+  imu_fifo_active = imu.begin(IMU_ODR_HZ, IMU_FIFO_WATERMARK, IMU_INT_PIN);
+  if (!imu_fifo_active)
+  {
+    Serial.println("imu fifo unavailable, polling accelerometer");
+  }
+  detector.set_period_us(imu_fifo_active ? imu.sample_period_us() : STEP_SAMPLE_MS * 1000UL);
+}
+
 void setup_sd()
 {
   // SD.remove((char *)file_name.c_str());
-  // file = SD.open(file_name.c_str(), FILE_WRITE);
-  // file.close();
+  if (!logger.begin(file_name.c_str(), LOG_FLUSH_MS))
+  {
+    Serial.println("could not open log file, logging to serial only");
+    return;
+  }
+  log_session();
 }
 
-void setup()
+// writes out what the logger holds and closes data.bin, so the board can be
+// switched off without losing the end of the session
+void end_session()
+{
+  if (!logger.is_open())
+  {
+    return;
+  }
+  logger.end();
+  Serial.println("log,closed");
+}
+
+bool carrier_ready = false;
+uint32_t splash_ms = 0;
+
+boot_status boot_settle(uint32_t elapsed_ms)
+{
+  return elapsed_ms >= BOOT_SETTLE_MS ? boot_status::DONE : boot_status::WAIT;
+}
+
+boot_status boot_carrier(uint32_t)
+{
+  CARRIER_CASE = false;
+  if (!carrier.begin())
+  {
+    Serial.println("Carrier not connected, check connections");
+    return boot_status::FAILED;
+  }
+  carrier_ready = true;
+  return boot_status::DONE;
+}
+
+void load_stride_k()
+{
+  File file = SD.open(STRIDE_FILE);
+  if (!file)
+  {
+    return;
+  }
+  char text[16] = {};
+  for (size_t i = 0; i < sizeof(text) - 1 && file.available(); i++)
+  {
+    text[i] = file.read();
+  }
+  file.close();
+  if (!strides.set_k(atof(text)))
+  {
+    Serial.println("ignoring the stride calibration, k out of range");
+  }
+}
+
+void save_stride_k()
+{
+  // FILE_WRITE appends
+  SD.remove(STRIDE_FILE);
+  File file = SD.open(STRIDE_FILE, FILE_WRITE);
+  if (!file)
+  {
+    Serial.println("could not save the stride calibration");
+    return;
+  }
+  file.println(strides.k(), 4);
+  file.close();
+}
+
+boot_status boot_sd(uint32_t)
 {
-  Serial.begin(BAUD_RATE);
-  setup_carrier();
-  setup_LEDs();
   setup_sd();
+  load_stride_k();
+  Serial.print("stride,k=");
+  Serial.println(strides.k(), 4);
+  return boot_status::DONE;
+}
+
+void handle_calibration()
+{
+  if (!strides.calibrating())
+  {
+    strides.calibrate_start();
+    Serial.println("stride,calibrating");
+    return;
+  }
+  if (!strides.calibrate_end(STRIDE_CALIBRATION_M))
+  {
+    Serial.print("stride,calibration_failed,steps=");
+    Serial.println(static_cast<unsigned long>(strides.calibration_steps()));
+    return;
+  }
+  save_stride_k();
+  Serial.print("stride,k=");
+  Serial.println(strides.k(), 4);
+}
+
+boot_status boot_imu(uint32_t)
+{
+  if (!carrier.IMUmodule.accelerationAvailable())
+  {
+    return boot_status::WAIT;
+  }
+  setup_imu();
+  tasks.every("imu", imu_fifo_active ? IMU_POLL_MS : STEP_SAMPLE_MS, task_priority::SENSOR, handle_imu,
+              IMU_BUDGET_US);
+  return boot_status::DONE;
+}
+
+boot_status boot_splash(uint32_t)
+{
+  // sampling already runs, so the ~60 ms of drawing is split like a redraw
+  for (int16_t y = 0; y < carrier.display.height(); y += UI_CLEAR_ROWS)
+  {
+    carrier.display.fillRect(0, y, carrier.display.width(), UI_CLEAR_ROWS, 0x0000);
+    yield_to_sensors();
+  }
+  carrier.display.setRotation(2); // rotate 180 degrees
+  carrier.display.setTextWrap(true);
+  // the logo too, in bands of rows of its 1 bit bitmap
+  for (int16_t y = 0; y < LOGO_HEIGHT; y += UI_CLEAR_ROWS)
+  {
+    const int16_t rows = LOGO_HEIGHT - y < UI_CLEAR_ROWS ? LOGO_HEIGHT - y : UI_CLEAR_ROWS;
+    carrier.display.drawBitmap(60, 30 + y, loading_logo + y * ((LOGO_WIDTH + 7) / 8), LOGO_WIDTH, rows, 0xFFFF);
+    yield_to_sensors();
+  }
+  carrier.display.setTextColor(0xFFFF);
+  carrier.display.setTextSize(3);
+  carrier.display.setCursor(35, 160);
+  carrier.display.print("Loading...");
+  splash_ms = millis();
+  return boot_status::DONE;
+}
+
+boot_status boot_leds(uint32_t)
+{
+  setup_LEDs();
   fill_solid(leds, NUM_LEDS, CRGB::Black);
   FastLED.show();
+  tasks.every("leds", LED_FRAME_MS, task_priority::LEDS, handle_leds, LED_BUDGET_US);
+  return boot_status::DONE;
+}
+
+boot_status boot_relay(uint32_t)
+{
   setup_buzzer();
-  delay(5000);
+  return boot_status::DONE;
+}
+
+boot_status boot_display(uint32_t)
+{
+  if (millis() - splash_ms < BOOT_SPLASH_MS)
+  {
+    return boot_status::WAIT;
+  }
+  screen.set_yield(yield_to_sensors);
   toggle_display();
-  timer.every(500, handle_display);
-  timer.every(100, handle_step);
+  tasks.every("display", DISPLAY_MS, task_priority::DISPLAY, handle_display, DISPLAY_BUDGET_US);
+  tasks.every("stats", LOG_STATS_MS, task_priority::BACKGROUND, handle_stats);
+  return boot_status::DONE;
+}
+
+// sampling starts as soon as the IMU is up, the rest boots around it
+const boot_phase boot_phases[] = {
+    {"settle", boot_settle},
+    {"carrier", boot_carrier},
+    {"sd", boot_sd},
+    {"imu", boot_imu},
+    {"splash", boot_splash},
+    {"leds", boot_leds},
+    {"relay", boot_relay},
+    {"display", boot_display},
+};
+
+boot_sequencer boot(boot_phases, sizeof(boot_phases) / sizeof(boot_phases[0]));
+
+void setup()
+{
+  Serial.begin(BAUD_RATE);
+  boot.begin(millis());
+}
+
+void step_boot()
+{
+  if (boot.step(millis()) || boot.failed())
+  {
+    boot.report(Serial);
+    Serial.print("boot,first_sample,");
+    Serial.println(first_sample_ms);
+  }
 }
 
 void loop()
 {
+  if (!boot.done() && !boot.failed())
+  {
+    step_boot();
+  }
+
   // update loop
-  carrier.Buttons.update();
-  timer.tick();
+  if (carrier_ready)
+  {
+    carrier.Buttons.update();
+  }
+  tasks.tick();
+  logger.poll();
+  if (!boot.done())
+  {
+    return;
+  }
 
+  // pads 1 and 3 together end the session before the power is switched
+  // off, the strip blinks red. again starts a new session
+  if ((carrier.Buttons.onTouchDown(TOUCH1) && carrier.Buttons.getTouch(TOUCH3)) ||
+      (carrier.Buttons.onTouchDown(TOUCH3) && carrier.Buttons.getTouch(TOUCH1)))
+  {
+    if (logger.is_open())
+    {
+      end_session();
+      led_fx.play(LED_STRIP_CHANNEL, led_effect::blink(CRGB(255, 0, 0), SESSION_END_BLINK_MS, 3));
+    }
+    else
+    {
+      setup_sd();
+    }
+    return;
+  }
   if (carrier.Buttons.onTouchDown(TOUCH0))
   {
     // night
-    log_data_sd("night_mode,");
+    log_touch(0, "night_mode,");
     handle_color(CRGB::Aqua, 0);
+    log_mode(mode_kind::LIGHT, curr_color == off_color ? LIGHT_OFF : LIGHT_NIGHT);
   }
   if (carrier.Buttons.onTouchDown(TOUCH4))
   {
     // day
-    log_data_sd("day_mode,");
+    log_touch(4, "day_mode,");
     handle_color(CRGB::White, 4);
+    log_mode(mode_kind::LIGHT, curr_color == off_color ? LIGHT_OFF : LIGHT_DAY);
   }
   if (carrier.Buttons.onTouchDown(TOUCH1))
   {
-    log_data_sd("toggle_display_left,");
+    log_touch(1, "toggle_display_left,");
     toggle_display(true);
   }
   if (carrier.Buttons.onTouchDown(TOUCH3))
   {
-    log_data_sd("toggle_display_right,");
+    log_touch(3, "toggle_display_right,");
     toggle_display(false);
   }
+  if (carrier.Buttons.onTouchDown(TOUCH2))
+  {
+    // pressed at the start and the end of a STRIDE_CALIBRATION_M lap
+    log_touch(2, "stride_calibration,");
+    handle_calibration();
+  }
 }
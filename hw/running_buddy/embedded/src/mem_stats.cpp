@@ -0,0 +1,96 @@
+#include <malloc.h>
+#include <stddef.h>
+
+#include "mem_stats.h"
+
+static mem_stats counters = {0, 0, 0, 0};
+
+static void on_alloc(void *ptr)
+{
+  if (!ptr)
+  {
+    return;
+  }
+  counters.allocations++;
+  counters.heap_in_use += malloc_usable_size(ptr);
+  if (counters.heap_in_use > counters.heap_high_water)
+  {
+    counters.heap_high_water = counters.heap_in_use;
+  }
+}
+
+static void on_free(uint32_t size)
+{
+  counters.frees++;
+  counters.heap_in_use = size > counters.heap_in_use ? 0 : counters.heap_in_use - size;
+}
+
+static void on_free(void *ptr)
+{
+  if (!ptr)
+  {
+    return;
+  }
+  on_free(static_cast<uint32_t>(malloc_usable_size(ptr)));
+}
+
+const mem_stats &get_mem_stats()
+{
+  return counters;
+}
+
+void reset_heap_high_water()
+{
+  counters.heap_high_water = counters.heap_in_use;
+}
+
+#ifdef NATIVE
+#define REAL(fn) __libc_##fn
+#define WRAP(fn) fn
+#else
+#define REAL(fn) __real_##fn
+#define WRAP(fn) __wrap_##fn
+#endif
+
+extern "C"
+{
+  void *REAL(malloc)(size_t size);
+  void *REAL(calloc)(size_t count, size_t size);
+  void *REAL(realloc)(void *ptr, size_t size);
+  void REAL(free)(void *ptr);
+
+  void *WRAP(malloc)(size_t size)
+  {
+    void *ptr = REAL(malloc)(size);
+    on_alloc(ptr);
+    return ptr;
+  }
+
+  void *WRAP(calloc)(size_t count, size_t size)
+  {
+    void *ptr = REAL(calloc)(count, size);
+    on_alloc(ptr);
+    return ptr;
+  }
+
+  void *WRAP(realloc)(void *ptr, size_t size)
+  {
+    // the old block may be gone afterwards, its size is taken first
+    const uint32_t old_size = ptr ? malloc_usable_size(ptr) : 0;
+    void *moved = REAL(realloc)(ptr, size);
+    // a failed realloc leaves the old block as it was, except that a size
+    // of 0 frees it
+    if (ptr && (moved || size == 0))
+    {
+      on_free(old_size);
+    }
+    on_alloc(moved);
+    return moved;
+  }
+
+  void WRAP(free)(void *ptr)
+  {
+    on_free(ptr);
+    REAL(free)(ptr);
+  }
+}
@@ -0,0 +1,126 @@
+#include "orientation.h"
+
+#define RAD_PER_DEG 0.017453292f
+
+static void normalize(quat &q)
+{
+  const float n = inv_sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+  q.w *= n;
+  q.x *= n;
+  q.y *= n;
+  q.z *= n;
+}
+
+void orientation::update(const vec3 &accel, const vec3 &gyro, uint32_t t_us)
+{
+  const float norm_sq = accel[0] * accel[0] + accel[1] * accel[1] + accel[2] * accel[2];
+  if (!started)
+  {
+    if (norm_sq < 0.01f)
+    {
+      return;
+    }
+    // the rotation taking the measured up onto world z
+    const float n = inv_sqrt(norm_sq);
+    const float ax = accel[0] * n;
+    const float ay = accel[1] * n;
+    const float az = accel[2] * n;
+    if (az < -0.999f)
+    {
+      q.w = 0.0f;
+      q.x = 1.0f;
+      q.y = q.z = 0.0f;
+    }
+    else
+    {
+      q.w = 1.0f + az;
+      q.x = ay;
+      q.y = -ax;
+      q.z = 0.0f;
+      normalize(q);
+    }
+    started = true;
+    last_us = t_us;
+    return;
+  }
+  const uint32_t dt_us = t_us - last_us;
+  last_us = t_us;
+  if (dt_us == 0 || dt_us > ORIENTATION_MAX_DT_US)
+  {
+    return;
+  }
+  const float dt = dt_us * 1e-6f;
+
+  // q' = q (0, w) / 2
+  const float gx = gyro[0] * RAD_PER_DEG;
+  const float gy = gyro[1] * RAD_PER_DEG;
+  const float gz = gyro[2] * RAD_PER_DEG;
+  float dw = 0.5f * (-q.x * gx - q.y * gy - q.z * gz);
+  float dx = 0.5f * (q.w * gx + q.y * gz - q.z * gy);
+  float dy = 0.5f * (q.w * gy - q.x * gz + q.z * gx);
+  float dz = 0.5f * (q.w * gz + q.x * gy - q.y * gx);
+
+  // one gradient step on |R(q)^T z - a|^2, faded out away from 1 g
+  const float inv_norm = norm_sq > 0.01f ? inv_sqrt(norm_sq) : 0.0f;
+  const float off_g = norm_sq * inv_norm - 1.0f;
+  const float weight = 1.0f - (off_g < 0 ? -off_g : off_g) * (1.0f / ORIENTATION_ACCEL_TOLERANCE_G);
+  if (inv_norm > 0 && weight > 0)
+  {
+    const float ax = accel[0] * inv_norm;
+    const float ay = accel[1] * inv_norm;
+    const float az = accel[2] * inv_norm;
+    const float fx = 2.0f * (q.x * q.z - q.w * q.y) - ax;
+    const float fy = 2.0f * (q.w * q.x + q.y * q.z) - ay;
+    const float fz = 1.0f - 2.0f * (q.x * q.x + q.y * q.y) - az;
+    float sw = -2.0f * q.y * fx + 2.0f * q.x * fy;
+    float sx = 2.0f * q.z * fx + 2.0f * q.w * fy - 4.0f * q.x * fz;
+    float sy = -2.0f * q.w * fx + 2.0f * q.z * fy - 4.0f * q.y * fz;
+    float sz = 2.0f * q.x * fx + 2.0f * q.y * fy;
+    const float s_sq = sw * sw + sx * sx + sy * sy + sz * sz;
+    if (s_sq > 1e-12f)
+    {
+      const float gain = ORIENTATION_BETA * weight * inv_sqrt(s_sq);
+      dw -= gain * sw;
+      dx -= gain * sx;
+      dy -= gain * sy;
+      dz -= gain * sz;
+    }
+  }
+
+  q.w += dw * dt;
+  q.x += dx * dt;
+  q.y += dy * dt;
+  q.z += dz * dt;
+  normalize(q);
+}
+
+vec3 orientation::to_world(const vec3 &v) const
+{
+  const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+  const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+  const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+  vec3 out;
+  out[0] = (1.0f - 2.0f * (yy + zz)) * v[0] + 2.0f * (xy - wz) * v[1] + 2.0f * (xz + wy) * v[2];
+  out[1] = 2.0f * (xy + wz) * v[0] + (1.0f - 2.0f * (xx + zz)) * v[1] + 2.0f * (yz - wx) * v[2];
+  out[2] = 2.0f * (xz - wy) * v[0] + 2.0f * (yz + wx) * v[1] + (1.0f - 2.0f * (xx + yy)) * v[2];
+  return out;
+}
+
+vec3 orientation::linear_accel(const vec3 &accel) const
+{
+  vec3 out = to_world(accel);
+  out[2] -= 1.0f;
+  return out;
+}
+
+float orientation::yaw_rate(const vec3 &gyro) const
+{
+  // the z row of to_world() alone
+  return 2.0f * (q.x * q.z - q.w * q.y) * gyro[0] + 2.0f * (q.y * q.z + q.w * q.x) * gyro[1] +
+         (1.0f - 2.0f * (q.x * q.x + q.y * q.y)) * gyro[2];
+}
+
+void orientation::reset()
+{
+  *this = orientation();
+}
@@ -0,0 +1,119 @@
+#include "scheduler.h"
+
+bool scheduler::every(const char *name, uint32_t period_ms, task_priority priority, void (*run)(), uint32_t budget_us)
+{
+  if (task_count == SCHEDULER_MAX_TASKS || period_ms == 0)
+  {
+    return false;
+  }
+  task &t = tasks[task_count++];
+  t.name = name;
+  t.run = run;
+  t.period_us = period_ms * 1000UL;
+  t.priority = priority;
+  t.budget_us = budget_us;
+  t.due_us = micros() + t.period_us;
+  t.stats = task_stats();
+  return true;
+}
+
+int scheduler::next_due(uint32_t now_us, uint8_t below, uint32_t skip) const
+{
+  int best = -1;
+  for (size_t i = 0; i < task_count; i++)
+  {
+    const task &t = tasks[i];
+    if ((skip & (1UL << i)) || static_cast<uint8_t>(t.priority) >= below ||
+        static_cast<int32_t>(now_us - t.due_us) < 0)
+    {
+      continue;
+    }
+    if (best < 0 || t.priority < tasks[best].priority ||
+        (t.priority == tasks[best].priority && static_cast<int32_t>(t.due_us - tasks[best].due_us) < 0))
+    {
+      best = i;
+    }
+  }
+  return best;
+}
+
+void scheduler::run(task &t, uint32_t start_us)
+{
+  const uint32_t due_us = t.due_us;
+  const uint8_t outer = running;
+  running = static_cast<uint8_t>(t.priority);
+  t.run();
+  running = outer;
+  const uint32_t end_us = micros();
+
+  task_stats &s = t.stats;
+  const uint32_t took_us = end_us - start_us;
+  s.runs++;
+  s.total_us += took_us;
+  s.max_us = took_us > s.max_us ? took_us : s.max_us;
+  s.max_late_us = start_us - due_us > s.max_late_us ? start_us - due_us : s.max_late_us;
+  s.deadline_misses += end_us - due_us > t.period_us;
+  s.overruns += t.budget_us > 0 && took_us > t.budget_us;
+
+  // one late release still runs, older ones are dropped
+  t.due_us = due_us + t.period_us;
+  if (static_cast<int32_t>(end_us - t.due_us) >= static_cast<int32_t>(t.period_us))
+  {
+    const uint32_t behind = (end_us - t.due_us) / t.period_us;
+    s.skipped += behind;
+    t.due_us += behind * t.period_us;
+  }
+}
+
+size_t scheduler::tick()
+{
+  // every task runs at most once per tick, so one that takes longer than
+  // its period cannot keep loop() from getting to the buttons
+  uint32_t ran = 0;
+  size_t count = 0;
+  for (;;)
+  {
+    const uint32_t now_us = micros();
+    const int best = next_due(now_us, running, ran);
+    if (best < 0)
+    {
+      return count;
+    }
+    ran |= 1UL << best;
+    run(tasks[best], now_us);
+    count++;
+  }
+}
+
+void scheduler::yield(task_priority caller)
+{
+  const uint8_t outer = running;
+  running = static_cast<uint8_t>(caller) < running ? static_cast<uint8_t>(caller) : running;
+  tick();
+  running = outer;
+}
+
+void scheduler::report(Print &out) const
+{
+  for (size_t i = 0; i < task_count; i++)
+  {
+    const task &t = tasks[i];
+    const task_stats &s = t.stats;
+    out.print("sched,");
+    out.print(t.name);
+    out.print(",runs=");
+    out.print(s.runs);
+    out.print(",avg_us=");
+    out.print(s.runs == 0 ? 0 : static_cast<uint32_t>(s.total_us / s.runs));
+    out.print(",max_us=");
+    out.print(s.max_us);
+    out.print(",max_late_us=");
+    out.print(s.max_late_us);
+    out.print(",deadline_misses=");
+    out.print(s.deadline_misses);
+    out.print(",overruns=");
+    out.print(s.overruns);
+    out.print(",skipped=");
+    out.println(s.skipped);
+  }
+}
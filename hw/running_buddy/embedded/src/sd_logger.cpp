@@ -0,0 +1,142 @@
+#include <string.h>
+
+#include "sd_logger.h"
+
+bool sd_logger::begin(const char *file_name, uint32_t flush_interval_ms, size_t flush_size)
+{
+  file = SD.open(file_name, FILE_WRITE);
+  if (!file)
+  {
+    open = false;
+    return false;
+  }
+  open = true;
+  this->flush_interval_ms = flush_interval_ms;
+  this->flush_size = flush_size;
+  file_pos = file.size();
+  fill = 0;
+  pending = false;
+  // first buffer only runs up to the next block boundary of the file
+  limit = SD_BLOCK_SIZE - file_pos % SD_BLOCK_SIZE;
+  return true;
+}
+
+bool sd_logger::write(const void *data, size_t len)
+{
+  const bool fits = len <= limit - fill;
+  if (!open || len > SD_BLOCK_SIZE || (!fits && pending))
+  {
+    counters.dropped_records++;
+    return false;
+  }
+  if (!fits)
+  {
+    memset(buffers[active] + fill, 0, limit - fill);
+    counters.padding_bytes += limit - fill;
+    fill = limit;
+    seal();
+  }
+  if (fill == 0)
+  {
+    first_write_ms = millis();
+  }
+  memcpy(buffers[active] + fill, data, len);
+  fill += len;
+  if (fill == limit && !pending)
+  {
+    seal();
+  }
+  counters.records++;
+  return true;
+}
+
+void sd_logger::seal()
+{
+  pending = true;
+  pending_len = fill;
+  active ^= 1;
+  fill = 0;
+  limit = SD_BLOCK_SIZE;
+}
+
+void sd_logger::write_out(const uint8_t *data, size_t len)
+{
+  const uint32_t start = micros();
+  const size_t written = file.write(data, len);
+  const uint32_t elapsed = micros() - start;
+
+  if (written != len)
+  {
+    counters.write_errors++;
+  }
+  file_pos += len;
+  counters.bytes_written += written;
+  counters.flushes++;
+  counters.last_flush_us = elapsed;
+  counters.total_flush_us += elapsed;
+  if (elapsed > counters.max_flush_us)
+  {
+    counters.max_flush_us = elapsed;
+  }
+}
+
+void sd_logger::poll()
+{
+  if (!open)
+  {
+    return;
+  }
+  for (;;)
+  {
+    if (!pending && fill == limit)
+    {
+      seal();
+    }
+    if (!pending)
+    {
+      break;
+    }
+    write_out(buffers[active ^ 1], pending_len);
+    pending = false;
+  }
+  if (fill == 0)
+  {
+    return;
+  }
+  if (fill >= flush_size || (flush_interval_ms > 0 && millis() - first_write_ms >= flush_interval_ms))
+  {
+    flush();
+  }
+}
+
+void sd_logger::flush()
+{
+  if (!open)
+  {
+    return;
+  }
+  if (pending)
+  {
+    write_out(buffers[active ^ 1], pending_len);
+    pending = false;
+  }
+  if (fill > 0)
+  {
+    write_out(buffers[active], fill);
+    fill = 0;
+    limit = SD_BLOCK_SIZE - file_pos % SD_BLOCK_SIZE;
+  }
+  file.flush();
+  counters.syncs++;
+}
+
+void sd_logger::end()
+{
+  if (!open)
+  {
+    return;
+  }
+  flush();
+  file.close();
+  open = false;
+}
@@ -0,0 +1,131 @@
+#include <math.h>
+
+#include "step_detector.h"
+
+// weight of a new sample in a moving average with time constant tau
+static float blend(uint32_t period_us, uint32_t tau_ms)
+{
+  return static_cast<float>(period_us) / (tau_ms * 1000.0f + period_us);
+}
+
+// |x| as x * (1 / sqrt(x)), sqrtf is emulated on the SAMD21
+static float root(float x)
+{
+  return x > 0.0f ? x * inv_sqrt(x) : 0.0f;
+}
+
+step_detector::step_detector(uint32_t period_us)
+{
+  set_period_us(period_us);
+}
+
+void step_detector::set_period_us(uint32_t period_us)
+{
+  this->period_us = period_us;
+  smooth_weight = blend(period_us, STEP_SMOOTH_MS);
+  baseline_weight = blend(period_us, STEP_BASELINE_MS);
+  variance_weight = blend(period_us, STEP_VARIANCE_MS);
+}
+
+bool step_detector::update(const vec3 &accel, uint32_t now_ms)
+{
+  return update(root(accel[0] * accel[0] + accel[1] * accel[1] + accel[2] * accel[2]), now_ms);
+}
+
+bool step_detector::update(float accel_g, uint32_t now_ms)
+{
+  if (!started)
+  {
+    started = true;
+    smooth = baseline = accel_g;
+    return false;
+  }
+  smooth += smooth_weight * (accel_g - smooth);
+  baseline += baseline_weight * (smooth - baseline);
+  const float x = smooth - baseline;
+  variance += variance_weight * (x * x - variance);
+
+  if (count > 0 && now_ms - step_ms > STEP_MAX_INTERVAL_MS)
+  {
+    interval_ms = 0;
+    long_intervals = 0;
+  }
+
+  const float sigma = root(variance);
+  const float peak_threshold = fmaxf(STEP_PEAK_SIGMA * sigma, STEP_MIN_PEAK_G);
+  bool stepped = false;
+  if (has_peak && x < peak - STEP_PEAK_DROP * peak_threshold)
+  {
+    has_peak = false;
+    armed = false;
+    if (count > 0)
+    {
+      add_interval(peak_ms - step_ms);
+    }
+    // peaks in the refractory window before two steps in a row mean the
+    // interval locked onto every other step, it is learned again
+    blocked_steps = blocked ? blocked_steps + 1 : 0;
+    blocked = false;
+    if (blocked_steps >= 2)
+    {
+      interval_ms = 0;
+      blocked_steps = 0;
+    }
+    count++;
+    step_ms = peak_ms;
+    stepped = true;
+  }
+  // at a sprint sampled at 10 Hz the sample ending a peak can be the valley
+  if (x < -STEP_VALLEY_SIGMA * sigma)
+  {
+    armed = true;
+  }
+  if (stepped)
+  {
+    return true;
+  }
+
+  const uint32_t refractory_ms = interval_ms > 0 ? static_cast<uint32_t>(STEP_REFRACTORY * interval_ms) : 0;
+  const bool open = count == 0 ||
+                    now_ms - step_ms >= (refractory_ms > STEP_MIN_INTERVAL_MS ? refractory_ms : STEP_MIN_INTERVAL_MS);
+  if (armed && x > peak_threshold && (!has_peak || x > peak))
+  {
+    if (!open)
+    {
+      blocked = true;
+      return false;
+    }
+    has_peak = true;
+    peak = x;
+    peak_ms = now_ms;
+  }
+  return false;
+}
+
+void step_detector::add_interval(uint32_t ms)
+{
+  if (ms > STEP_MAX_INTERVAL_MS)
+  {
+    return;
+  }
+  // a missed step looks like a doubled interval, only a slowdown that
+  // lasts is taken as the new pace
+  if (interval_ms > 0 && ms > STEP_LONG_INTERVAL * interval_ms && ++long_intervals < 2)
+  {
+    return;
+  }
+  if (interval_ms == 0 || long_intervals >= 2)
+  {
+    interval_ms = ms;
+  }
+  else
+  {
+    interval_ms += STEP_CADENCE_WEIGHT * (ms - interval_ms);
+  }
+  long_intervals = 0;
+}
+
+void step_detector::reset()
+{
+  *this = step_detector(period_us);
+}
@@ -0,0 +1,99 @@
+#include <math.h>
+
+#include "stride_estimator.h"
+
+#define STANDARD_GRAVITY 9.80665f
+
+// weight of a new value in a moving average with time constant tau
+static float blend(uint32_t dt_ms, uint32_t tau_ms)
+{
+  return static_cast<float>(dt_ms) / (tau_ms + dt_ms);
+}
+
+void stride_estimator::update(float vertical_g)
+{
+  if (window_empty)
+  {
+    window_empty = false;
+    window_max = window_min = vertical_g;
+    return;
+  }
+  window_max = vertical_g > window_max ? vertical_g : window_max;
+  window_min = vertical_g < window_min ? vertical_g : window_min;
+}
+
+float stride_estimator::step(uint32_t now_ms, float cadence_spm)
+{
+  const float range = window_empty ? 0.0f : (window_max - window_min) * STANDARD_GRAVITY;
+  window_empty = true;
+  // two square roots instead of powf, which pulls in a lot of soft float
+  const float unit_stride = sqrtf(sqrtf(range));
+  stride = weinberg_k * unit_stride;
+  distance += stride;
+  if (calibrating_now)
+  {
+    calibration_count++;
+    calibration_sum += unit_stride;
+  }
+
+  // the detector drops its cadence after a stop and when it relearns the
+  // step interval, the average starts over with the next one
+  if (cadence_spm <= 0 || !stepped || now_ms - step_ms > STEP_MAX_INTERVAL_MS)
+  {
+    speed = 0;
+  }
+  else
+  {
+    const float instant = stride * cadence_spm / 60.0f;
+    speed = speed > 0 ? speed + blend(static_cast<uint32_t>(60000.0f / cadence_spm), STRIDE_PACE_MS) * (instant - speed)
+                      : instant;
+  }
+  stepped = true;
+  step_ms = now_ms;
+  return stride;
+}
+
+void stride_estimator::reset()
+{
+  const float k = weinberg_k;
+  *this = stride_estimator();
+  weinberg_k = k;
+}
+
+bool stride_estimator::set_k(float k)
+{
+  if (!(k >= STRIDE_K_MIN && k <= STRIDE_K_MAX))
+  {
+    return false;
+  }
+  weinberg_k = k;
+  return true;
+}
+
+float stride_estimator::speed_mps(uint32_t now_ms) const
+{
+  return stepped && now_ms - step_ms <= STEP_MAX_INTERVAL_MS ? speed : 0.0f;
+}
+
+float stride_estimator::pace_s_per_km(uint32_t now_ms) const
+{
+  const float mps = speed_mps(now_ms);
+  return mps > 0 ? 1000.0f / mps : 0.0f;
+}
+
+void stride_estimator::calibrate_start()
+{
+  calibrating_now = true;
+  calibration_count = 0;
+  calibration_sum = 0;
+}
+
+bool stride_estimator::calibrate_end(float actual_m)
+{
+  calibrating_now = false;
+  if (calibration_count < STRIDE_CALIBRATION_MIN_STEPS || calibration_sum <= 0)
+  {
+    return false;
+  }
+  return set_k(actual_m / calibration_sum);
+}
@@ -0,0 +1,104 @@
+#include <math.h>
+
+#include "turn_detector.h"
+
+// weight of a new sample in a moving average with time constant tau
+static float blend(uint32_t dt_ms, uint32_t tau_ms)
+{
+  return static_cast<float>(dt_ms) / (tau_ms + dt_ms);
+}
+
+turn_event turn_detector::update(const vec3 &accel, const vec3 &gyro, uint32_t now_ms)
+{
+  if (!started)
+  {
+    gravity = accel;
+  }
+  else
+  {
+    const float g = blend(now_ms - last_ms, TURN_GRAVITY_MS);
+    for (size_t i = 0; i < 3; i++)
+    {
+      gravity[i] += g * (accel[i] - gravity[i]);
+    }
+  }
+  const float norm = sqrtf(gravity[0] * gravity[0] + gravity[1] * gravity[1] + gravity[2] * gravity[2]);
+  if (norm < 0.1f)
+  {
+    return turn_event::NONE;
+  }
+  return update((gyro[0] * gravity[0] + gyro[1] * gravity[1] + gyro[2] * gravity[2]) / norm, now_ms);
+}
+
+turn_event turn_detector::update(float yaw_dps, uint32_t now_ms)
+{
+  if (!started)
+  {
+    started = true;
+    last_ms = now_ms;
+    return turn_event::NONE;
+  }
+  const uint32_t dt_ms = now_ms - last_ms;
+  last_ms = now_ms;
+  const float yaw = yaw_dps - bias;
+  rate += blend(dt_ms, TURN_SMOOTH_MS) * (yaw - rate);
+  mean_rate += blend(dt_ms, TURN_MEAN_MS) * (yaw - mean_rate);
+
+  const float step_deg = yaw * dt_ms / 1000.0f;
+  heading = fmodf(heading + step_deg, 360.0f);
+  heading += heading < 0 ? 360.0f : 0.0f;
+
+  switch (state)
+  {
+  case IDLE:
+    // gated on the mean over the sway of a stride, gating on the smoothed
+    // rate would mostly pass one side of the sway. the raw rate keeps out
+    // the start of a turn the averages have not caught up with yet
+    if (fabsf(mean_rate) < TURN_BIAS_GATE_DPS && fabsf(yaw) < TURN_START_DPS)
+    {
+      bias += blend(dt_ms, TURN_BIAS_MS) * (yaw_dps - bias);
+    }
+    if (fabsf(rate) > TURN_START_DPS)
+    {
+      state = ONSET;
+      // the smoothed rate times its time constant is about what was turned
+      // while it rose
+      angle = rate * TURN_SMOOTH_MS / 1000.0f;
+      start_ms = now_ms - TURN_SMOOTH_MS;
+      slow_ms = now_ms;
+    }
+    return turn_event::NONE;
+  case ONSET:
+    angle += step_deg;
+    if (fabsf(rate) < TURN_START_DPS)
+    {
+      state = IDLE;
+    }
+    else if (fabsf(angle) >= TURN_START_DEG)
+    {
+      state = TURNING;
+      return turn_event::STARTED;
+    }
+    return turn_event::NONE;
+  case TURNING:
+    angle += step_deg;
+    if (fabsf(rate) >= TURN_END_DPS && (rate < 0) == (angle < 0))
+    {
+      slow_ms = now_ms;
+    }
+    if (now_ms - slow_ms >= TURN_END_MS || (rate < 0) != (angle < 0))
+    {
+      state = IDLE;
+      end_ms = now_ms;
+      count++;
+      return turn_event::ENDED;
+    }
+    return turn_event::NONE;
+  }
+  return turn_event::NONE;
+}
+
+void turn_detector::reset()
+{
+  *this = turn_detector();
+}
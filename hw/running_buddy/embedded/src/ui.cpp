@@ -0,0 +1,175 @@
+#include "ui.h"
+
+#include <Adafruit_GFX.h>
+#include <Arduino.h>
+#include <string.h>
+
+// one glyph row at the largest text size, allocated once at boot
+static GFXcanvas16 band(UI_LINE_WIDTH, UI_MAX_TEXT_SIZE);
+
+ui_label::ui_label(int16_t x, int16_t y, uint8_t capacity, uint8_t size, uint16_t color, uint16_t bg)
+    : x(x), y(y), color(color), bg(bg)
+{
+  this->size = size == 0 ? 1 : (size > UI_MAX_TEXT_SIZE ? UI_MAX_TEXT_SIZE : size);
+  // keep the box on the panel, writePixels does not clip
+  const int16_t fit = x < 0 || x >= UI_LINE_WIDTH ? 0 : (UI_LINE_WIDTH - x) / (UI_CHAR_WIDTH * this->size);
+  this->capacity = capacity > UI_MAX_CHARS ? UI_MAX_CHARS : capacity;
+  if (this->capacity > fit)
+  {
+    this->capacity = fit;
+  }
+  memset(text, ' ', sizeof(text));
+  memset(shown, ' ', sizeof(shown));
+}
+
+void ui_label::set(const char *str)
+{
+  for (uint8_t i = 0; i < capacity; i++)
+  {
+    text[i] = *str ? *str++ : ' ';
+  }
+}
+
+void ui_label::render(ui_screen &screen)
+{
+  uint8_t first = capacity;
+  uint8_t last = 0;
+  for (uint8_t i = 0; i < capacity; i++)
+  {
+    if (text[i] != shown[i])
+    {
+      first = first == capacity ? i : first;
+      last = i;
+    }
+  }
+  if (first == capacity)
+  {
+    return;
+  }
+  const uint8_t count = last - first + 1;
+  screen.draw_text(x + first * UI_CHAR_WIDTH * size, y, text + first, count, size, color, bg);
+  memcpy(shown + first, text + first, count);
+}
+
+void ui_label::invalidate()
+{
+  memset(shown, ' ', sizeof(shown));
+}
+
+void ui_bitmap::render(ui_screen &screen)
+{
+  if (!drawn)
+  {
+    screen.draw_bitmap(x, y, bitmap, w, h, color);
+    drawn = true;
+  }
+}
+
+void ui_screen::show(ui_widget *const *widgets, size_t count)
+{
+  widget_count = count > UI_MAX_WIDGETS ? UI_MAX_WIDGETS : count;
+  for (size_t i = 0; i < widget_count; i++)
+  {
+    this->widgets[i] = widgets[i];
+  }
+  cleared = true;
+}
+
+void ui_screen::pause()
+{
+  if (yield_fn)
+  {
+    const uint32_t start = micros();
+    yield_fn();
+    yielded_us += micros() - start;
+  }
+}
+
+void ui_screen::render()
+{
+  const uint32_t start = micros();
+  const uint32_t before = counters.pixels_pushed;
+  yielded_us = 0;
+  if (cleared)
+  {
+    for (int16_t y = 0; y < display.height(); y += UI_CLEAR_ROWS)
+    {
+      const int16_t rows = display.height() - y < UI_CLEAR_ROWS ? display.height() - y : UI_CLEAR_ROWS;
+      display.fillRect(0, y, display.width(), rows, bg);
+      pushed(static_cast<uint32_t>(display.width()) * rows);
+      pause();
+    }
+    for (size_t i = 0; i < widget_count; i++)
+    {
+      widgets[i]->invalidate();
+    }
+    cleared = false;
+  }
+  for (size_t i = 0; i < widget_count; i++)
+  {
+    widgets[i]->render(*this);
+    pause();
+  }
+  if (counters.pixels_pushed == before)
+  {
+    counters.idle_frames++;
+    return;
+  }
+  counters.frames++;
+  // the panel's own time, without the tasks run in between
+  counters.last_frame_us = micros() - start - yielded_us;
+  if (counters.last_frame_us > counters.max_frame_us)
+  {
+    counters.max_frame_us = counters.last_frame_us;
+  }
+}
+
+void ui_screen::draw_text(int16_t x, int16_t y, const char *chars, uint8_t count, uint8_t size, uint16_t color, uint16_t bg)
+{
+  const int16_t w = count * UI_CHAR_WIDTH * size;
+  const int16_t h = UI_CHAR_HEIGHT * size;
+  uint16_t *lines = band.getBuffer();
+  display.startWrite();
+  display.setAddrWindow(x, y, w, h);
+  // render one font row of the span at a time and stream it into the window
+  for (uint8_t row = 0; row < UI_CHAR_HEIGHT; row++)
+  {
+    band.fillRect(0, 0, w, size, bg);
+    for (uint8_t i = 0; i < count; i++)
+    {
+      band.drawChar(i * UI_CHAR_WIDTH * size, -row * size, chars[i], color, bg, size);
+    }
+    for (uint8_t line = 0; line < size; line++)
+    {
+      display.writePixels(lines + line * UI_LINE_WIDTH, w);
+    }
+  }
+  display.endWrite();
+  counters.windows++;
+  pushed(static_cast<uint32_t>(w) * h);
+}
+
+void ui_screen::draw_bitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color)
+{
+  display.drawBitmap(x, y, bitmap, w, h, color);
+  // only set bits are drawn
+  uint32_t pixels = 0;
+  const int16_t byte_width = (w + 7) / 8;
+  for (int16_t j = 0; j < h; j++)
+  {
+    for (int16_t i = 0; i < w; i++)
+    {
+      if (pgm_read_byte(&bitmap[j * byte_width + i / 8]) & (0x80 >> (i & 7)))
+      {
+        pixels++;
+      }
+    }
+  }
+  pushed(pixels);
+}
+
+void ui_screen::pushed(uint32_t pixels)
+{
+  counters.pixels_pushed += pixels;
+  counters.bytes_pushed += pixels * 2;
+}
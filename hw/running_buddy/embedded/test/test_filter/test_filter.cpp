@@ -0,0 +1,220 @@
+/**
+ * @file test_filter.cpp
+ *
+ * replays traces through the deque data_filter that main.cpp used before
+ * (tools/bench/legacy.h) and the running_stats one in include/filter.h,
+ * with the step and the two turn configurations, and checks that they see
+ * the same window mean and decide the same on every sample.
+ *
+ * the two cannot be bit identical: the deque one sums the window in double
+ * with std::accumulate every sample, running_stats adds and subtracts, and
+ * sample_value() takes the magnitude in single precision with inv_sqrt()
+ * where the old one used double sqrt(). so values and means have to agree
+ * within a relative VALUE_TOLERANCE. each filter keeps its own refractory
+ * state and the first sample they decide differently on fails the test.
+ *
+ * run_fixture.csv and its labels were written once by
+ * tools/bench --synthetic 120 --cadence 150 --cadence-end 175 --seed 11
+ * --write-trace, so they stay put when the synthesizer changes. every step
+ * the filters find there has to be at a labelled one.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <deque>
+#include <limits>
+#include <vector>
+
+#include <unity.h>
+
+#include "config.h"
+#include "filter.h"
+#include "legacy.h"
+#include "running_stats.h"
+#include "traces.h"
+
+// relative, of values of at least 1. inv_sqrt() is ~5e-6 off
+#define VALUE_TOLERANCE 1e-5
+static_assert(TURN_QUEUE_SIZE == ACCEL_QUEUE_SIZE, "one running_stats window size for every filter");
+
+// spacing of the rows of the standing trace, which has no time column
+#define RECORDED_PERIOD_MS 100
+#define SYNTHETIC_RATE_HZ 100
+// a step decision this close to a labelled step is that step
+#define LABEL_TOLERANCE_MS 200
+
+struct filter_config
+{
+  const char *name;
+  size_t window;
+  int delta;
+  bool normalize;
+  double min_threshold;
+  double max_threshold;
+  // the left turn one never fires on either filter: its max_threshold is
+  // numeric_limits<double>::min(), the smallest positive double, as shipped
+  bool fires;
+};
+
+static const filter_config configs[] = {
+    {"step", ACCEL_QUEUE_SIZE, DELTA_STEP_MS, true, std::numeric_limits<double>::max(), STEP_THRESHOLD, true},
+    {"left_turn", TURN_QUEUE_SIZE, DELTA_TURN, false, LEFT_TURN_THRESHOLD, std::numeric_limits<double>::min(), false},
+    {"right_turn", TURN_QUEUE_SIZE, DELTA_TURN, false, std::numeric_limits<double>::max(), RIGHT_TURN_THRESHOLD, true},
+};
+
+struct replay_result
+{
+  uint32_t samples = 0;
+  std::vector<uint32_t> decisions;
+  bool mismatch = false;
+  uint32_t mismatch_ms = 0;
+  double max_value_error = 0;
+  double max_mean_error = 0;
+};
+
+// stops at the first sample the two filters decide differently on
+static replay_result replay(const filter_config &config, const std::vector<sample> &samples)
+{
+  replay_result res;
+  std::deque<double> old_window;
+  running_stats<double, ACCEL_QUEUE_SIZE> new_window;
+  uint32_t old_last = 0;
+  uint32_t new_last = 0;
+  for (const sample &s : samples)
+  {
+    // the step filter looks at the magnitude, the turn filters at z
+    const float *data = config.normalize ? s.accel.data() : &s.accel[2];
+    const size_t len = config.normalize ? 3 : 1;
+    const std::vector<float> old_data(data, data + len);
+
+    const bool old_hit = legacy::data_filter(old_window, config.window, config.delta, old_data, old_last, s.t_ms,
+                                             config.normalize, config.min_threshold, config.max_threshold);
+    const double new_val = sample_value(data, len, config.normalize);
+    const bool new_hit = data_filter(new_window, config.delta, new_val, new_last, s.t_ms,
+                                     config.min_threshold, config.max_threshold);
+    res.samples++;
+
+    const double old_val = old_window.back();
+    const double value_error = fabs(new_val - old_val) / (fabs(old_val) > 1 ? fabs(old_val) : 1);
+    res.max_value_error = value_error > res.max_value_error ? value_error : res.max_value_error;
+    if (old_window.size() == config.window)
+    {
+      const double old_mean = legacy::mean(old_window);
+      const double mean_error = fabs(new_window.mean() - old_mean) / (fabs(old_mean) > 1 ? fabs(old_mean) : 1);
+      res.max_mean_error = mean_error > res.max_mean_error ? mean_error : res.max_mean_error;
+    }
+
+    if (old_hit != new_hit)
+    {
+      res.mismatch = true;
+      res.mismatch_ms = s.t_ms;
+      break;
+    }
+    if (new_hit)
+    {
+      res.decisions.push_back(s.t_ms);
+    }
+  }
+  printf("filter,%s,samples=%u,decisions=%u,mismatch_ms=%d,max_value_error=%.3g,max_mean_error=%.3g\n",
+         config.name, static_cast<unsigned>(res.samples), static_cast<unsigned>(res.decisions.size()),
+         res.mismatch ? static_cast<int>(res.mismatch_ms) : -1, res.max_value_error, res.max_mean_error);
+  return res;
+}
+
+static uint32_t unlabelled_steps(const std::vector<uint32_t> &decisions, const std::vector<event> &labels)
+{
+  uint32_t unlabelled = 0;
+  for (uint32_t t_ms : decisions)
+  {
+    bool found = false;
+    for (const event &e : labels)
+    {
+      const uint32_t distance = e.t_ms > t_ms ? e.t_ms - t_ms : t_ms - e.t_ms;
+      found = found || (e.kind == STEP && distance <= LABEL_TOLERANCE_MS);
+    }
+    unlabelled += !found;
+  }
+  return unlabelled;
+}
+
+static void replay_all(const std::vector<sample> &samples, bool moving, const std::vector<event> *labels = nullptr)
+{
+  for (const filter_config &config : configs)
+  {
+    const replay_result res = replay(config, samples);
+    TEST_ASSERT_FALSE_MESSAGE(res.mismatch, config.name);
+    TEST_ASSERT_TRUE_MESSAGE(res.max_value_error <= VALUE_TOLERANCE, config.name);
+    TEST_ASSERT_TRUE_MESSAGE(res.max_mean_error <= VALUE_TOLERANCE, config.name);
+    if (moving && config.fires)
+    {
+      TEST_ASSERT_TRUE_MESSAGE(res.decisions.size() > 0, config.name);
+    }
+    // the turn filters fire on every lean to the side, only steps are scored
+    if (labels && config.normalize)
+    {
+      TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, unlabelled_steps(res.decisions, *labels), config.name);
+    }
+  }
+}
+
+static std::vector<sample> synthetic_run(double seconds, double cadence_spm, double impact, unsigned seed)
+{
+  std::vector<sample> samples;
+  std::vector<event> labels;
+  synthesize(seconds, cadence_spm, cadence_spm, impact, SYNTHETIC_RATE_HZ, 20, 0, seed, samples, labels);
+  return samples;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_standing_trace()
+{
+  std::vector<sample> samples;
+  TEST_ASSERT_TRUE_MESSAGE(load_trace(TEST_STANDING_TRACE, RECORDED_PERIOD_MS, samples), TEST_STANDING_TRACE);
+  TEST_ASSERT_TRUE(samples.size() > ACCEL_QUEUE_SIZE);
+  // standing still, nothing to detect but the means still have to agree
+  replay_all(samples, false);
+}
+
+void test_run_fixture()
+{
+  std::vector<sample> samples;
+  std::vector<event> labels;
+  TEST_ASSERT_TRUE_MESSAGE(load_trace(TEST_RUN_FIXTURE ".csv", RECORDED_PERIOD_MS, samples), TEST_RUN_FIXTURE);
+  TEST_ASSERT_TRUE_MESSAGE(load_labels(TEST_RUN_FIXTURE "_labels.csv", labels), TEST_RUN_FIXTURE);
+  TEST_ASSERT_TRUE(labels.size() > 0);
+  replay_all(samples, true, &labels);
+}
+
+void test_walking()
+{
+  replay_all(synthetic_run(120, 110, 0.6, 1), true);
+}
+
+void test_running()
+{
+  replay_all(synthetic_run(120, 170, 1.0, 2), true);
+}
+
+void test_sprinting()
+{
+  replay_all(synthetic_run(60, 200, 1.5, 3), true);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_standing_trace);
+  RUN_TEST(test_run_fixture);
+  RUN_TEST(test_walking);
+  RUN_TEST(test_running);
+  RUN_TEST(test_sprinting);
+  return UNITY_END();
+}
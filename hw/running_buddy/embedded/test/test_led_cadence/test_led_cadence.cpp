@@ -0,0 +1,137 @@
+/**
+ * @file test_led_cadence.cpp
+ *
+ * runs the firmware in the native simulation with endless pulses on every
+ * carrier pixel and the strip, so every LED frame shows both devices, and
+ * checks that the IMU keeps its cadence: no two ticks further apart than
+ * TICK_GAP_LIMIT_US, no late or skipped imu task runs, no FIFO overruns
+ * and the samples the ODR promises.
+ *
+ * the simulated DotStar and WS2811 show() take their wire time, ~200 us
+ * and ~530 us, so a frame that grows past the budget shows up here.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unity.h>
+
+#include "boot_sequencer.h"
+#include "config.h"
+#include "imu_fifo.h"
+#include "led_effects.h"
+#include "scheduler.h"
+#include "sim.h"
+
+void setup();
+void loop();
+
+extern boot_sequencer boot;
+extern scheduler tasks;
+extern led_engine led_fx;
+extern imu_fifo imu;
+extern bool imu_fifo_active;
+extern uint32_t worst_tick_gap_us;
+
+#define RUN_MS 20000
+// the first FIFO fill after boot is not scored
+#define WARMUP_MS 1000
+// a tick may wait behind one frame of another task, a whole missed poll
+// period is a gap
+#define TICK_GAP_LIMIT_US (2 * IMU_POLL_MS * 1000UL)
+// samples still in the FIFO at the end of the run
+#define SAMPLE_SLACK (2 * IMU_FIFO_WATERMARK)
+
+static const task *find_task(const char *name)
+{
+  for (size_t i = 0; i < tasks.count(); i++)
+  {
+    if (strcmp(tasks.at(i).name, name) == 0)
+    {
+      return &tasks.at(i);
+    }
+  }
+  return nullptr;
+}
+
+static void run_until(uint32_t t_ms)
+{
+  while (sim_time_us() / 1000 < t_ms && !boot.failed())
+  {
+    sim_imu_update();
+    loop();
+    sim_advance_us(sim.loop_us);
+  }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_cadence_under_effects()
+{
+  char out_dir[] = "/tmp/led_cadence_XXXXXX";
+  TEST_ASSERT_NOT_NULL(mkdtemp(out_dir));
+  sim.out_dir = out_dir;
+  sim.quiet = true;
+
+  setup();
+  while (!boot.done() && !boot.failed())
+  {
+    run_until(sim_time_us() / 1000 + 1);
+  }
+  TEST_ASSERT_TRUE(boot.done());
+  TEST_ASSERT_TRUE(imu_fifo_active);
+  for (uint8_t channel = 0; channel < LED_CARRIER_PIXELS; channel++)
+  {
+    led_fx.play(channel, led_effect::pulse(CRGB(0, 96, 255), 700 + 100 * channel));
+  }
+  led_fx.play(LED_STRIP_CHANNEL, led_effect::pulse(CRGB(255, 0, 96), 500));
+
+  const uint32_t start_ms = sim_time_us() / 1000;
+  run_until(start_ms + WARMUP_MS);
+  const uint32_t warm_samples = imu.stats().samples;
+  const uint32_t warm_frames = led_fx.stats().frames;
+  run_until(start_ms + WARMUP_MS + RUN_MS);
+  sim_shutdown();
+
+  const led_stats &led = led_fx.stats();
+  const imu_fifo_stats &fifo = imu.stats();
+  const task *imu_task = find_task("imu");
+  const task *led_task = find_task("leds");
+  TEST_ASSERT_NOT_NULL(imu_task);
+  TEST_ASSERT_NOT_NULL(led_task);
+  printf("leds,frames=%u,carrier_shows=%u,strip_shows=%u,max_frame_us=%u\n", static_cast<unsigned>(led.frames),
+         static_cast<unsigned>(led.carrier_shows), static_cast<unsigned>(led.strip_shows),
+         static_cast<unsigned>(led.max_frame_us));
+  printf("imu,samples=%u,overruns=%u,max_tick_gap_us=%u,max_late_us=%u,skipped=%u\n",
+         static_cast<unsigned>(fifo.samples - warm_samples), static_cast<unsigned>(fifo.overruns),
+         static_cast<unsigned>(worst_tick_gap_us), static_cast<unsigned>(imu_task->stats.max_late_us),
+         static_cast<unsigned>(imu_task->stats.skipped));
+
+  // the effects ran: a frame every period of the leds task and nearly all
+  // of them shown
+  const uint32_t frames = led.frames - warm_frames;
+  TEST_ASSERT_UINT32_WITHIN(2, RUN_MS * 1000UL / led_task->period_us, frames);
+  TEST_ASSERT_TRUE(led.carrier_shows * 10 >= frames * 9);
+  TEST_ASSERT_TRUE(led.strip_shows * 10 >= frames * 9);
+
+  TEST_ASSERT_TRUE_MESSAGE(worst_tick_gap_us <= TICK_GAP_LIMIT_US, "imu tick gap");
+  TEST_ASSERT_EQUAL_UINT32(0, imu_task->stats.deadline_misses);
+  TEST_ASSERT_EQUAL_UINT32(0, imu_task->stats.skipped);
+  TEST_ASSERT_EQUAL_UINT32(0, fifo.overruns);
+  const uint32_t expected = static_cast<uint32_t>(IMU_ODR_HZ) * RUN_MS / 1000;
+  TEST_ASSERT_UINT32_WITHIN(SAMPLE_SLACK, expected, fifo.samples - warm_samples);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_cadence_under_effects);
+  return UNITY_END();
+}
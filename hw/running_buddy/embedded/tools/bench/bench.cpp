@@ -0,0 +1,463 @@
+/**
+ * @file bench.cpp
+ *
+ * replays accelerometer traces through the step and turn detectors, on
+ * their own and behind the orientation filter, and reports throughput
+ * (ns/sample), heap allocations per sample and, for labelled traces,
+ * accuracy and detection latency against the labels.
+ *
+ * usage: program --trace file.csv [--period ms] [--labels file.csv]
+ *        program --synthetic seconds [--cadence spm] [--cadence-end spm]
+ *                [--impact g] [--rate hz] [--seed n] [--turn-every s]
+ *                [--gyro-bias dps] [--write-trace prefix]
+ *        common: [--repeat n] [--tolerance ms] [--json file]
+ *
+ * traces use the native simulation format, rows of x, y, z[, gx, gy, gz]
+ * or t_ms, x, y, z[, gx, gy, gz]. labels are "t_ms,kind" lines with kind
+ * one of step, left_turn or right_turn. detectors that estimate cadence are
+ * also scored on it, against the interval between the labelled steps.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "legacy.h"
+#include "mem_stats.h"
+#include "orientation.h"
+#include "step_detector.h"
+#include "traces.h"
+#include "turn_detector.h"
+#include "vec3.h"
+
+struct accuracy
+{
+  size_t detected = 0;
+  size_t truth = 0;
+  size_t true_positives = 0;
+  double latency_sum = 0;
+  double latency_max = 0;
+  // over true positives with a cadence estimate and a labelled step before
+  size_t cadence_count = 0;
+  double cadence_error_sum = 0;
+  double cadence_error_max = 0;
+};
+
+struct result
+{
+  std::string name;
+  // bitmask of the event_kinds the detector reports
+  unsigned kinds = 0;
+  bool cadence = false;
+  double ns_per_sample = 0;
+  double allocs_per_sample = 0;
+  std::vector<event> events;
+};
+
+// a detector fed the world frame signals, as on the device
+template <typename D>
+struct fused
+{
+  orientation fusion;
+  D detector;
+
+  void reset()
+  {
+    fusion.reset();
+    detector.reset();
+  }
+
+  void update(const sample &s)
+  {
+    fusion.update(s.accel, s.gyro, s.t_ms * 1000);
+  }
+};
+
+static float no_cadence(...)
+{
+  return 0;
+}
+
+// update returns the event_kind raised by a sample, cadence the detector's
+// current estimate
+template <typename D, typename F, typename C>
+result run(const char *name, unsigned kinds, D &detector, F update, C cadence,
+           const std::vector<sample> &samples, int repeat)
+{
+  result res;
+  res.name = name;
+  res.kinds = kinds;
+  res.cadence = !std::is_same<C, decltype(&no_cadence)>::value;
+  res.events.reserve(samples.size());
+  double best_ns = 0;
+  for (int rep = 0; rep < repeat; rep++)
+  {
+    detector.reset();
+    const uint32_t allocations_before = allocation_count();
+    const auto start = std::chrono::steady_clock::now();
+    for (const sample &s : samples)
+    {
+      const event_kind kind = update(detector, s);
+      if (kind != NONE && rep == 0)
+      {
+        res.events.push_back({s.t_ms, kind, cadence(detector)});
+      }
+    }
+    const auto end = std::chrono::steady_clock::now();
+    const double ns = std::chrono::duration<double, std::nano>(end - start).count() / samples.size();
+    if (rep == 0 || ns < best_ns)
+    {
+      best_ns = ns;
+    }
+    if (rep == 0)
+    {
+      res.allocs_per_sample = static_cast<double>(allocation_count() - allocations_before) / samples.size();
+    }
+  }
+  res.ns_per_sample = best_ns;
+  return res;
+}
+
+// greedy in time order, every label matches at most one detection
+static accuracy score(const std::vector<event> &events, const std::vector<event> &labels,
+                      event_kind kind, uint32_t tolerance_ms)
+{
+  accuracy acc;
+  std::vector<uint32_t> truth;
+  for (const event &e : labels)
+  {
+    if (e.kind == kind)
+    {
+      truth.push_back(e.t_ms);
+    }
+  }
+  acc.truth = truth.size();
+  size_t next = 0;
+  for (const event &e : events)
+  {
+    if (e.kind != kind)
+    {
+      continue;
+    }
+    acc.detected++;
+    while (next < truth.size() && truth[next] + tolerance_ms < e.t_ms)
+    {
+      next++;
+    }
+    if (next < truth.size() && e.t_ms + tolerance_ms >= truth[next])
+    {
+      const double latency = static_cast<double>(e.t_ms) - truth[next];
+      acc.true_positives++;
+      acc.latency_sum += latency;
+      acc.latency_max = acc.true_positives == 1 ? latency : std::max(acc.latency_max, latency);
+      if (e.cadence_spm > 0 && next > 0)
+      {
+        const double error = fabs(e.cadence_spm - 60000.0 / (truth[next] - truth[next - 1]));
+        acc.cadence_count++;
+        acc.cadence_error_sum += error;
+        acc.cadence_error_max = std::max(acc.cadence_error_max, error);
+      }
+      next++;
+    }
+  }
+  return acc;
+}
+
+static void write_json(FILE *out, const std::string &source, const std::vector<sample> &samples,
+                       const std::vector<event> &labels, bool labelled, int repeat,
+                       uint32_t tolerance_ms, const std::vector<result> &results)
+{
+  const double duration_s = samples.empty() ? 0 : (samples.back().t_ms - samples.front().t_ms) / 1000.0;
+  fprintf(out, "{\n");
+  fprintf(out, "  \"trace\": \"%s\",\n", source.c_str());
+  fprintf(out, "  \"samples\": %zu,\n", samples.size());
+  fprintf(out, "  \"duration_s\": %.3f,\n", duration_s);
+  fprintf(out, "  \"repeat\": %d,\n", repeat);
+  fprintf(out, "  \"tolerance_ms\": %lu,\n", (unsigned long)tolerance_ms);
+  fprintf(out, "  \"detectors\": [\n");
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const result &res = results[i];
+    fprintf(out, "    {\n");
+    fprintf(out, "      \"name\": \"%s\",\n", res.name.c_str());
+    fprintf(out, "      \"ns_per_sample\": %.2f,\n", res.ns_per_sample);
+    fprintf(out, "      \"allocs_per_sample\": %.3f,\n", res.allocs_per_sample);
+    fprintf(out, "      \"events\": {");
+    bool first = true;
+    for (int kind = STEP; kind < EVENT_KINDS; kind++)
+    {
+      if (!(res.kinds & (1u << kind)))
+      {
+        continue;
+      }
+      const accuracy acc = score(res.events, labels, static_cast<event_kind>(kind), tolerance_ms);
+      fprintf(out, "%s\n        \"%s\": {\"detected\": %zu", first ? "" : ",", event_names[kind], acc.detected);
+      first = false;
+      if (!labelled)
+      {
+        fprintf(out, "}");
+        continue;
+      }
+      const size_t false_positives = acc.detected - acc.true_positives;
+      fprintf(out, ", \"truth\": %zu, \"true_positives\": %zu, \"false_positives\": %zu, \"missed\": %zu",
+              acc.truth, acc.true_positives, false_positives, acc.truth - acc.true_positives);
+      fprintf(out, ", \"precision\": %.4f, \"recall\": %.4f",
+              acc.detected == 0 ? 0.0 : static_cast<double>(acc.true_positives) / acc.detected,
+              acc.truth == 0 ? 0.0 : static_cast<double>(acc.true_positives) / acc.truth);
+      fprintf(out, ", \"latency_ms_mean\": %.1f, \"latency_ms_max\": %.1f",
+              acc.true_positives == 0 ? 0.0 : acc.latency_sum / acc.true_positives, acc.latency_max);
+      if (res.cadence && kind == STEP)
+      {
+        fprintf(out, ", \"cadence_spm_error_mean\": %.1f, \"cadence_spm_error_max\": %.1f",
+                acc.cadence_count == 0 ? 0.0 : acc.cadence_error_sum / acc.cadence_count, acc.cadence_error_max);
+      }
+      fprintf(out, "}");
+    }
+    fprintf(out, "%s}\n", first ? "" : "\n      ");
+    fprintf(out, "    }%s\n", i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s --trace file.csv [--period ms] [--labels file.csv]\n"
+          "       %s --synthetic seconds [--cadence spm] [--cadence-end spm] [--impact g]\n"
+          "          [--rate hz] [--seed n] [--turn-every s] [--gyro-bias dps]\n"
+          "          [--write-trace prefix]\n"
+          "       common: [--repeat n] [--tolerance ms] [--json file]\n",
+          name, name);
+}
+
+int main(int argc, char **argv)
+{
+  std::string trace_path;
+  std::string labels_path;
+  std::string json_path;
+  std::string write_prefix;
+  uint32_t period_ms = 100;
+  double synthetic_s = 0;
+  double cadence_spm = 160;
+  double cadence_end_spm = 0;
+  double impact = 0.8;
+  double rate_hz = 10;
+  double turn_every_s = 20;
+  double gyro_bias_dps = 0;
+  unsigned seed = 1;
+  int repeat = 5;
+  uint32_t tolerance_ms = 200;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const bool has_value = i + 1 < argc;
+    const char *arg = argv[i];
+    if (!has_value)
+    {
+      usage(argv[0]);
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (strcmp(arg, "--trace") == 0)
+    {
+      trace_path = value;
+    }
+    else if (strcmp(arg, "--labels") == 0)
+    {
+      labels_path = value;
+    }
+    else if (strcmp(arg, "--json") == 0)
+    {
+      json_path = value;
+    }
+    else if (strcmp(arg, "--write-trace") == 0)
+    {
+      write_prefix = value;
+    }
+    else if (strcmp(arg, "--period") == 0)
+    {
+      period_ms = strtoul(value, nullptr, 10);
+    }
+    else if (strcmp(arg, "--synthetic") == 0)
+    {
+      synthetic_s = strtod(value, nullptr);
+    }
+    else if (strcmp(arg, "--cadence") == 0)
+    {
+      cadence_spm = strtod(value, nullptr);
+    }
+    else if (strcmp(arg, "--cadence-end") == 0)
+    {
+      cadence_end_spm = strtod(value, nullptr);
+    }
+    else if (strcmp(arg, "--impact") == 0)
+    {
+      impact = strtod(value, nullptr);
+    }
+    else if (strcmp(arg, "--rate") == 0)
+    {
+      rate_hz = strtod(value, nullptr);
+    }
+    else if (strcmp(arg, "--turn-every") == 0)
+    {
+      turn_every_s = strtod(value, nullptr);
+    }
+    else if (strcmp(arg, "--gyro-bias") == 0)
+    {
+      gyro_bias_dps = strtod(value, nullptr);
+    }
+    else if (strcmp(arg, "--seed") == 0)
+    {
+      seed = strtoul(value, nullptr, 10);
+    }
+    else if (strcmp(arg, "--repeat") == 0)
+    {
+      repeat = atoi(value);
+    }
+    else if (strcmp(arg, "--tolerance") == 0)
+    {
+      tolerance_ms = strtoul(value, nullptr, 10);
+    }
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (cadence_end_spm == 0)
+  {
+    cadence_end_spm = cadence_spm;
+  }
+  if (trace_path.empty() == (synthetic_s <= 0) || repeat < 1 || rate_hz <= 0 || cadence_spm <= 0 ||
+      cadence_end_spm <= 0)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<sample> samples;
+  std::vector<event> labels;
+  std::string source = trace_path;
+  bool labelled = false;
+  if (synthetic_s > 0)
+  {
+    synthesize(synthetic_s, cadence_spm, cadence_end_spm, impact, rate_hz, turn_every_s, gyro_bias_dps, seed,
+               samples, labels);
+    char name[128];
+    snprintf(name, sizeof(name), "synthetic:%gs@%g-%gspm,%gg,%ghz,seed=%u", synthetic_s, cadence_spm,
+             cadence_end_spm, impact, rate_hz, seed);
+    source = name;
+    labelled = true;
+    if (!write_prefix.empty() && !write_trace(write_prefix, samples, labels))
+    {
+      fprintf(stderr, "could not write %s.csv\n", write_prefix.c_str());
+      return 1;
+    }
+  }
+  else
+  {
+    if (!load_trace(trace_path, period_ms, samples))
+    {
+      fprintf(stderr, "could not open trace %s\n", trace_path.c_str());
+      return 1;
+    }
+    if (!labels_path.empty())
+    {
+      if (!load_labels(labels_path, labels))
+      {
+        fprintf(stderr, "could not open labels %s\n", labels_path.c_str());
+        return 1;
+      }
+      labelled = true;
+    }
+  }
+  if (samples.empty())
+  {
+    fprintf(stderr, "no samples in %s\n", source.c_str());
+    return 1;
+  }
+
+  std::vector<result> results;
+
+  // set up for the mean sample spacing, like the device for its ODR
+  const uint32_t period_us = samples.size() > 1 ? 1000ULL * (samples.back().t_ms - samples.front().t_ms) /
+                                                      (samples.size() - 1)
+                                                : period_ms * 1000;
+  step_detector steps(period_us);
+  results.push_back(run("step_peak", 1u << STEP, steps, [](step_detector &d, const sample &s)
+                        { return d.update(s.accel, s.t_ms) ? STEP : NONE; },
+                        [](const step_detector &d)
+                        { return d.cadence_spm(); },
+                        samples, repeat));
+
+  fused<step_detector> fused_steps;
+  fused_steps.detector.set_period_us(period_us);
+  results.push_back(run("step_peak_vertical", 1u << STEP, fused_steps, [](fused<step_detector> &d, const sample &s)
+                        {
+                          d.update(s);
+                          return d.detector.update(d.fusion.linear_accel(s.accel)[2], s.t_ms) ? STEP : NONE; },
+                        [](const fused<step_detector> &d)
+                        { return d.detector.cadence_spm(); },
+                        samples, repeat));
+
+  legacy::mean_step_detector mean_steps;
+  results.push_back(run("step_data_filter", 1u << STEP, mean_steps, [](legacy::mean_step_detector &d, const sample &s)
+                        { return d.update(s.accel, s.t_ms) ? STEP : NONE; },
+                        &no_cadence, samples, repeat));
+
+  legacy::step_detector legacy_steps;
+  results.push_back(run("step_data_filter_deque", 1u << STEP, legacy_steps, [](legacy::step_detector &d, const sample &s)
+                        { return d.update(s.accel.data(), s.t_ms) ? STEP : NONE; },
+                        &no_cadence, samples, repeat));
+
+  turn_detector turns;
+  results.push_back(run("turn_gyro", (1u << LEFT_TURN) | (1u << RIGHT_TURN), turns, [](turn_detector &d, const sample &s)
+                        {
+                          if (d.update(s.accel, s.gyro, s.t_ms) != turn_event::STARTED)
+                          {
+                            return NONE;
+                          }
+                          return d.direction() > 0 ? LEFT_TURN : RIGHT_TURN; },
+                        &no_cadence, samples, repeat));
+
+  fused<turn_detector> fused_turns;
+  results.push_back(run("turn_gyro_fused", (1u << LEFT_TURN) | (1u << RIGHT_TURN), fused_turns, [](fused<turn_detector> &d, const sample &s)
+                        {
+                          d.update(s);
+                          if (d.detector.update(d.fusion.yaw_rate(s.gyro), s.t_ms) != turn_event::STARTED)
+                          {
+                            return NONE;
+                          }
+                          return d.detector.direction() > 0 ? LEFT_TURN : RIGHT_TURN; },
+                        &no_cadence, samples, repeat));
+
+  legacy::turn_detector legacy_turns;
+  results.push_back(run("turn_week2", (1u << LEFT_TURN) | (1u << RIGHT_TURN), legacy_turns, [](legacy::turn_detector &d, const sample &s)
+                        {
+                          const int turn = d.update(s.accel.data(), s.t_ms);
+                          return turn < 0 ? LEFT_TURN : turn > 0 ? RIGHT_TURN : NONE; },
+                        &no_cadence, samples, repeat));
+
+  FILE *out = stdout;
+  if (!json_path.empty())
+  {
+    out = fopen(json_path.c_str(), "w");
+    if (!out)
+    {
+      fprintf(stderr, "could not write %s\n", json_path.c_str());
+      return 1;
+    }
+  }
+  write_json(out, source, samples, labels, labelled, repeat, tolerance_ms, results);
+  if (out != stdout)
+  {
+    fclose(out);
+  }
+  return 0;
+}
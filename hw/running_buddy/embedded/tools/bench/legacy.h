@@ -0,0 +1,170 @@
+#ifndef BENCH_LEGACY
+#define BENCH_LEGACY
+
+/**
+ * reference copies of the detectors as they shipped before: the moving
+ * mean step detector on running_stats, the deque based data_filter from
+ * main.cpp before that and check_turn from the week2 writeup, kept here so
+ * the benchmark can compare against them.
+ */
+
+#include <math.h>
+#include <stdint.h>
+
+#include <deque>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+#include "config.h"
+#include "filter.h"
+#include "running_stats.h"
+#include "vec3.h"
+
+namespace legacy
+{
+  // step_detector before peak detection, a fixed threshold on the
+  // mean-removed magnitude with a fixed DELTA_STEP_MS refractory period
+  class mean_step_detector
+  {
+  public:
+    bool update(const vec3 &accel, uint32_t now_ms)
+    {
+      return ::data_filter(hist_accel, DELTA_STEP_MS,
+                           static_cast<double>(sample_value(accel.data(), 3)), last_step, now_ms,
+                           std::numeric_limits<double>::max(), STEP_THRESHOLD);
+    }
+
+    void reset()
+    {
+      hist_accel.reset();
+      last_step = 0;
+    }
+
+  private:
+    running_stats<double, ACCEL_QUEUE_SIZE> hist_accel;
+    uint32_t last_step = 0;
+  };
+
+  inline double mean(const std::deque<double> &vec)
+  {
+    double avg = std::accumulate(vec.begin(), vec.end(), 0.0) / vec.size();
+    return avg;
+  }
+
+  inline bool data_filter(std::deque<double> &hist_data, const size_t &queue_size, const int &delta,
+                          const std::vector<float> &data, uint32_t &last_time, const uint32_t &curr_time,
+                          bool normalize = true,
+                          const double &min_threshold = std::numeric_limits<double>::max(),
+                          const double &max_threshold = std::numeric_limits<double>::min())
+  {
+    double sum = std::accumulate(data.begin(), data.end(), 0.0, [normalize](double total, double curr)
+                                 { return total + (normalize ? pow(curr, 2) : curr); });
+    double val = normalize ? sqrt(sum) : sum;
+    hist_data.push_back(val);
+    if (hist_data.size() <= queue_size)
+    {
+      return false;
+    }
+    hist_data.pop_front();
+    if (last_time + delta > curr_time)
+    {
+      return false;
+    }
+    double avg = fabs(mean(hist_data));
+    double normalized_val = val + (val < 0 ? avg : -avg);
+
+    if (normalized_val > min_threshold || normalized_val < max_threshold)
+    {
+      return false;
+    }
+    last_time = curr_time;
+    return true;
+  }
+
+  // handle_step before running_stats
+  class step_detector
+  {
+  public:
+    bool update(const float accel[3], uint32_t now_ms)
+    {
+      std::vector<float> data(accel, accel + 3);
+      return data_filter(hist_accel, ACCEL_QUEUE_SIZE, DELTA_STEP_MS,
+                         data, last_step, now_ms, true,
+                         std::numeric_limits<double>::max(), STEP_THRESHOLD);
+    }
+
+    void reset()
+    {
+      hist_accel.clear();
+      last_step = 0;
+    }
+
+  private:
+    std::deque<double> hist_accel;
+    uint32_t last_step = 0;
+  };
+
+  // week2 check_turn, the flags are cleared DELTA_TURN ms after being set
+  class turn_detector
+  {
+  public:
+    // returns -1 when a left turn starts, 1 for a right turn, otherwise 0
+    int update(const float accel[3], uint32_t now_ms)
+    {
+      int event = 0;
+      if (left_turn && now_ms >= left_clear)
+      {
+        left_turn = false;
+      }
+      if (right_turn && now_ms >= right_clear)
+      {
+        right_turn = false;
+      }
+
+      std::vector<float> left_turn_data{accel[2]};
+      if (data_filter(hist_left_turn, TURN_QUEUE_SIZE, DELTA_TURN,
+                      left_turn_data, last_left_turn, now_ms, false, LEFT_TURN_THRESHOLD))
+      {
+        if (!left_turn)
+        {
+          left_turn = true;
+          left_clear = now_ms + DELTA_TURN;
+          event = -1;
+        }
+      }
+
+      std::vector<float> right_turn_data{accel[2]};
+      if (data_filter(hist_right_turn, TURN_QUEUE_SIZE, DELTA_TURN,
+                      right_turn_data, last_right_turn, now_ms, false,
+                      std::numeric_limits<double>::max(), RIGHT_TURN_THRESHOLD))
+      {
+        if (!right_turn)
+        {
+          right_turn = true;
+          right_clear = now_ms + DELTA_TURN;
+          event = 1;
+        }
+      }
+      return event;
+    }
+
+    void reset()
+    {
+      *this = turn_detector();
+    }
+
+  private:
+    bool left_turn = false;
+    uint32_t last_left_turn = 0;
+    uint32_t left_clear = 0;
+    std::deque<double> hist_left_turn;
+
+    bool right_turn = false;
+    uint32_t last_right_turn = 0;
+    uint32_t right_clear = 0;
+    std::deque<double> hist_right_turn;
+  };
+}
+
+#endif
@@ -0,0 +1,262 @@
+#ifndef BENCH_TRACES
+#define BENCH_TRACES
+
+/**
+ * accelerometer and gyroscope traces for the benchmark and the tests:
+ * loading recorded ones with their labels, synthesizing labelled runs and
+ * writing them back out.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "vec3.h"
+
+enum event_kind
+{
+  NONE = 0,
+  STEP,
+  LEFT_TURN,
+  RIGHT_TURN,
+  EVENT_KINDS
+};
+
+static const char *const event_names[EVENT_KINDS] = {"none", "step", "left_turn", "right_turn"};
+
+struct sample
+{
+  uint32_t t_ms;
+  vec3 accel;
+  vec3 gyro;
+};
+
+struct event
+{
+  uint32_t t_ms;
+  event_kind kind;
+  // detector's estimate when it raised the event, 0 without one
+  float cadence_spm;
+};
+
+inline bool parse_fields(const std::string &line, std::vector<std::string> &fields)
+{
+  fields.clear();
+  std::stringstream stream(line);
+  std::string field;
+  while (std::getline(stream, field, ','))
+  {
+    const size_t start = field.find_first_not_of(" \t\r");
+    const size_t end = field.find_last_not_of(" \t\r");
+    fields.push_back(start == std::string::npos ? "" : field.substr(start, end - start + 1));
+  }
+  return !fields.empty();
+}
+
+inline bool to_float(const std::string &field, float &val)
+{
+  char *end = nullptr;
+  val = strtof(field.c_str(), &end);
+  return !field.empty() && *end == '\0';
+}
+
+inline bool load_trace(const std::string &path, uint32_t period_ms, std::vector<sample> &samples)
+{
+  std::ifstream file(path);
+  if (!file)
+  {
+    return false;
+  }
+  std::string line;
+  std::vector<std::string> fields;
+  std::vector<float> vals;
+  while (std::getline(file, line))
+  {
+    if (!parse_fields(line, fields))
+    {
+      continue;
+    }
+    vals.clear();
+    for (const std::string &field : fields)
+    {
+      float val;
+      if (!to_float(field, val))
+      {
+        break;
+      }
+      vals.push_back(val);
+    }
+    if (vals.size() != fields.size())
+    {
+      continue;
+    }
+    const bool timed = vals.size() == 4 || vals.size() == 7;
+    const size_t offset = timed ? 1 : 0;
+    if (vals.size() - offset != 3 && vals.size() - offset != 6)
+    {
+      continue;
+    }
+    sample s = {};
+    s.t_ms = timed ? static_cast<uint32_t>(vals[0]) : samples.size() * period_ms;
+    for (size_t i = 0; i < 3; i++)
+    {
+      s.accel[i] = vals[offset + i];
+      s.gyro[i] = vals.size() - offset == 6 ? vals[offset + 3 + i] : 0.0f;
+    }
+    samples.push_back(s);
+  }
+  return true;
+}
+
+inline bool load_labels(const std::string &path, std::vector<event> &labels)
+{
+  std::ifstream file(path);
+  if (!file)
+  {
+    return false;
+  }
+  std::string line;
+  std::vector<std::string> fields;
+  while (std::getline(file, line))
+  {
+    float t;
+    if (!parse_fields(line, fields) || fields.size() != 2 || !to_float(fields[0], t))
+    {
+      continue;
+    }
+    for (int kind = STEP; kind < EVENT_KINDS; kind++)
+    {
+      if (fields[1] == event_names[kind])
+      {
+        labels.push_back({static_cast<uint32_t>(t), static_cast<event_kind>(kind), 0});
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * running at a cadence going linearly from cadence_spm to cadence_end_spm:
+ * each step is a gaussian impact on the vertical axis (x), turns add a
+ * lateral offset on z and a yaw rate about x for one second, alternating
+ * left and right. the torso sways ~15 dps about x once per stride and the
+ * gyroscope reads gyro_bias_dps too much on every axis.
+ */
+inline void synthesize(double seconds, double cadence_spm, double cadence_end_spm, double impact,
+                       double rate_hz, double turn_every_s, double gyro_bias_dps, unsigned seed,
+                       std::vector<sample> &samples, std::vector<event> &labels)
+{
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0.0, 0.04);
+  std::normal_distribution<double> jitter(0.0, 0.02);
+
+  const double turn_length = 1.0;
+  const double turn_offset = 0.3;
+  const double turn_rate = 90.0;
+  const double sway = 15.0;
+
+  std::vector<double> step_times;
+  std::vector<double> step_sigmas;
+  for (double t = 60.0 / cadence_spm; t < seconds;)
+  {
+    const double step_period = 60.0 / (cadence_spm + (cadence_end_spm - cadence_spm) * t / seconds);
+    step_times.push_back(t);
+    step_sigmas.push_back(step_period / 6);
+    labels.push_back({static_cast<uint32_t>(t * 1000), STEP, 0});
+    t += step_period * (1 + jitter(rng));
+  }
+  std::vector<double> turn_times;
+  for (double t = turn_every_s; turn_every_s > 0 && t + turn_length < seconds; t += turn_every_s)
+  {
+    const event_kind kind = turn_times.size() % 2 == 0 ? LEFT_TURN : RIGHT_TURN;
+    turn_times.push_back(t);
+    labels.push_back({static_cast<uint32_t>(t * 1000), kind, 0});
+  }
+  std::sort(labels.begin(), labels.end(), [](const event &a, const event &b)
+            { return a.t_ms < b.t_ms; });
+
+  size_t next_step = 0;
+  for (size_t n = 0; n / rate_hz < seconds; n++)
+  {
+    const double t = n / rate_hz;
+    while (next_step + 1 < step_times.size() && step_times[next_step + 1] < t)
+    {
+      next_step++;
+    }
+    double vertical = 1.0;
+    for (size_t i = next_step; i < step_times.size() && i <= next_step + 1; i++)
+    {
+      const double d = (t - step_times[i]) / step_sigmas[i];
+      vertical += impact * exp(-0.5 * d * d);
+    }
+    double lateral = 0;
+    double yaw = 0;
+    for (size_t i = 0; i < turn_times.size(); i++)
+    {
+      if (t >= turn_times[i] && t < turn_times[i] + turn_length)
+      {
+        lateral = i % 2 == 0 ? -turn_offset : turn_offset;
+        yaw = i % 2 == 0 ? turn_rate : -turn_rate;
+      }
+    }
+
+    sample s = {};
+    s.t_ms = static_cast<uint32_t>(t * 1000);
+    s.accel[0] = vertical + noise(rng);
+    s.accel[1] = noise(rng);
+    s.accel[2] = lateral + noise(rng);
+    // one sway period per two steps
+    double phase = 0;
+    if (next_step + 1 < step_times.size())
+    {
+      phase = next_step + (t - step_times[next_step]) / (step_times[next_step + 1] - step_times[next_step]);
+    }
+    s.gyro[0] = yaw + sway * sin(M_PI * phase) + gyro_bias_dps + noise(rng) * 10;
+    s.gyro[1] = gyro_bias_dps + noise(rng) * 10;
+    s.gyro[2] = gyro_bias_dps + noise(rng) * 10;
+    samples.push_back(s);
+  }
+}
+
+inline bool write_trace(const std::string &prefix, const std::vector<sample> &samples,
+                        const std::vector<event> &labels)
+{
+  FILE *trace = fopen((prefix + ".csv").c_str(), "w");
+  FILE *label = fopen((prefix + "_labels.csv").c_str(), "w");
+  if (!trace || !label)
+  {
+    if (trace)
+    {
+      fclose(trace);
+    }
+    if (label)
+    {
+      fclose(label);
+    }
+    return false;
+  }
+  fprintf(trace, "t_ms, x, y, z, gx, gy, gz\n");
+  for (const sample &s : samples)
+  {
+    fprintf(trace, "%lu, %.4f, %.4f, %.4f, %.3f, %.3f, %.3f\n", (unsigned long)s.t_ms,
+            s.accel[0], s.accel[1], s.accel[2], s.gyro[0], s.gyro[1], s.gyro[2]);
+  }
+  fprintf(label, "t_ms,kind\n");
+  for (const event &e : labels)
+  {
+    fprintf(label, "%lu,%s\n", (unsigned long)e.t_ms, event_names[e.kind]);
+  }
+  fclose(trace);
+  fclose(label);
+  return true;
+}
+
+#endif
@@ -0,0 +1,416 @@
+/**
+ * @file log_decoder.cpp
+ *
+ * converts the binary data.bin log written by the firmware into one table
+ * per record type. tables are written as csv by default, or with --columnar
+ * as one raw little endian array per column plus a schema file. decoding
+ * starts at the first session record, and after a corrupt record it resumes
+ * at the next one, found by its magic.
+ *
+ * usage: log_decoder <data.bin> [output directory] [--columnar]
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "log_format.h"
+
+struct column
+{
+  std::string name;
+  std::string type;
+  std::vector<uint8_t> data;
+
+  template <typename T>
+  void push(T val)
+  {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&val);
+    data.insert(data.end(), bytes, bytes + sizeof(T));
+  }
+
+  std::string format(size_t row) const
+  {
+    char buf[32];
+    const uint8_t *at = data.data();
+    if (type == "u32")
+    {
+      uint32_t val;
+      memcpy(&val, at + row * sizeof(val), sizeof(val));
+      snprintf(buf, sizeof(buf), "%lu", (unsigned long)val);
+    }
+    else if (type == "u8")
+    {
+      snprintf(buf, sizeof(buf), "%u", at[row]);
+    }
+    else
+    {
+      float val;
+      memcpy(&val, at + row * sizeof(val), sizeof(val));
+      snprintf(buf, sizeof(buf), "%.4f", val);
+    }
+    return buf;
+  }
+
+  size_t width() const
+  {
+    return type == "u8" ? 1 : 4;
+  }
+};
+
+struct table
+{
+  std::string name;
+  std::vector<column> columns;
+  size_t rows = 0;
+
+  table(const std::string &name, std::initializer_list<std::pair<const char *, const char *>> schema)
+      : name(name)
+  {
+    for (const auto &col : schema)
+    {
+      columns.push_back({col.first, col.second, {}});
+    }
+  }
+
+  bool write_csv(const std::string &dir) const
+  {
+    FILE *out = fopen((dir + "/" + name + ".csv").c_str(), "w");
+    if (!out)
+    {
+      return false;
+    }
+    for (size_t i = 0; i < columns.size(); i++)
+    {
+      fprintf(out, "%s%s", i == 0 ? "" : ",", columns[i].name.c_str());
+    }
+    fprintf(out, "\n");
+    for (size_t row = 0; row < rows; row++)
+    {
+      for (size_t i = 0; i < columns.size(); i++)
+      {
+        fprintf(out, "%s%s", i == 0 ? "" : ",", columns[i].format(row).c_str());
+      }
+      fprintf(out, "\n");
+    }
+    fclose(out);
+    return true;
+  }
+
+  bool write_columnar(const std::string &dir) const
+  {
+    FILE *schema = fopen((dir + "/" + name + ".schema").c_str(), "w");
+    if (!schema)
+    {
+      return false;
+    }
+    fprintf(schema, "rows %zu\n", rows);
+    for (const column &col : columns)
+    {
+      fprintf(schema, "%s %s\n", col.name.c_str(), col.type.c_str());
+      FILE *out = fopen((dir + "/" + name + "." + col.name + ".bin").c_str(), "wb");
+      if (!out)
+      {
+        fclose(schema);
+        return false;
+      }
+      fwrite(col.data.data(), 1, col.data.size(), out);
+      fclose(out);
+    }
+    fclose(schema);
+    return true;
+  }
+};
+
+template <typename R>
+bool read_record(const std::vector<uint8_t> &log, size_t pos, R &record)
+{
+  if (log[pos] < sizeof(R))
+  {
+    return false;
+  }
+  memcpy(&record, log.data() + pos, sizeof(R));
+  return true;
+}
+
+// the session record at pos if there is a valid one, version 1 sessions
+// get gyro_lsb_per_dps = 0
+static bool read_session(const std::vector<uint8_t> &log, size_t pos, session_record &record)
+{
+  if (pos + SESSION_RECORD_V1_SIZE > log.size())
+  {
+    return false;
+  }
+  record_header header;
+  memcpy(&header, log.data() + pos, sizeof(header));
+  if (static_cast<record_type>(header.type) != record_type::SESSION || header.length < SESSION_RECORD_V1_SIZE ||
+      pos + header.length > log.size())
+  {
+    return false;
+  }
+  record = session_record();
+  memcpy(&record, log.data() + pos, header.length < sizeof(record) ? header.length : sizeof(record));
+  return record.magic == LOG_MAGIC && record.version >= 1 && record.accel_lsb_per_g != 0;
+}
+
+// first valid session record from pos up to end, or end
+static size_t next_session(const std::vector<uint8_t> &log, size_t pos, size_t end)
+{
+  session_record record;
+  for (; pos < end; pos++)
+  {
+    if (read_session(log, pos, record))
+    {
+      return pos;
+    }
+  }
+  return end;
+}
+
+int main(int argc, char **argv)
+{
+  std::string input;
+  std::string output = ".";
+  bool columnar = false;
+  int positional = 0;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--columnar") == 0)
+    {
+      columnar = true;
+    }
+    else if (positional++ == 0)
+    {
+      input = argv[i];
+    }
+    else
+    {
+      output = argv[i];
+    }
+  }
+  if (input.empty())
+  {
+    fprintf(stderr, "usage: %s <data.bin> [output directory] [--columnar]\n", argv[0]);
+    return 1;
+  }
+
+  std::ifstream file(input, std::ios::binary);
+  if (!file)
+  {
+    fprintf(stderr, "could not open %s\n", input.c_str());
+    return 1;
+  }
+  const std::vector<uint8_t> log((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  table sessions("session", {{"timestamp_ms", "u32"}, {"version", "u8"}, {"accel_lsb_per_g", "u32"}, {"gyro_lsb_per_dps", "u32"}});
+  table accel("accel", {{"timestamp_ms", "u32"}, {"x", "f32"}, {"y", "f32"}, {"z", "f32"}});
+  table gyro("gyro", {{"timestamp_ms", "u32"}, {"x", "f32"}, {"y", "f32"}, {"z", "f32"}});
+  table steps("step", {{"timestamp_ms", "u32"}, {"steps", "u32"}});
+  table modes("mode", {{"timestamp_ms", "u32"}, {"kind", "u8"}, {"value", "u8"}});
+  table touches("touch", {{"timestamp_ms", "u32"}, {"pad", "u8"}});
+  table turns("turn", {{"timestamp_ms", "u32"}, {"angle_deg", "f32"}, {"duration_ms", "u32"}});
+  table strides("stride", {{"timestamp_ms", "u32"}, {"stride_m", "f32"}, {"distance_m", "f32"}, {"pace_s_per_km", "u32"}});
+
+  float accel_scale = 1.0f / ACCEL_LSB_PER_G;
+  float gyro_scale = 1.0f / GYRO_LSB_PER_DPS;
+  size_t unknown = 0;
+  size_t padding = 0;
+  // records are only trusted after a session record
+  size_t pos = next_session(log, 0, log.size());
+  size_t skipped = pos;
+  while (pos + sizeof(record_header) <= log.size())
+  {
+    if (log[pos] == 0)
+    {
+      padding++;
+      pos++;
+      continue;
+    }
+    record_header header;
+    memcpy(&header, log.data() + pos, sizeof(header));
+    if (header.length < sizeof(record_header) || pos + header.length > log.size())
+    {
+      // corrupt or truncated record, resync on the next session
+      const size_t next = next_session(log, pos + 1, log.size());
+      skipped += next - pos;
+      pos = next;
+      continue;
+    }
+    // a record cut off when the board lost power can run into the session
+    // written after the next boot, the session wins
+    const size_t cut = next_session(log, pos + 1, pos + header.length);
+    if (cut < pos + header.length)
+    {
+      skipped += cut - pos;
+      pos = cut;
+      continue;
+    }
+
+    bool ok = true;
+    switch (static_cast<record_type>(header.type))
+    {
+    case record_type::SESSION:
+    {
+      session_record record;
+      ok = read_session(log, pos, record);
+      if (!ok)
+      {
+        break;
+      }
+      if (record.version > LOG_FORMAT_VERSION)
+      {
+        fprintf(stderr, "warning: session at byte %zu has format version %u, newer than %u\n",
+                pos, record.version, LOG_FORMAT_VERSION);
+      }
+      accel_scale = 1.0f / record.accel_lsb_per_g;
+      gyro_scale = 1.0f / (record.gyro_lsb_per_dps == 0 ? GYRO_LSB_PER_DPS : record.gyro_lsb_per_dps);
+      sessions.columns[0].push<uint32_t>(header.timestamp_ms);
+      sessions.columns[1].push<uint8_t>(record.version);
+      sessions.columns[2].push<uint32_t>(record.accel_lsb_per_g);
+      sessions.columns[3].push<uint32_t>(record.gyro_lsb_per_dps);
+      sessions.rows++;
+      break;
+    }
+    case record_type::ACCEL:
+    {
+      accel_record record;
+      ok = read_record(log, pos, record);
+      if (!ok)
+      {
+        break;
+      }
+      accel.columns[0].push<uint32_t>(header.timestamp_ms);
+      for (size_t i = 0; i < 3; i++)
+      {
+        accel.columns[i + 1].push<float>(record.accel[i] * accel_scale);
+      }
+      accel.rows++;
+      break;
+    }
+    case record_type::GYRO:
+    {
+      gyro_record record;
+      ok = read_record(log, pos, record);
+      if (!ok)
+      {
+        break;
+      }
+      gyro.columns[0].push<uint32_t>(header.timestamp_ms);
+      for (size_t i = 0; i < 3; i++)
+      {
+        gyro.columns[i + 1].push<float>(record.gyro[i] * gyro_scale);
+      }
+      gyro.rows++;
+      break;
+    }
+    case record_type::STEP:
+    {
+      step_record record;
+      ok = read_record(log, pos, record);
+      if (!ok)
+      {
+        break;
+      }
+      steps.columns[0].push<uint32_t>(header.timestamp_ms);
+      steps.columns[1].push<uint32_t>(record.steps);
+      steps.rows++;
+      break;
+    }
+    case record_type::MODE:
+    {
+      mode_record record;
+      ok = read_record(log, pos, record);
+      if (!ok)
+      {
+        break;
+      }
+      modes.columns[0].push<uint32_t>(header.timestamp_ms);
+      modes.columns[1].push<uint8_t>(record.kind);
+      modes.columns[2].push<uint8_t>(record.value);
+      modes.rows++;
+      break;
+    }
+    case record_type::TOUCH:
+    {
+      touch_record record;
+      ok = read_record(log, pos, record);
+      if (!ok)
+      {
+        break;
+      }
+      touches.columns[0].push<uint32_t>(header.timestamp_ms);
+      touches.columns[1].push<uint8_t>(record.pad);
+      touches.rows++;
+      break;
+    }
+    case record_type::TURN:
+    {
+      turn_record record;
+      ok = read_record(log, pos, record);
+      if (!ok)
+      {
+        break;
+      }
+      turns.columns[0].push<uint32_t>(header.timestamp_ms);
+      turns.columns[1].push<float>(record.angle_ddeg / 10.0f);
+      turns.columns[2].push<uint32_t>(record.duration_ms);
+      turns.rows++;
+      break;
+    }
+    case record_type::STRIDE:
+    {
+      stride_record record;
+      ok = read_record(log, pos, record);
+      if (!ok)
+      {
+        break;
+      }
+      strides.columns[0].push<uint32_t>(header.timestamp_ms);
+      strides.columns[1].push<float>(record.stride_mm / 1000.0f);
+      strides.columns[2].push<float>(record.distance_dm / 10.0f);
+      strides.columns[3].push<uint32_t>(record.pace_s_per_km);
+      strides.rows++;
+      break;
+    }
+    default:
+      unknown++;
+      break;
+    }
+
+    if (!ok)
+    {
+      const size_t next = next_session(log, pos + 1, log.size());
+      skipped += next - pos;
+      pos = next;
+      continue;
+    }
+    pos += header.length;
+  }
+  // padding or a record header cut off at the end
+  for (; pos < log.size(); pos++)
+  {
+    if (log[pos] == 0)
+    {
+      padding++;
+    }
+    else
+    {
+      skipped++;
+    }
+  }
+
+  for (const table *t : {&sessions, &accel, &gyro, &steps, &modes, &touches, &turns, &strides})
+  {
+    if (!(columnar ? t->write_columnar(output) : t->write_csv(output)))
+    {
+      fprintf(stderr, "could not write %s table to %s\n", t->name.c_str(), output.c_str());
+      return 1;
+    }
+    printf("%s: %zu rows\n", t->name.c_str(), t->rows);
+  }
+  printf("unknown records: %zu, skipped bytes: %zu, padding bytes: %zu\n", unknown, skipped, padding);
+  return 0;
+}
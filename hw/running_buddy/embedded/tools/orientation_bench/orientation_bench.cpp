@@ -0,0 +1,385 @@
+/**
+ * @file orientation_bench.cpp
+ *
+ * runs the orientation filter on synthetic rotations with a known true
+ * attitude and reports the cost of an update (ns and, on x86, TSC cycles)
+ * and its accuracy: tilt error, world yaw rate error and the error of the
+ * vertical linear acceleration the detectors get, next to the error of the
+ * |accel| - 1 g they used before.
+ *
+ * usage: program [--seconds s] [--rate hz] [--seed n] [--repeat n] [--json file]
+ *
+ * scenarios: static (tilted 30 degrees), tilt (slow +-40 degree swings),
+ * spin (up to ~300 dps about every axis) and run (worn tilted, stride sway,
+ * vertical impacts, braking and push off, lateral sway and a 90 degree turn
+ * every 15 s). the gyroscope has a bias of ~1 dps on every axis.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#include "orientation.h"
+#include "vec3.h"
+
+#define TRUTH_STEPS_PER_SAMPLE 10
+#define SETTLE_S 2.0
+
+struct dquat
+{
+  double w, x, y, z;
+};
+
+struct dvec
+{
+  double x, y, z;
+};
+
+struct sample
+{
+  uint32_t t_us;
+  vec3 accel;
+  vec3 gyro;
+  // truth
+  dvec up_body;
+  double yaw_rate_dps;
+  double vertical_g;
+};
+
+struct metrics
+{
+  std::string scenario;
+  size_t samples = 0;
+  double ns_per_update = 0;
+  double cycles_per_update = 0;
+  double tilt_deg_mean = 0;
+  double tilt_deg_max = 0;
+  double yaw_rate_dps_rms = 0;
+  double vertical_g_rms = 0;
+  double magnitude_g_rms = 0;
+};
+
+static dquat mul(const dquat &a, const dquat &b)
+{
+  return {a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+          a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+          a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+          a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w};
+}
+
+// body to world
+static dvec rotate(const dquat &q, const dvec &v)
+{
+  const dquat p = mul(mul(q, {0, v.x, v.y, v.z}), {q.w, -q.x, -q.y, -q.z});
+  return {p.x, p.y, p.z};
+}
+
+static dvec unrotate(const dquat &q, const dvec &v)
+{
+  return rotate({q.w, -q.x, -q.y, -q.z}, v);
+}
+
+// q advanced by body rate w (rad/s) for dt
+static dquat advance(const dquat &q, const dvec &w, double dt)
+{
+  const double rate = sqrt(w.x * w.x + w.y * w.y + w.z * w.z);
+  if (rate < 1e-12)
+  {
+    return q;
+  }
+  const double half = rate * dt / 2;
+  const double s = sin(half) / rate;
+  dquat r = mul(q, {cos(half), w.x * s, w.y * s, w.z * s});
+  const double n = sqrt(r.w * r.w + r.x * r.x + r.y * r.y + r.z * r.z);
+  return {r.w / n, r.x / n, r.y / n, r.z / n};
+}
+
+// body rate in rad/s and world linear acceleration in g at time t
+struct motion
+{
+  dvec rate;
+  dvec linear;
+};
+
+static motion scenario_motion(const std::string &name, double t)
+{
+  const double deg = M_PI / 180;
+  motion m = {{0, 0, 0}, {0, 0, 0}};
+  if (name == "tilt")
+  {
+    m.rate = {40 * deg * 2 * M_PI * 0.2 * cos(2 * M_PI * 0.2 * t),
+              40 * deg * 2 * M_PI * 0.13 * cos(2 * M_PI * 0.13 * t), 0};
+  }
+  else if (name == "spin")
+  {
+    m.rate = {300 * deg * sin(2 * M_PI * 0.7 * t), 200 * deg * sin(2 * M_PI * 1.1 * t + 1),
+              250 * deg * sin(2 * M_PI * 0.4 * t + 2)};
+  }
+  else if (name == "run")
+  {
+    // 170 spm: sway at the stride rate, impacts at the step rate
+    const double step_hz = 170.0 / 60;
+    const double stride = 2 * M_PI * step_hz / 2;
+    m.rate = {8 * deg * stride * cos(stride * t), 5 * deg * 2 * stride * cos(2 * stride * t),
+              15 * deg * stride * cos(stride * t + 0.5)};
+    const double turn = fmod(t, 15.0);
+    if (t > 5 && turn >= 5 && turn < 6)
+    {
+      m.rate.z += 90 * deg;
+    }
+    // a vertical impact with its mean taken out, braking then push off
+    // along x and the lateral sway of the stride along y
+    const double phase = fmod(t * step_hz, 1.0);
+    const double d = (phase - 0.2) / 0.06;
+    m.linear.z = 1.2 * exp(-0.5 * d * d) - 1.2 * 0.06 * sqrt(2 * M_PI);
+    m.linear.x = 0.6 * d * exp(-0.5 * d * d);
+    m.linear.y = 0.3 * sin(stride * t);
+  }
+  return m;
+}
+
+static std::vector<sample> synthesize(const std::string &name, double seconds, double rate_hz, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> accel_noise(0.0, 0.02);
+  std::normal_distribution<double> gyro_noise(0.0, 0.3);
+  const dvec gyro_bias = {0.8, -0.5, 1.0};
+
+  dquat q = {1, 0, 0, 0};
+  if (name == "static" || name == "run")
+  {
+    // worn tilted
+    const double half = 30 * M_PI / 180 / 2;
+    q = {cos(half), sin(half) * 0.6, sin(half) * 0.8, 0};
+  }
+
+  std::vector<sample> samples;
+  const double dt = 1 / rate_hz;
+  const double sub = dt / TRUTH_STEPS_PER_SAMPLE;
+  for (size_t n = 0; n * dt < seconds; n++)
+  {
+    const double t = n * dt;
+    const motion m = scenario_motion(name, t);
+    const dvec specific = unrotate(q, {m.linear.x, m.linear.y, m.linear.z + 1});
+    const dvec up = unrotate(q, {0, 0, 1});
+    const dvec world_rate = rotate(q, m.rate);
+
+    sample s;
+    s.t_us = static_cast<uint32_t>(llround(t * 1e6));
+    s.accel[0] = specific.x + accel_noise(rng);
+    s.accel[1] = specific.y + accel_noise(rng);
+    s.accel[2] = specific.z + accel_noise(rng);
+    s.gyro[0] = m.rate.x * 180 / M_PI + gyro_bias.x + gyro_noise(rng);
+    s.gyro[1] = m.rate.y * 180 / M_PI + gyro_bias.y + gyro_noise(rng);
+    s.gyro[2] = m.rate.z * 180 / M_PI + gyro_bias.z + gyro_noise(rng);
+    s.up_body = up;
+    s.yaw_rate_dps = world_rate.z * 180 / M_PI;
+    s.vertical_g = m.linear.z;
+    samples.push_back(s);
+
+    for (int i = 0; i < TRUTH_STEPS_PER_SAMPLE; i++)
+    {
+      q = advance(q, scenario_motion(name, t + (i + 0.5) * sub).rate, sub);
+    }
+  }
+  return samples;
+}
+
+static metrics measure(const std::string &name, const std::vector<sample> &samples, int repeat)
+{
+  metrics res;
+  res.scenario = name;
+  res.samples = samples.size();
+
+  // timing on its own, accuracy from a separate pass
+  double best_ns = 0;
+  double best_cycles = 0;
+  for (int rep = 0; rep < repeat; rep++)
+  {
+    orientation filter;
+    const auto start = std::chrono::steady_clock::now();
+#if HAVE_TSC
+    const uint64_t tsc_start = __rdtsc();
+#endif
+    for (const sample &s : samples)
+    {
+      filter.update(s.accel, s.gyro, s.t_us);
+    }
+#if HAVE_TSC
+    const double cycles = static_cast<double>(__rdtsc() - tsc_start) / samples.size();
+#else
+    const double cycles = 0;
+#endif
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                      samples.size();
+    // keeps the loop from being optimized away
+    if (filter.attitude().w > 2)
+    {
+      printf("\n");
+    }
+    if (rep == 0 || ns < best_ns)
+    {
+      best_ns = ns;
+      best_cycles = cycles;
+    }
+  }
+  res.ns_per_update = best_ns;
+  res.cycles_per_update = best_cycles;
+
+  orientation filter;
+  size_t counted = 0;
+  double tilt_sum = 0;
+  double yaw_sq = 0;
+  double vertical_sq = 0;
+  double magnitude_sq = 0;
+  for (const sample &s : samples)
+  {
+    filter.update(s.accel, s.gyro, s.t_us);
+    if (s.t_us < SETTLE_S * 1e6)
+    {
+      continue;
+    }
+    // estimated up in the body frame is the z row of to_world()
+    const quat &q = filter.attitude();
+    const dvec up = {2.0f * (q.x * q.z - q.w * q.y), 2.0f * (q.y * q.z + q.w * q.x), 1.0f - 2.0f * (q.x * q.x + q.y * q.y)};
+    const double dot = up.x * s.up_body.x + up.y * s.up_body.y + up.z * s.up_body.z;
+    const double tilt = acos(std::max(-1.0, std::min(1.0, dot))) * 180 / M_PI;
+    tilt_sum += tilt;
+    res.tilt_deg_max = std::max(res.tilt_deg_max, tilt);
+
+    const double yaw_error = filter.yaw_rate(s.gyro) - s.yaw_rate_dps;
+    yaw_sq += yaw_error * yaw_error;
+    const double vertical_error = filter.linear_accel(s.accel)[2] - s.vertical_g;
+    vertical_sq += vertical_error * vertical_error;
+    const double magnitude = sqrt(s.accel[0] * s.accel[0] + s.accel[1] * s.accel[1] + s.accel[2] * s.accel[2]);
+    magnitude_sq += (magnitude - 1 - s.vertical_g) * (magnitude - 1 - s.vertical_g);
+    counted++;
+  }
+  if (counted > 0)
+  {
+    res.tilt_deg_mean = tilt_sum / counted;
+    res.yaw_rate_dps_rms = sqrt(yaw_sq / counted);
+    res.vertical_g_rms = sqrt(vertical_sq / counted);
+    res.magnitude_g_rms = sqrt(magnitude_sq / counted);
+  }
+  return res;
+}
+
+static void write_json(FILE *out, double seconds, double rate_hz, unsigned seed, const std::vector<metrics> &results)
+{
+  fprintf(out, "{\n");
+  fprintf(out, "  \"seconds\": %.1f,\n", seconds);
+  fprintf(out, "  \"rate_hz\": %.1f,\n", rate_hz);
+  fprintf(out, "  \"seed\": %u,\n", seed);
+  fprintf(out, "  \"beta\": %.3f,\n", ORIENTATION_BETA);
+  fprintf(out, "  \"scenarios\": [\n");
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const metrics &m = results[i];
+    fprintf(out, "    {\"name\": \"%s\", \"samples\": %zu, \"ns_per_update\": %.1f, ", m.scenario.c_str(),
+            m.samples, m.ns_per_update);
+    if (HAVE_TSC)
+    {
+      fprintf(out, "\"cycles_per_update\": %.0f, ", m.cycles_per_update);
+    }
+    else
+    {
+      fprintf(out, "\"cycles_per_update\": null, ");
+    }
+    fprintf(out, "\"tilt_deg_mean\": %.3f, \"tilt_deg_max\": %.3f, \"yaw_rate_dps_rms\": %.3f, ",
+            m.tilt_deg_mean, m.tilt_deg_max, m.yaw_rate_dps_rms);
+    fprintf(out, "\"vertical_g_rms\": %.4f, \"magnitude_g_rms\": %.4f}%s\n", m.vertical_g_rms, m.magnitude_g_rms,
+            i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "usage: %s [--seconds s] [--rate hz] [--seed n] [--repeat n] [--json file]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+  double seconds = 120;
+  double rate_hz = 104;
+  unsigned seed = 1;
+  int repeat = 5;
+  std::string json_path;
+  for (int i = 1; i < argc; i++)
+  {
+    if (i + 1 >= argc)
+    {
+      usage(argv[0]);
+      return 1;
+    }
+    const char *arg = argv[i];
+    const char *value = argv[++i];
+    if (strcmp(arg, "--seconds") == 0)
+    {
+      seconds = strtod(value, nullptr);
+    }
+    else if (strcmp(arg, "--rate") == 0)
+    {
+      rate_hz = strtod(value, nullptr);
+    }
+    else if (strcmp(arg, "--seed") == 0)
+    {
+      seed = strtoul(value, nullptr, 10);
+    }
+    else if (strcmp(arg, "--repeat") == 0)
+    {
+      repeat = atoi(value);
+    }
+    else if (strcmp(arg, "--json") == 0)
+    {
+      json_path = value;
+    }
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (seconds <= SETTLE_S || rate_hz <= 0 || repeat < 1)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<metrics> results;
+  for (const char *name : {"static", "tilt", "spin", "run"})
+  {
+    results.push_back(measure(name, synthesize(name, seconds, rate_hz, seed), repeat));
+  }
+
+  FILE *out = stdout;
+  if (!json_path.empty())
+  {
+    out = fopen(json_path.c_str(), "w");
+    if (!out)
+    {
+      fprintf(stderr, "could not write %s\n", json_path.c_str());
+      return 1;
+    }
+  }
+  write_json(out, seconds, rate_hz, seed, results);
+  if (out != stdout)
+  {
+    fclose(out);
+  }
+  return 0;
+}
@@ -1,7 +1,11 @@
 import serial
 
+# records the samples the firmware prints when built with -D SERIAL_CSV=1,
+# "x, y, z, gx, gy, gz" in g and dps. the other lines on serial (step,...,
+# imu,..., sched,... and so on) are skipped
+
 arduino_port = "/dev/ttyACM0" #serial port of Arduino
-baud = 115200 #arduino uno runs at 9600 baud
+baud = 115200 #BAUD_RATE in src/main.cpp
 fileName="filename.csv" #name of the CSV file generated
 
 ser = serial.Serial(arduino_port, baud)
@@ -11,10 +15,21 @@ print("Created file")
 
 samples = 50 #how many samples to collect
 print_labels = False
+
+
+def sample_row(text):
+    fields = [field.strip() for field in text.split(",")]
+    if len(fields) not in (3, 6):
+        return None
+    try:
+        [float(field) for field in fields]
+    except ValueError:
+        return None
+    return ", ".join(fields)
+
+
 line = 0 #start at 0 because our header is 0 (not real data)
 while line <= samples:
-    # incoming = ser.read(9999)
-    # if len(incoming) > 0:
     if print_labels:
         if line==0:
             print("Printing Column Headers")
@@ -22,16 +37,15 @@ while line <= samples:
             print("Line " + str(line) + ": writing...")
 
     if line==0:
-    	data = "x, y, z, gx, gy, gz"
+        data = "x, y, z, gx, gy, gz"
     else:
-	    getData=str(ser.readline())
-	    data=getData[2:-3][:-2]
+        data = sample_row(ser.readline().decode("ascii", errors="replace"))
+        if data is None:
+            continue
     print(data)
 
-    file = open(fileName, "a")
     file.write(data + "\n") #write data with a newline
     line = line+1
 
 print("Data collection complete!")
 file.close()
-
@@ -0,0 +1,313 @@
+#ifndef BIQUAD
+#define BIQUAD
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * biquad cascades with float, Q15 and Q31 kernels
+ *
+ * coefficients are given as floats normalised to a0 = 1,
+ * y = b0 x + b1 x1 + b2 x2 - a1 y1 - a2 y2, and converted to the kernel's
+ * format when set. the design helpers are constexpr so default filters are
+ * computed at compile time from a cutoff and a sample rate.
+ */
+
+struct biquad_coeffs
+{
+  float b0, b1, b2, a1, a2;
+};
+
+// compile time design, RBJ audio EQ cookbook. written as single return
+// constexpr functions for C++11
+
+constexpr double BIQUAD_PI = 3.14159265358979323846;
+
+constexpr double biquad_sin_series(double x2, double term, double sum, int n)
+{
+  return n > 14 ? sum : biquad_sin_series(x2, -term * x2 / ((2 * n) * (2 * n + 1)), sum + term, n + 1);
+}
+
+constexpr double biquad_sin(double x)
+{
+  return biquad_sin_series(x * x, x, 0, 1);
+}
+
+constexpr double biquad_cos(double x)
+{
+  return biquad_sin(BIQUAD_PI / 2 - x);
+}
+
+constexpr biquad_coeffs biquad_normalize(double b0, double b1, double b2, double a0, double a1, double a2)
+{
+  return biquad_coeffs{static_cast<float>(b0 / a0), static_cast<float>(b1 / a0), static_cast<float>(b2 / a0),
+                       static_cast<float>(a1 / a0), static_cast<float>(a2 / a0)};
+}
+
+constexpr biquad_coeffs biquad_lowpass_from(double cos_w0, double alpha)
+{
+  return biquad_normalize((1 - cos_w0) / 2, 1 - cos_w0, (1 - cos_w0) / 2, 1 + alpha, -2 * cos_w0, 1 - alpha);
+}
+
+constexpr biquad_coeffs biquad_highpass_from(double cos_w0, double alpha)
+{
+  return biquad_normalize((1 + cos_w0) / 2, -(1 + cos_w0), (1 + cos_w0) / 2, 1 + alpha, -2 * cos_w0, 1 - alpha);
+}
+
+// q = 0.7071 is a second order butterworth
+constexpr biquad_coeffs biquad_lowpass(double fs, double fc, double q)
+{
+  return biquad_lowpass_from(biquad_cos(2 * BIQUAD_PI * fc / fs), biquad_sin(2 * BIQUAD_PI * fc / fs) / (2 * q));
+}
+
+constexpr biquad_coeffs biquad_highpass(double fs, double fc, double q)
+{
+  return biquad_highpass_from(biquad_cos(2 * BIQUAD_PI * fc / fs), biquad_sin(2 * BIQUAD_PI * fc / fs) / (2 * q));
+}
+
+constexpr biquad_coeffs biquad_passthrough()
+{
+  return biquad_coeffs{1, 0, 0, 0, 0};
+}
+
+// stable when both poles are inside the unit circle
+inline bool biquad_stable(const biquad_coeffs &c)
+{
+  return c.a2 < 1 && c.a2 > -1 && c.a1 < 1 + c.a2 && c.a1 > -(1 + c.a2);
+}
+
+// dc gain, 0 for a highpass
+inline float biquad_dc_gain(const biquad_coeffs &c)
+{
+  const float den = 1 + c.a1 + c.a2;
+  return den != 0 ? (c.b0 + c.b1 + c.b2) / den : 0;
+}
+
+template <typename T>
+struct biquad_kernel;
+
+// transposed direct form II, samples are ADC counts as floats
+template <>
+struct biquad_kernel<float>
+{
+  typedef biquad_coeffs coeffs;
+
+  struct state
+  {
+    float s1, s2;
+  };
+
+  static coeffs convert(const biquad_coeffs &c)
+  {
+    return c;
+  }
+
+  static float from_counts(int16_t x)
+  {
+    return x;
+  }
+
+  static int16_t to_counts(float y)
+  {
+    const float rounded = y < 0 ? y - 0.5f : y + 0.5f;
+    return rounded > 32767 ? 32767 : rounded < -32768 ? -32768
+                                                      : static_cast<int16_t>(rounded);
+  }
+
+  // the state a constant input x would have settled to
+  static void prime(state &s, const coeffs &c, float x, float y)
+  {
+    s.s2 = c.b2 * x - c.a2 * y;
+    s.s1 = c.b1 * x - c.a1 * y + s.s2;
+  }
+
+  static float step(const coeffs &c, state &s, float x)
+  {
+    const float y = c.b0 * x + s.s1;
+    s.s1 = c.b1 * x - c.a1 * y + s.s2;
+    s.s2 = c.b2 * x - c.a2 * y;
+    return y;
+  }
+};
+
+/**
+ * fixed point direct form I with first order error feedback: the bits
+ * shifted out of one output are added back into the next, which keeps low
+ * cutoff filters (poles close to 1) usable at these word lengths
+ */
+template <typename sample_t, typename coeff_t, typename acc_t, int FRAC_BITS, int SAMPLE_SHIFT>
+struct biquad_fixed_kernel
+{
+  struct coeffs
+  {
+    coeff_t b0, b1, b2, a1, a2;
+  };
+
+  struct state
+  {
+    sample_t x1, x2, y1, y2;
+    acc_t error;
+  };
+
+  static coeff_t to_fixed(float value)
+  {
+    // coefficients are Q2.FRAC_BITS, so |value| < 2
+    const double scaled = static_cast<double>(value) * (static_cast<acc_t>(1) << FRAC_BITS);
+    const acc_t max = (static_cast<acc_t>(1) << (sizeof(coeff_t) * 8 - 1)) - 1;
+    if (scaled >= max)
+    {
+      return static_cast<coeff_t>(max);
+    }
+    if (scaled <= -max)
+    {
+      return static_cast<coeff_t>(-max);
+    }
+    return static_cast<coeff_t>(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+  }
+
+  static coeffs convert(const biquad_coeffs &c)
+  {
+    return coeffs{to_fixed(c.b0), to_fixed(c.b1), to_fixed(c.b2), to_fixed(c.a1), to_fixed(c.a2)};
+  }
+
+  static sample_t saturate(acc_t value)
+  {
+    const acc_t max = (static_cast<acc_t>(1) << (sizeof(sample_t) * 8 - 1)) - 1;
+    return value > max ? max : value < -max - 1 ? -max - 1
+                                                : static_cast<sample_t>(value);
+  }
+
+  static sample_t from_counts(int16_t x)
+  {
+    return static_cast<sample_t>(static_cast<acc_t>(x) * (static_cast<acc_t>(1) << SAMPLE_SHIFT));
+  }
+
+  static int16_t to_counts(sample_t y)
+  {
+    const acc_t half = SAMPLE_SHIFT > 0 ? static_cast<acc_t>(1) << (SAMPLE_SHIFT - 1) : 0;
+    const acc_t counts = (static_cast<acc_t>(y) + half) >> SAMPLE_SHIFT;
+    return counts > 32767 ? 32767 : counts < -32768 ? -32768
+                                                    : static_cast<int16_t>(counts);
+  }
+
+  static void prime(state &s, const coeffs &, sample_t x, sample_t y)
+  {
+    s.x1 = s.x2 = x;
+    s.y1 = s.y2 = y;
+    s.error = 0;
+  }
+
+  static sample_t step(const coeffs &c, state &s, sample_t x)
+  {
+    const acc_t acc = s.error + static_cast<acc_t>(c.b0) * x + static_cast<acc_t>(c.b1) * s.x1 +
+                      static_cast<acc_t>(c.b2) * s.x2 - static_cast<acc_t>(c.a1) * s.y1 -
+                      static_cast<acc_t>(c.a2) * s.y2;
+    const sample_t y = saturate(acc >> FRAC_BITS);
+    const acc_t remainder = acc - static_cast<acc_t>(y) * (static_cast<acc_t>(1) << FRAC_BITS);
+    // after saturating the remainder is not a rounding error any more
+    s.error = remainder >= 0 && remainder < (static_cast<acc_t>(1) << FRAC_BITS) ? remainder : 0;
+    s.x2 = s.x1;
+    s.x1 = x;
+    s.y2 = s.y1;
+    s.y1 = y;
+    return y;
+  }
+};
+
+// Q15: samples are ADC counts in 16 bits, Q2.14 coefficients, 32 bit
+// accumulator. 12 bit counts leave 3 bits of headroom for filter gain
+template <>
+struct biquad_kernel<int16_t> : biquad_fixed_kernel<int16_t, int16_t, int32_t, 14, 0>
+{
+};
+
+// Q31: counts shifted up 16 bits, Q2.30 coefficients, 64 bit accumulator
+template <>
+struct biquad_kernel<int32_t> : biquad_fixed_kernel<int32_t, int32_t, int64_t, 30, 16>
+{
+};
+
+/**
+ * STAGES biquads in series. process() runs a whole block through one stage
+ * before the next, in and out may be the same buffer
+ */
+template <typename T, size_t STAGES>
+class biquad_cascade
+{
+public:
+  typedef biquad_kernel<T> kernel;
+
+  biquad_cascade()
+  {
+    for (size_t i = 0; i < STAGES; i++)
+    {
+      set(i, biquad_passthrough());
+    }
+    reset();
+  }
+
+  void set(size_t stage, const biquad_coeffs &c)
+  {
+    if (stage >= STAGES)
+    {
+      return;
+    }
+    design[stage] = c;
+    coeffs[stage] = kernel::convert(c);
+  }
+
+  void set(const biquad_coeffs (&c)[STAGES])
+  {
+    for (size_t i = 0; i < STAGES; i++)
+    {
+      set(i, c[i]);
+    }
+  }
+
+  const biquad_coeffs &get(size_t stage) const
+  {
+    return design[stage];
+  }
+
+  void reset()
+  {
+    for (size_t i = 0; i < STAGES; i++)
+    {
+      states[i] = typename kernel::state();
+    }
+  }
+
+  // settles every stage on a constant input x, avoiding the step response
+  // a highpass would otherwise give to the sensor's resting value
+  void prime(T x)
+  {
+    for (size_t i = 0; i < STAGES; i++)
+    {
+      const T y = static_cast<T>(x * biquad_dc_gain(design[i]));
+      kernel::prime(states[i], coeffs[i], x, y);
+      x = y;
+    }
+  }
+
+  void process(const T *in, T *out, size_t n)
+  {
+    for (size_t i = 0; i < STAGES; i++)
+    {
+      const typename kernel::coeffs &c = coeffs[i];
+      typename kernel::state s = states[i];
+      const T *src = i == 0 ? in : out;
+      for (size_t k = 0; k < n; k++)
+      {
+        out[k] = kernel::step(c, s, src[k]);
+      }
+      states[i] = s;
+    }
+  }
+
+private:
+  biquad_coeffs design[STAGES];
+  typename kernel::coeffs coeffs[STAGES];
+  typename kernel::state states[STAGES];
+};
+
+#endif
@@ -7,6 +7,7 @@
 #include <BLEServer.h>
 
 void setup_ble();
+// to every connection, frames and jumps go through clients.h
 void send_message(std::string message);
 
 #endif
@@ -0,0 +1,129 @@
+#ifndef BROADCAST_QUEUE
+#define BROADCAST_QUEUE
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * lock-free ring buffer from one producer task to up to READERS readers,
+ * all served by one consumer task
+ *
+ * every attached reader has its own cursor and sees every item pushed after
+ * it attached. items stay in place until the slowest reader is past them
+ * and release() has run, nothing is copied per reader. like spsc_queue the
+ * producer never blocks, a push into a full ring is refused and counted. the
+ * consumer keeps the producer from stalling by skipping a reader that falls
+ * too far behind.
+ */
+template <typename T, size_t N, size_t READERS>
+class broadcast_queue
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "capacity must be a power of two");
+  static_assert(READERS >= 1 && READERS <= 32, "readers are tracked in a 32 bit mask");
+
+public:
+  // producer only
+  bool push(const T &item)
+  {
+    const uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= N)
+    {
+      overflow_count.store(overflow_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    items[h & (N - 1)] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer only from here on. a reader starts at the newest item
+  void attach(size_t reader)
+  {
+    cursors[reader] = head.load(std::memory_order_acquire);
+    attached_mask |= 1UL << reader;
+  }
+
+  void detach(size_t reader)
+  {
+    attached_mask &= ~(1UL << reader);
+  }
+
+  bool attached(size_t reader) const
+  {
+    return attached_mask & (1UL << reader);
+  }
+
+  size_t available(size_t reader) const
+  {
+    return head.load(std::memory_order_acquire) - cursors[reader];
+  }
+
+  // copies up to max items into out and moves the reader past them
+  size_t pop(size_t reader, T *out, size_t max)
+  {
+    const uint32_t c = cursors[reader];
+    const uint32_t count_available = head.load(std::memory_order_acquire) - c;
+    const size_t count = count_available < max ? count_available : max;
+    for (size_t i = 0; i < count; i++)
+    {
+      out[i] = items[(c + i) & (N - 1)];
+    }
+    cursors[reader] = c + count;
+    return count;
+  }
+
+  bool peek(size_t reader, T &item) const
+  {
+    if (available(reader) == 0)
+    {
+      return false;
+    }
+    item = items[cursors[reader] & (N - 1)];
+    return true;
+  }
+
+  // moves the reader past up to n items without reading them, returns how many
+  size_t skip(size_t reader, size_t n)
+  {
+    const size_t count_available = available(reader);
+    const size_t count = count_available < n ? count_available : n;
+    cursors[reader] += count;
+    return count;
+  }
+
+  // hands the slots every attached reader is done with back to the producer
+  void release()
+  {
+    const uint32_t h = head.load(std::memory_order_acquire);
+    uint32_t behind = 0;
+    for (size_t i = 0; i < READERS; i++)
+    {
+      if (attached(i) && h - cursors[i] > behind)
+      {
+        behind = h - cursors[i];
+      }
+    }
+    tail.store(h - behind, std::memory_order_release);
+  }
+
+  static constexpr size_t capacity()
+  {
+    return N;
+  }
+
+  uint32_t overflows() const
+  {
+    return overflow_count.load(std::memory_order_relaxed);
+  }
+
+private:
+  T items[N];
+  std::atomic<uint32_t> head{0};
+  std::atomic<uint32_t> tail{0};
+  std::atomic<uint32_t> overflow_count{0};
+  uint32_t cursors[READERS] = {};
+  uint32_t attached_mask = 0;
+};
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef CLIENTS
+#define CLIENTS
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "broadcast_queue.h"
+#include "config.h"
+#include "jump_detector.h"
+#include "sampler.h"
+#include "spsc_queue.h"
+#include "stream.h"
+#include "time_sync.h"
+
+// summaries waiting for the slowest client
+#define CLIENT_JUMP_QUEUE_LENGTH 8
+// longest voltage value
+#define CLIENT_VOLTAGE_MAX 8
+// connection changes from the BLE stack not yet applied by the BLE task
+#define CLIENT_EVENT_QUEUE_LENGTH 16
+// time sync pings from the BLE stack not yet answered by the BLE task
+#define CLIENT_PING_QUEUE_LENGTH 8
+
+// what a client receives, written as one byte to the subscribe characteristic
+enum client_feed : uint8_t
+{
+  // unfiltered frames on the raw stream characteristic
+  FEED_RAW = 0x01,
+  // every filtered frame on the stream characteristic
+  FEED_FILTERED = 0x02,
+  // jump summaries, and without FEED_FILTERED the filtered frames around
+  // each jump on the stream characteristic
+  FEED_JUMPS = 0x04,
+  FEED_VOLTAGE = 0x08,
+  FEED_ALL = 0x0f,
+};
+
+// characteristics notified to one connection at a time
+enum class notify_channel : uint8_t
+{
+  RAW_STREAM,
+  FILTERED_STREAM,
+  JUMP,
+  VOLTAGE,
+  STREAM_STATS,
+  SYNC_REPLY,
+};
+
+struct client_info
+{
+  bool connected;
+  uint16_t conn_id;
+  uint16_t mtu;
+  uint8_t feeds;
+  uint32_t jumps_sent;
+  // summaries skipped because the client was CLIENT_JUMP_QUEUE_LENGTH / 2 behind
+  uint32_t jumps_dropped;
+  // summaries queued, e.g. until the MTU exchange makes room for one
+  uint16_t jumps_waiting;
+  // voltage readings replaced by a newer one before the link had room
+  uint32_t voltage_dropped;
+  bool voltage_waiting;
+};
+
+/**
+ * fans the sampling pipeline out to up to BLE_MAX_CLIENTS connections
+ *
+ * the sampling task pushes every frame and summary once into a broadcast
+ * queue per feed and never waits for a client. each connection has a
+ * reader in the feeds it subscribed to, its own stream packetizers sized to
+ * its MTU and its own counters, so a slow client is decimated or skips
+ * ahead (see sample_stream) while the others keep their full rate.
+ *
+ * each connection also has its own time_sync. its pings are answered
+ * first in poll(), and once it is synced the connection's sample stamps and
+ * jump start times are in its phone's time base.
+ *
+ * connect(), disconnect(), set_mtu(), subscribe() and time_ping() are called
+ * from the BLE stack's callbacks and only queue an event. everything else
+ * runs on the BLE task, which applies the events at the start of poll().
+ */
+class client_fanout
+{
+public:
+  // sampling task, false if the feed was full
+  bool push_raw(const sample_record &frame);
+  bool push_filtered(const sample_record &frame);
+  bool push_window(const sample_record &frame);
+  bool push_jump(const jump_summary &summary);
+
+  // BLE stack, from one task
+  bool connect(uint16_t conn_id);
+  bool disconnect(uint16_t conn_id);
+  bool set_mtu(uint16_t conn_id, uint16_t mtu);
+  bool subscribe(uint16_t conn_id, uint8_t feeds);
+  // received_us is micros() as early in the write callback as possible
+  bool time_ping(uint16_t conn_id, const time_sync_ping &ping, uint32_t received_us);
+
+  // BLE task. poll() sends what is waiting for each client: summaries,
+  // then the latest voltage and stats, then the streams
+  void poll();
+  // queues a voltage reading for the clients with FEED_VOLTAGE
+  void send_voltage(const uint8_t *data, size_t len);
+  // queues one stream_stats notification per open stream of every client
+  void send_stats(uint32_t now_ms);
+
+  size_t connected() const;
+  client_info info(size_t slot) const;
+  const time_sync &time_base(size_t slot) const
+  {
+    return slots[slot].clock;
+  }
+  // false if the client in the slot has no stream of that feed
+  bool stream_stats_of(size_t slot, uint8_t feed, uint32_t now_ms, stream_stats &out);
+
+private:
+  enum class event_type : uint8_t
+  {
+    CONNECT,
+    DISCONNECT,
+    MTU,
+    SUBSCRIBE,
+  };
+
+  struct event
+  {
+    event_type type;
+    uint16_t conn_id;
+    uint16_t value;
+  };
+
+  struct ping
+  {
+    uint16_t conn_id;
+    uint32_t received_us;
+    time_sync_ping value;
+  };
+
+  // the exchange waiting for the phone's receive time of its reply
+  struct exchange
+  {
+    uint16_t sequence;
+    uint64_t phone_us;
+    uint32_t received_us;
+    uint32_t replied_us;
+    bool reply_due;
+    bool replied;
+  };
+
+  struct client
+  {
+    client_info info;
+    time_sync clock;
+    exchange sync;
+    sample_stream raw;
+    sample_stream stream;
+    // filtered_feed, window_feed or null, the feed stream reads from
+    sample_feed *stream_source;
+    // the stream that got the link last is polled second, so neither
+    // takes all of a slow link
+    bool raw_first;
+    bool voltage_due;
+    // FEED_* bits of the streams whose stats are due
+    uint8_t stats_due;
+  };
+
+  void apply(const event &e);
+  void apply(const ping &p);
+  int find(uint16_t conn_id) const;
+  void set_feeds(size_t slot, uint8_t feeds);
+  void poll_sync(client &c);
+  void poll_jumps(size_t slot);
+  void poll_streams(client &c);
+  void poll_status(size_t slot);
+
+  spsc_queue<event, CLIENT_EVENT_QUEUE_LENGTH> events;
+  spsc_queue<ping, CLIENT_PING_QUEUE_LENGTH> pings;
+  sample_feed raw_feed;
+  sample_feed filtered_feed;
+  sample_feed window_feed;
+  broadcast_queue<jump_summary, CLIENT_JUMP_QUEUE_LENGTH, BLE_MAX_CLIENTS> jump_feed;
+  client slots[BLE_MAX_CLIENTS] = {};
+  uint8_t voltage[CLIENT_VOLTAGE_MAX];
+  uint8_t voltage_len = 0;
+  uint32_t stats_ms = 0;
+};
+
+extern client_fanout clients;
+
+// platform layer, src/ble.cpp on the board and native/ble_sim.cpp on the host.
+// sends one notification to a connection, false when its link has no room
+bool ble_hw_notify(uint16_t conn_id, notify_channel channel, const uint8_t *data, size_t len);
+
+#endif
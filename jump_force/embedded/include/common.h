@@ -5,12 +5,6 @@
 #include <Wire.h>
 #include "heltec.h"
 
-#include <sstream>
 #include <string>
-#include <map>
-
-extern std::ostringstream ss;
-
-void clear_ss();
 
 #endif
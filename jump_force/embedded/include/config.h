@@ -6,6 +6,79 @@
 #define MESSAGE_SEND_CHARACTERISTIC_UUID "48a18076-4864-417d-8b11-3a58cf411cd7"
 #define MESSAGE_RECEIVE_CHARACTERISTIC_UUID "0c6b9ea4-4994-4edc-a3cb-d6136eae264b"
 #define VOLTAGE_CHARACTERISTIC_UUID "d75909f9-dfa6-4994-a084-94354caa5eb2"
+#define STREAM_CHARACTERISTIC_UUID "b4373bac-a068-4f9e-a070-fd31cd08bec2"
+#define STREAM_STATS_CHARACTERISTIC_UUID "87409bde-5bac-4a6f-ba38-1bcbf31614b3"
+#define FILTER_CONFIG_CHARACTERISTIC_UUID "6532fc03-0804-48ef-a361-ec4f7316f01b"
+#define JUMP_CHARACTERISTIC_UUID "d59b0be1-2d01-415a-a72d-7fb8bbe5e24d"
+#define LOG_CHARACTERISTIC_UUID "287d01bb-4a44-428e-aa8d-8ab343fee368"
+#define RAW_STREAM_CHARACTERISTIC_UUID "8cf734c3-0d12-4550-be37-c3858405c041"
+#define SUBSCRIBE_CHARACTERISTIC_UUID "fdb60a40-38fe-4ad7-843e-28d72a156c76"
+#define TIME_SYNC_CHARACTERISTIC_UUID "5183224a-2bda-4bf4-b2ec-61c21575f9f1"
 #define BLUETOOTH_NAME "jump-force"
 
+// ATT MTU requested from the central, 247 fills one 251 byte LE data packet
+#define BLE_MTU 247
+// connections served at once, e.g. the athlete's phone and a coach's tablet.
+// bluedroid allows 4 by default
+#define BLE_MAX_CLIENTS 3
+
+// sampling: four flex sensors, the hall effect sensor and BNO055 acceleration
+#define SAMPLE_RATE_HZ 120
+#define SAMPLE_CHANNELS 8
+#define ANALOG_CHANNELS 5
+// {name, pin} of each ADC channel in record order. ADC1 pins only, ADC2 is
+// not usable while the radio is on
+#define ANALOG_CHANNEL_LIST \
+  {                         \
+    {"flex_0", 36},         \
+    {"flex_1", 38},         \
+    {"flex_2", 39},         \
+    {"flex_3", 32},         \
+    {"hall", 33},           \
+  }
+// index of the hall sensor in ANALOG_CHANNEL_LIST, the others are flex sensors
+#define HALL_CHANNEL 4
+// battery voltage divider, also on ADC1. the sampling task reads it every
+// VOLTAGE_READ_FRAMES frames so nothing else converts on ADC1 in between
+#define VOLTAGE_PIN 37
+#define VOLTAGE_READ_FRAMES SAMPLE_RATE_HZ
+// first of the three BNO055 acceleration channels after the analog ones
+#define ACCEL_CHANNEL ANALOG_CHANNELS
+
+// default filters: bandpass for the flex sensors, lowpass for the hall sensor
+#define FLEX_HIGHPASS_HZ 0.2
+#define FLEX_LOWPASS_HZ 8.0
+#define HALL_LOWPASS_HZ 5.0
+
+// jump detection on the filtered mean of the flex sensors, in ADC counts.
+// like the filters these need calibrating on the real kneepad
+// bend rate that starts a descend, above the highpass recovering after a jump
+#define JUMP_DESCEND_RATE 1200
+// bend below which a descend is only a twitch
+#define JUMP_MIN_BEND 200
+// extension rate that has to be reached on the way up
+#define JUMP_PUSH_RATE 1500
+// extension slower than this after the push means the feet left the ground
+#define JUMP_TAKEOFF_RATE 1000
+// bend rate on touchdown
+#define JUMP_LANDING_RATE 2000
+#define JUMP_MIN_FLIGHT_MS 100
+#define JUMP_MAX_FLIGHT_MS 1000
+// longest descend or push before the movement is not counted as a jump
+#define JUMP_MAX_PHASE_MS 2000
+// landing absorption kept after touchdown
+#define JUMP_LANDING_MS 300
+// frames before the descend included in a raw window
+#define JUMP_PRE_MS 250
+
+// feeds of a new connection until it writes the subscribe characteristic,
+// FEED_* from clients.h. FEED_FILTERED streams every filtered frame,
+// FEED_JUMPS only the windows around jumps
+#define CLIENT_DEFAULT_FEEDS (FEED_JUMPS | FEED_VOLTAGE)
+#define JUMP_RAW_WINDOWS 1
+
+// the sampling task runs on the core the BLE task is not pinned to
+#define SAMPLE_CORE 0
+#define SAMPLE_TASK_PRIORITY 5
+
 #endif
@@ -0,0 +1,15 @@
+#ifndef CPU_STATS
+#define CPU_STATS
+
+#define CPU_STATS_MAX_TASKS 24
+
+/**
+ * logs "cpu,<core>,idle,<percent>" per core then
+ * "task,<name>,<core>,<percent>,<stack free>" per task at info level,
+ * covering the time since the previous call. percentages are of one core.
+ * the numbers come from FreeRTOS run time stats; when the framework is
+ * built without them only "cpu,unavailable" is logged.
+ */
+void report_cpu_load();
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef FILTER_BANK
+#define FILTER_BANK
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "biquad.h"
+#include "config.h"
+#include "sampler.h"
+#include "spsc_queue.h"
+
+#define FILTER_STAGES 2
+// frames filtered together, 33 ms at 120 Hz
+#define FILTER_BLOCK 4
+#define FILTER_UPDATES 8
+
+// kernel used on the device, the ESP32 has a single precision FPU. see
+// tools/filter_bench for the Q15 / Q31 kernels
+typedef float filter_sample;
+
+// value written to the filter config characteristic
+struct __attribute__((packed)) filter_config
+{
+  uint8_t channel;
+  uint8_t stage;
+  biquad_coeffs coeffs;
+};
+
+/**
+ * per channel biquad cascades between the sampler and its consumer
+ *
+ * frames are collected into blocks of FILTER_BLOCK, each analog channel is
+ * filtered over the block and the filtered frames are passed on with their
+ * original timestamps. channels past ANALOG_CHANNELS are passed through.
+ */
+class filter_bank
+{
+public:
+  // loads the compile time defaults
+  void begin(frame_consumer out);
+  // sampler consumer
+  void push(const sample_record &frame);
+
+  // from one other task, e.g. the BLE config characteristic. applied before
+  // the next block, false for an unknown channel or stage or an unstable
+  // filter
+  bool configure(const filter_config &config);
+
+private:
+  void apply_updates();
+  void process_block();
+
+  frame_consumer out = nullptr;
+  biquad_cascade<filter_sample, FILTER_STAGES> filters[ANALOG_CHANNELS];
+  spsc_queue<filter_config, FILTER_UPDATES> updates;
+  sample_record block[FILTER_BLOCK];
+  filter_sample channel[FILTER_BLOCK];
+  size_t count = 0;
+  bool primed = false;
+};
+
+extern filter_bank filters;
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef JUMP_DETECTOR
+#define JUMP_DETECTOR
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config.h"
+#include "sampler.h"
+
+// frames kept for raw windows, 2.1 s at 120 Hz
+#define JUMP_HISTORY_FRAMES 256
+
+enum class jump_phase : uint8_t
+{
+  STANDING,
+  DESCEND,
+  ACCELERATE_UP,
+  FLIGHT,
+  LANDING
+};
+
+// value of the jump characteristic, one per completed jump
+struct __attribute__((packed)) jump_summary
+{
+  uint16_t sequence;
+  // timestamp of the frame that started the descend
+  uint32_t start_us;
+  uint16_t descend_ms;
+  uint16_t accelerate_ms;
+  uint16_t flight_ms;
+  // g t^2 / 8 from the flight time
+  uint16_t height_mm;
+  // filtered flex mean at the bottom of the descend, counts
+  int16_t max_bend;
+  // fastest bending while descending and extending on the way up, counts/s
+  int16_t descend_rate;
+  int16_t accelerate_rate;
+  // how far the knee bent absorbing the landing, from touchdown, counts
+  int16_t landing_bend;
+  // largest BNO055 acceleration magnitude during the jump, 0 without IMU data
+  uint16_t peak_accel;
+};
+
+struct jump_stats
+{
+  uint32_t frames;
+  uint32_t jumps;
+  // movements that started like a jump but had no flight
+  uint32_t aborted;
+  uint32_t window_frames;
+};
+
+typedef void (*jump_handler)(const jump_summary &summary);
+
+/**
+ * segments filtered frames into the phases of a vertical jump
+ *
+ * runs one frame at a time on the bend (mean of the flex channels) and its
+ * rate: standing -> descend once the knee bends faster than
+ * JUMP_DESCEND_RATE, -> accelerate up at the deepest bend, -> flight when
+ * the extension stops after the push, -> landing when the knee bends
+ * again, and back to standing JUMP_LANDING_MS after touchdown. only then
+ * is the summary handed out, followed by the frames from JUMP_PRE_MS before
+ * the descend when a window handler is set. a movement that leaves a phase
+ * the wrong way or takes too long is dropped.
+ */
+class jump_detector
+{
+public:
+  void begin(jump_handler on_jump, frame_consumer on_window_frame = nullptr);
+  void push(const sample_record &frame);
+
+  jump_phase phase() const
+  {
+    return current;
+  }
+
+  jump_stats stats() const
+  {
+    return counters;
+  }
+
+private:
+  void enter(jump_phase next, uint32_t t_us);
+  void abort();
+  void complete();
+  void emit_window();
+
+  jump_handler on_jump = nullptr;
+  frame_consumer on_window_frame = nullptr;
+
+  jump_phase current = jump_phase::STANDING;
+  uint32_t phase_start_us = 0;
+  bool has_previous = false;
+  float previous_bend = 0;
+  uint32_t previous_us = 0;
+
+  jump_summary summary = {};
+  float start_bend = 0;
+  float max_bend = 0;
+  float min_rate = 0;
+  float max_rate = 0;
+  float landing_bend = 0;
+  float touchdown_bend = 0;
+  uint32_t peak_accel = 0;
+  uint32_t takeoff_us = 0;
+  uint32_t touchdown_us = 0;
+  uint16_t sequence = 0;
+
+  sample_record history[JUMP_HISTORY_FRAMES];
+  size_t history_next = 0;
+  size_t history_count = 0;
+
+  jump_stats counters = {};
+};
+
+extern jump_detector jumps;
+
+#endif
@@ -1,8 +1,93 @@
 #ifndef logging
 #define logging
 
-#include "common.h"
+#include <stddef.h>
+#include <stdint.h>
 
-void log_message(const std::string &message);
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_OFF 4
+
+// calls below this level are compiled out, arguments included.
+// override with -D LOG_LEVEL=...
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// lines waiting for the drain task, must be a power of two. one stats
+// report is ~30 lines
+#define LOG_SLOTS 64
+// longer lines are truncated
+#define LOG_LINE_MAX 120
+// lines at or above this level are also sent to the log mirror
+#define LOG_MIRROR_LEVEL LOG_LEVEL_WARN
+
+struct log_entry
+{
+  uint32_t t_ms;
+  uint8_t level;
+  uint8_t len;
+  char text[LOG_LINE_MAX];
+};
+
+struct log_stats
+{
+  uint32_t written;
+  // lines lost because the ring was full
+  uint32_t dropped;
+  // lines written as their bare format because it had a float conversion
+  uint32_t rejected;
+};
+
+typedef void (*log_sink)(const log_entry &entry);
+
+/**
+ * formats into a slot of a preallocated ring and returns, the line is
+ * written out later by the drain task. safe from any task on either core,
+ * but not from interrupts. never blocks and never allocates. newlib's
+ * printf allocates for floats, so a format with %f, %e, %g or %a is not
+ * formatted: the line is the format itself and counts as rejected. format
+ * floats into a fixed_string and pass it as %s.
+ */
+void log_write(uint8_t level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// hands every queued line to sink, returns how many. single consumer
+size_t log_drain(log_sink sink);
+
+log_stats get_log_stats();
+
+const char *log_level_name(uint8_t level);
+
+// starts the drain task writing to Serial
+void setup_logging();
+// also hands lines at LOG_MIRROR_LEVEL and above to sink, e.g. a BLE
+// characteristic. may be called from any task, sink runs on the drain task
+void set_log_mirror(log_sink sink);
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) log_write(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) log_write(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(...) log_write(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) log_write(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
 
 #endif
@@ -0,0 +1,115 @@
+#ifndef SAMPLER
+#define SAMPLER
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "config.h"
+
+// frames kept before a slot is reused, a consumer may hold on to a frame
+// for this many periods
+#define SAMPLER_POOL_FRAMES 8
+#define SAMPLER_MAX_CONSUMERS 4
+
+struct __attribute__((packed)) sample_record
+{
+  // when the timer fired for this frame
+  uint32_t t_us;
+  int16_t values[SAMPLE_CHANNELS];
+};
+
+struct sampler_channel
+{
+  const char *name;
+  uint8_t pin;
+};
+
+struct sampler_stats
+{
+  uint32_t frames;
+  // timer periods without a frame because the sampling task was late
+  uint32_t missed;
+  // distance between timer ticks minus the period
+  uint32_t avg_jitter_us;
+  uint32_t max_jitter_us;
+  // timer tick to frame handed to the consumers
+  uint32_t max_latency_us;
+  uint32_t last_read_us;
+};
+
+// called on the sampling task with the frame in its pool slot
+typedef void (*frame_consumer)(const sample_record &frame);
+
+/**
+ * fixed rate sampler for the analog channels in ANALOG_CHANNEL_LIST
+ *
+ * a hardware timer calls tick() every period, which only stores the time
+ * and wakes the sampling task. the task calls sample() to read every
+ * channel into the next pool slot and passes it to the consumers by
+ * reference. values past ANALOG_CHANNELS are left 0. every
+ * VOLTAGE_READ_FRAMES frames it also reads VOLTAGE_PIN, which other tasks
+ * take from voltage() instead of reading ADC1 themselves.
+ */
+class adc_sampler
+{
+public:
+  bool begin(uint32_t rate_hz);
+  bool add_consumer(frame_consumer consumer);
+
+  // from the timer interrupt, inlined so it stays in the handler's IRAM
+  __attribute__((always_inline)) void tick(uint32_t t_us)
+  {
+    tick_us = t_us;
+    ticks++;
+  }
+
+  // reads the frame for the latest tick, false if there was none
+  bool sample();
+
+  uint32_t period_us() const
+  {
+    return period;
+  }
+
+  sampler_stats stats() const;
+
+  // latest raw reading of VOLTAGE_PIN, -1 before the first one
+  int16_t voltage() const
+  {
+    return voltage_raw.load(std::memory_order_relaxed);
+  }
+
+  static const sampler_channel channels[ANALOG_CHANNELS];
+
+private:
+  uint32_t period = 0;
+  volatile uint32_t tick_us = 0;
+  volatile uint32_t ticks = 0;
+  uint32_t handled = 0;
+  uint32_t previous_us = 0;
+
+  sample_record pool[SAMPLER_POOL_FRAMES];
+  size_t next = 0;
+  frame_consumer consumers[SAMPLER_MAX_CONSUMERS];
+  size_t consumer_count = 0;
+  std::atomic<int16_t> voltage_raw{-1};
+
+  uint32_t frames = 0;
+  uint32_t missed = 0;
+  uint64_t total_jitter_us = 0;
+  uint32_t max_jitter_us = 0;
+  uint32_t max_latency_us = 0;
+  uint32_t last_read_us = 0;
+};
+
+extern adc_sampler sampler;
+
+// platform layer, src/sampler_esp32.cpp on the board and
+// native/sampler_sim.cpp on the host
+bool sampler_hw_begin(adc_sampler &sampler);
+int16_t sampler_hw_read(uint8_t pin);
+uint32_t sampler_hw_micros();
+
+#endif
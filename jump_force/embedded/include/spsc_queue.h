@@ -0,0 +1,99 @@
+#ifndef SPSC_QUEUE
+#define SPSC_QUEUE
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * lock-free ring buffer for exactly one producer and one consumer task
+ *
+ * the producer only writes head and the consumer only writes tail, so the
+ * two sides never contend and neither blocks. indices run freely and wrap
+ * at 2^32, the capacity must be a power of two. a push into a full queue is
+ * refused and counted in overflows().
+ */
+template <typename T, size_t N>
+class spsc_queue
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+  // producer only
+  bool push(const T &item)
+  {
+    const uint32_t h = head.load(std::memory_order_relaxed);
+    const uint32_t used = h - tail.load(std::memory_order_acquire);
+    if (used >= N)
+    {
+      overflow_count.store(overflow_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    items[h & (N - 1)] = item;
+    head.store(h + 1, std::memory_order_release);
+    if (used + 1 > high_water_mark.load(std::memory_order_relaxed))
+    {
+      high_water_mark.store(used + 1, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  // consumer only
+  bool pop(T &item)
+  {
+    return pop(&item, 1) == 1;
+  }
+
+  // consumer only, moves up to max items into out, returns how many
+  size_t pop(T *out, size_t max)
+  {
+    const uint32_t t = tail.load(std::memory_order_relaxed);
+    const uint32_t available = head.load(std::memory_order_acquire) - t;
+    const size_t count = available < max ? available : max;
+    for (size_t i = 0; i < count; i++)
+    {
+      out[i] = items[(t + i) & (N - 1)];
+    }
+    tail.store(t + count, std::memory_order_release);
+    return count;
+  }
+
+  // consumer only, drops everything queued and returns how many
+  size_t clear()
+  {
+    const uint32_t t = tail.load(std::memory_order_relaxed);
+    const uint32_t h = head.load(std::memory_order_acquire);
+    tail.store(h, std::memory_order_release);
+    return h - t;
+  }
+
+  size_t size() const
+  {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  }
+
+  static constexpr size_t capacity()
+  {
+    return N;
+  }
+
+  uint32_t overflows() const
+  {
+    return overflow_count.load(std::memory_order_relaxed);
+  }
+
+  // most items ever queued at once
+  uint32_t high_water() const
+  {
+    return high_water_mark.load(std::memory_order_relaxed);
+  }
+
+private:
+  T items[N];
+  std::atomic<uint32_t> head{0};
+  std::atomic<uint32_t> tail{0};
+  std::atomic<uint32_t> overflow_count{0};
+  std::atomic<uint32_t> high_water_mark{0};
+};
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef STREAM
+#define STREAM
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "broadcast_queue.h"
+#include "config.h"
+#include "sampler.h"
+#include "time_sync.h"
+
+// samples buffered per feed between the sampling task and the slowest
+// client, ~4 s at 120 Hz so a whole jump window fits. must be a power of two
+#define STREAM_QUEUE_LENGTH 512
+// a client that has had more samples than this waiting for
+// STREAM_DECIMATE_MS is sent every second, then every fourth ... sample
+// until it catches up. a jump window arrives all at once, a client that
+// clears it quickly is not slow
+#define STREAM_DECIMATE_LAG 128
+#define STREAM_DECIMATE_MS 250
+#define STREAM_MAX_STRIDE 8
+// a client further behind skips its oldest samples, which leaves the
+// producer room for a whole jump window however slow the client is
+#define STREAM_MAX_LAG 256
+// largest ATT payload, MTU 517 less the 3 byte notification header
+#define STREAM_MAX_PAYLOAD 514
+// ATT MTU until the central asks for a larger one
+#define STREAM_DEFAULT_MTU 23
+// a partly filled packet is sent once its oldest sample is this old
+#define STREAM_FLUSH_MS 50
+// set in stream_header.channels when the t_us of the packet's records are
+// the low 32 bits of the phone's clock instead of the device's micros()
+#define STREAM_PHONE_TIME 0x80
+
+// start of every notification on the stream characteristics, followed by
+// count sample_records of channels values each
+struct __attribute__((packed)) stream_header
+{
+  // per client and characteristic, gaps mean lost notifications
+  uint16_t sequence;
+  uint8_t count;
+  // values per record, with STREAM_PHONE_TIME once the client synced
+  uint8_t channels;
+};
+
+// value of the stream stats characteristic, one per stream of a client
+struct __attribute__((packed)) stream_stats
+{
+  uint32_t samples_sent;
+  uint32_t packets_sent;
+  // samples this client skipped because it fell STREAM_MAX_LAG behind or
+  // its MTU was too small for one sample
+  uint32_t samples_dropped;
+  // samples the feed refused with its queue full, lost for every client
+  uint32_t queue_overflows;
+  uint32_t samples_per_s;
+  // sample time to notify, for the oldest sample of each packet
+  uint32_t avg_latency_us;
+  uint32_t max_latency_us;
+  uint16_t mtu;
+  uint16_t samples_per_packet;
+  // most samples ever waiting for this client
+  uint16_t queue_high_water;
+  // samples left out to keep up with a slow link
+  uint32_t samples_decimated;
+  // every stride-th sample is sent, 1 unless the client is behind
+  uint8_t stride;
+  // FEED_RAW, FEED_FILTERED or FEED_JUMPS for the jump windows
+  uint8_t feed;
+};
+
+typedef broadcast_queue<sample_record, STREAM_QUEUE_LENGTH, BLE_MAX_CLIENTS> sample_feed;
+
+// sends one notification to a connection, false when its link has no room
+typedef bool (*stream_send)(uint16_t conn_id, const uint8_t *data, size_t len);
+
+/**
+ * packs one client's samples from a feed into as few notifications as its
+ * MTU allows
+ *
+ * runs on the BLE task only. poll() moves the samples waiting for the
+ * client's reader straight into the current packet and sends it when it is
+ * full or its oldest sample is STREAM_FLUSH_MS old. a packet the link
+ * refuses is kept and retried on the next poll, samples wait in the feed
+ * meanwhile. a client that keeps falling behind is decimated and finally
+ * skipped ahead, so it never holds up the sampling task or other clients.
+ * once the client's clock is synced the records are stamped in its time
+ * base as they are packed.
+ */
+class sample_stream
+{
+public:
+  // starts over for a reader of a feed on a connection, keeping the MTU.
+  // clock is the connection's, null to keep device timestamps
+  void open(uint8_t reader, uint16_t conn_id, uint8_t feed, stream_send send, const time_sync *clock);
+  // returns the packets sent
+  size_t poll(sample_feed &source);
+  // drops the partial packet, e.g. before switching feeds
+  void discard();
+
+  // the ATT MTU of the connection, payloads are 3 bytes smaller. it is
+  // applied before the next packet
+  void set_mtu(uint16_t mtu);
+
+  uint16_t samples_per_packet() const
+  {
+    return per_packet;
+  }
+
+  // samples_per_s covers the time since the previous call
+  stream_stats stats(const sample_feed &source, uint32_t now_ms);
+
+private:
+  void apply_mtu();
+  bool send_packet();
+  void adapt_stride(size_t waiting, uint32_t now_ms);
+  void stamp(sample_record *records, size_t count);
+
+  uint8_t reader = 0;
+  uint16_t conn_id = 0;
+  uint8_t feed = 0;
+  stream_send send = nullptr;
+  const time_sync *clock = nullptr;
+
+  uint8_t packet[STREAM_MAX_PAYLOAD];
+  uint16_t per_packet = 0;
+  uint16_t mtu = STREAM_DEFAULT_MTU;
+  uint8_t pending = 0;
+  // device time of the oldest pending record, and whether the packet is in
+  // phone time. decided by its first record, so a packet is never mixed
+  uint32_t first_us = 0;
+  bool phone_time = false;
+  uint16_t sequence = 0;
+  uint8_t stride = 1;
+  uint8_t until_kept = 0;
+  bool behind = false;
+  uint32_t behind_ms = 0;
+
+  uint32_t dropped = 0;
+  uint32_t decimated = 0;
+  uint32_t samples_sent = 0;
+  uint32_t packets_sent = 0;
+  uint64_t total_latency_us = 0;
+  uint32_t max_latency_us = 0;
+  uint16_t high_water = 0;
+  uint32_t rate_samples = 0;
+  uint32_t rate_ms = 0;
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef TIME_SYNC
+#define TIME_SYNC
+
+#include <stddef.h>
+#include <stdint.h>
+
+// exchanges per point of the fitted line, the shortest trip each way out of
+// that many is the one least delayed by connection events and the phone's OS
+#define TIME_SYNC_GROUP 32
+// points the line is fitted to, ~50 s with a ping every 100 ms
+#define TIME_SYNC_POINTS 16
+// most the two crystals drift apart, assumed until there are two points
+#define TIME_SYNC_MAX_DRIFT_PPM 100
+
+// written by the phone to the time sync characteristic
+struct __attribute__((packed)) time_sync_ping
+{
+  uint16_t sequence;
+  // phone clock in us when the ping was written
+  uint64_t phone_us;
+  // the last reply the phone received and its phone clock on arrival, which
+  // completes that exchange. reply_phone_us is 0 before the first reply
+  uint16_t reply_sequence;
+  uint64_t reply_phone_us;
+};
+
+// notified back on the time sync characteristic for every ping. like the
+// ping it fits the 20 bytes of the default MTU
+struct __attribute__((packed)) time_sync_reply
+{
+  // of the ping answered
+  uint16_t sequence;
+  // the device's estimate of the phone clock when the reply was sent, 0
+  // until the first exchange completed
+  uint64_t phone_us;
+  // how much faster the phone's clock runs, parts per billion
+  int32_t drift_ppb;
+  // bound on the error of phone_us and of the sample stamps right now,
+  // UINT32_MAX until synced
+  uint32_t error_us;
+  // exchanges in the estimate
+  uint16_t exchanges;
+};
+
+/**
+ * estimates one phone's clock from the device's, NTP style
+ *
+ * an exchange is a ping written at phone time t1 and received at device
+ * time t2, and a reply sent at device time t3 and received at phone time t4.
+ * no trip takes negative time, so the phone's lead over the device is at
+ * least t1 - t2 and at most t4 - t3. a BLE trip waits for a connection
+ * event, so the two tend to be milliseconds apart, but the shortest trip
+ * each way within a group of TIME_SYNC_GROUP exchanges pins the lead down
+ * to well below that. each group is kept as the middle of that range, and
+ * a line through the last TIME_SYNC_POINTS of them gives offset and drift.
+ * the ranges give the error bound.
+ *
+ * device times are 32 bit micros() and may wrap, the points have to stay
+ * well below 35 minutes apart
+ */
+class time_sync
+{
+public:
+  void reset();
+  void add(uint64_t t1, uint32_t t2, uint32_t t3, uint64_t t4);
+
+  bool synced() const
+  {
+    return points_used > 0 || in_group > 0;
+  }
+
+  // exchanges in the estimate
+  size_t exchanges() const
+  {
+    return points_used * TIME_SYNC_GROUP + in_group;
+  }
+
+  // phone clock at a device timestamp, device_us itself until synced
+  uint64_t to_phone(uint32_t device_us) const;
+  // bound on the error of to_phone(device_us)
+  uint32_t error_us(uint32_t device_us) const;
+
+  int32_t drift_ppb() const
+  {
+    return static_cast<int32_t>(drift * 1e9);
+  }
+
+private:
+  struct exchange
+  {
+    uint64_t t1;
+    uint32_t t2;
+    uint32_t t3;
+    uint64_t t4;
+  };
+
+  // phone time at a device time, and how far off it may be
+  struct point
+  {
+    uint32_t device_us;
+    uint64_t phone_us;
+    uint32_t half_range_us;
+  };
+
+  point close_group() const;
+  void fit();
+
+  exchange group[TIME_SYNC_GROUP];
+  size_t in_group = 0;
+  point points[TIME_SYNC_POINTS];
+  size_t next_point = 0;
+  size_t points_used = 0;
+
+  // phone = ref_phone_us + x + offset + drift x, x = device - ref_device_us
+  uint32_t ref_device_us = 0;
+  uint64_t ref_phone_us = 0;
+  double offset = 0;
+  double drift = 0;
+  // device time of the oldest point fitted, relative to ref_device_us
+  double oldest_x = 0;
+  // largest distance of the fitted line from the truth at the points fitted
+  double fit_error_us = 0;
+  // how wrong drift may be
+  double drift_error = TIME_SYNC_MAX_DRIFT_PPM * 1e-6;
+};
+
+#endif
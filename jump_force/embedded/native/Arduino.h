@@ -0,0 +1,16 @@
+#ifndef ARDUINO_NATIVE
+#define ARDUINO_NATIVE
+
+/**
+ * the few Arduino calls the sampling pipeline uses, time comes from the
+ * virtual clock in sim.h
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+unsigned long millis();
+unsigned long micros();
+
+#endif
@@ -0,0 +1,121 @@
+#include "clients.h"
+#include "sim.h"
+
+/**
+ * stand-in for the BLE stack: each link's controller holds up to
+ * SIM_BLE_BUFFERS notifications and sends per_event of them every
+ * connection interval. a notification is refused while the buffers are
+ * full, like esp_ble_get_cur_sendable_packets_num() returning 0, and
+ * handed to sim_ble_received() once accepted, with the connection event
+ * its place in the buffers puts it in
+ */
+#define SIM_BLE_BUFFERS 8
+#define SIM_BLE_LINKS 8
+
+struct sim_link
+{
+  bool used;
+  uint16_t conn_id;
+  uint16_t mtu;
+  uint32_t interval_us;
+  uint8_t per_event;
+  uint8_t queued;
+  uint64_t next_event_us;
+  sim_link_stats stats;
+};
+
+static sim_link links[SIM_BLE_LINKS];
+
+static sim_link *find_link(uint16_t conn_id)
+{
+  for (sim_link &link : links)
+  {
+    if (link.used && link.conn_id == conn_id)
+    {
+      return &link;
+    }
+  }
+  return nullptr;
+}
+
+bool sim_ble_link(uint16_t conn_id, uint16_t mtu, uint32_t interval_us, uint8_t per_event)
+{
+  sim_link *link = find_link(conn_id);
+  for (size_t i = 0; i < SIM_BLE_LINKS && !link; i++)
+  {
+    link = links[i].used ? nullptr : &links[i];
+  }
+  if (!link)
+  {
+    return false;
+  }
+  *link = sim_link();
+  link->used = true;
+  link->conn_id = conn_id;
+  link->mtu = mtu;
+  link->interval_us = interval_us;
+  link->per_event = per_event;
+  link->next_event_us = sim_now_us + interval_us;
+  return true;
+}
+
+void sim_ble_unlink(uint16_t conn_id)
+{
+  sim_link *link = find_link(conn_id);
+  if (link)
+  {
+    link->used = false;
+  }
+}
+
+sim_link_stats sim_ble_stats(uint16_t conn_id)
+{
+  sim_link *link = find_link(conn_id);
+  return link ? link->stats : sim_link_stats();
+}
+
+uint64_t sim_ble_next_event(uint16_t conn_id, uint64_t at_us)
+{
+  sim_link *link = find_link(conn_id);
+  if (!link)
+  {
+    return at_us;
+  }
+  if (at_us <= link->next_event_us)
+  {
+    return link->next_event_us;
+  }
+  const uint64_t events = (at_us - link->next_event_us + link->interval_us - 1) / link->interval_us;
+  return link->next_event_us + events * link->interval_us;
+}
+
+bool ble_hw_notify(uint16_t conn_id, notify_channel channel, const uint8_t *data, size_t len)
+{
+  sim_link *link = find_link(conn_id);
+  if (!link)
+  {
+    return false;
+  }
+  if (sim_now_us >= link->next_event_us)
+  {
+    const uint64_t events = (sim_now_us - link->next_event_us) / link->interval_us + 1;
+    const uint64_t sent = events * link->per_event;
+    link->queued = sent >= link->queued ? 0 : link->queued - sent;
+    link->next_event_us += events * link->interval_us;
+  }
+  if (link->queued >= SIM_BLE_BUFFERS)
+  {
+    link->stats.refused++;
+    return false;
+  }
+  // the real stack would cut the value to the MTU
+  if (len + 3 > link->mtu)
+  {
+    link->stats.oversized++;
+  }
+  const uint64_t delivered_us = link->next_event_us + link->queued / link->per_event * link->interval_us;
+  link->queued++;
+  link->stats.notifications++;
+  sim_ble_received(conn_id, channel, data, len, delivered_us);
+  return true;
+}
@@ -0,0 +1,108 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "Arduino.h"
+#include "sampler.h"
+#include "sim.h"
+
+/**
+ * synthetic kneepad signals: a squat jump every JUMP_PERIOD_S, where every
+ * SQUAT_EVERY th one is a squat that never leaves the ground. the flex
+ * sensors follow the knee angle with a different gain each, the hall
+ * sensor follows the kneecap and both carry ADC noise
+ */
+#define JUMP_PERIOD_S 3.0
+#define SQUAT_EVERY 4
+#define ADC_MAX 4095
+#define ADC_NOISE 8
+// a conversion, so reads take virtual time
+#define ADC_READ_US 12
+// battery through the divider, 3.7 V in the voltage job's scale
+#define BATTERY_RAW 1480
+
+uint64_t sim_now_us = 0;
+
+unsigned long millis()
+{
+  return sim_now_us / 1000;
+}
+
+unsigned long micros()
+{
+  return sim_now_us;
+}
+
+// knee bend in 0..1 over one jump: stand, descend, push up, flight, land
+static double knee_bend(double t)
+{
+  const double phase = fmod(t, JUMP_PERIOD_S);
+  const bool squat = static_cast<long>(t / JUMP_PERIOD_S) % SQUAT_EVERY == SQUAT_EVERY - 1;
+  if (phase < 1.0)
+  {
+    return 0;
+  }
+  if (squat)
+  {
+    // down and slowly back up
+    return phase < 1.6 ? 0.5 - 0.5 * cos((phase - 1.0) / 0.6 * M_PI) : phase < 2.6 ? 0.5 + 0.5 * cos((phase - 1.6) * M_PI)
+                                                                                  : 0;
+  }
+  if (phase < 1.6)
+  {
+    return 0.5 - 0.5 * cos((phase - 1.0) / 0.6 * M_PI);
+  }
+  if (phase < 1.9)
+  {
+    return 0.5 + 0.5 * cos((phase - 1.6) / 0.3 * M_PI);
+  }
+  // 400 ms of flight, a 196 mm jump
+  if (phase < 2.3)
+  {
+    return 0;
+  }
+  if (phase < 2.6)
+  {
+    // landing absorbs with a shallower bend
+    return 0.3 * sin((phase - 2.3) / 0.3 * M_PI);
+  }
+  return 0;
+}
+
+bool sampler_hw_begin(adc_sampler &)
+{
+  return true;
+}
+
+int16_t sampler_hw_read(uint8_t pin)
+{
+  const double bend = knee_bend(sim_now_us / 1e6);
+  sim_now_us += ADC_READ_US;
+  if (pin == VOLTAGE_PIN)
+  {
+    return BATTERY_RAW + rand() % (2 * ADC_NOISE + 1) - ADC_NOISE;
+  }
+
+  uint8_t index = 0;
+  while (index < ANALOG_CHANNELS - 1 && adc_sampler::channels[index].pin != pin)
+  {
+    index++;
+  }
+  double value;
+  if (strncmp(adc_sampler::channels[index].name, "hall", 4) == 0)
+  {
+    // moves opposite to the bend around mid scale
+    value = 2048 - 900 * bend;
+  }
+  else
+  {
+    value = 600 + (1800 - index * 150) * bend;
+  }
+  value += rand() % (2 * ADC_NOISE + 1) - ADC_NOISE;
+  return value < 0 ? 0 : value > ADC_MAX ? ADC_MAX
+                                          : static_cast<int16_t>(value);
+}
+
+uint32_t sampler_hw_micros()
+{
+  return sim_now_us;
+}
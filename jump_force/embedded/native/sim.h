@@ -0,0 +1,34 @@
+#ifndef SIM
+#define SIM
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clients.h"
+
+// virtual time of the simulation, only moves when the sim advances it
+extern uint64_t sim_now_us;
+
+struct sim_link_stats
+{
+  uint32_t notifications;
+  // refused with the link's buffers full
+  uint32_t refused;
+  // longer than the MTU allows
+  uint32_t oversized;
+};
+
+// BLE stack stand-in, native/ble_sim.cpp. a link delivers per_event
+// notifications every interval_us
+bool sim_ble_link(uint16_t conn_id, uint16_t mtu, uint32_t interval_us, uint8_t per_event);
+void sim_ble_unlink(uint16_t conn_id);
+sim_link_stats sim_ble_stats(uint16_t conn_id);
+// first connection event of the link at or after at_us, when a write the
+// central queued at at_us reaches the device
+uint64_t sim_ble_next_event(uint16_t conn_id, uint64_t at_us);
+// implemented by the simulation, every notification the stand-in accepted
+// and the connection event that delivers it
+void sim_ble_received(uint16_t conn_id, notify_channel channel, const uint8_t *data, size_t len,
+                      uint64_t delivered_us);
+
+#endif
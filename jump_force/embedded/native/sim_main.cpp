@@ -0,0 +1,618 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "clients.h"
+#include "filter_bank.h"
+#include "jump_detector.h"
+#include "logger.h"
+#include "sampler.h"
+#include "sim.h"
+#include "stream.h"
+#include "time_sync.h"
+
+/**
+ * runs the sampler -> clients pipeline on virtual time against the BLE
+ * stand-in and decodes every notification the way the app would
+ *
+ *   program [--seconds 10] [--jitter-us 0] [--mtu 247] [--stall-every 0]
+ *           [--raw] [--continuous] [--clients 1] [--slow-ms 0] [--csv]
+ *           [--sync-ms 100] [--skew-ppm 40] [--os-jitter-us 1500]
+ *           [--settle-s 20] [--max-error-us 1000]
+ *
+ * --jitter-us delays each timer tick by up to that much, --stall-every makes
+ * the sampling task miss every nth tick. client 0 is the athlete's phone on
+ * a fast link with CLIENT_DEFAULT_FEEDS, so only the windows around
+ * detected jumps are streamed like on the device. --raw adds the raw feed
+ * and --continuous every filtered frame. the other --clients subscribe to
+ * every feed, with --slow-ms they only get one notification per that many
+ * ms. with --csv client 0's decoded stream (raw with --raw) is written to
+ * stdout, the summary always goes to stderr.
+ *
+ * every client's phone has its own clock, skew-ppm fast or slow, and pings
+ * the time sync characteristic about every --sync-ms once it has the reply
+ * to its last ping (0 turns sync off).
+ * each ping and reply waits for a connection event and up to
+ * --os-jitter-us in the phone's OS. every sample stamped in phone time is
+ * checked against the true phone time of its frame, and after --settle-s
+ * the stamps of clients on a fast link have to be within --max-error-us.
+ * a stamp is matched to the frame nearest to the time it claims, so errors
+ * beyond half a sample period, seen on slow links, are not exact.
+ */
+
+// the BLE task's clients job
+#define POLL_US 10100
+#define STATS_US 1000000
+#define VOLTAGE_US 2000000
+// phone link: 7.5 ms connection interval, a few packets per event
+#define FAST_INTERVAL_US 7500
+#define FAST_PER_EVENT 4
+// after the last sample, time the clients get to catch up
+#define DRAIN_US 60000000
+// phone clocks start around this unix time in us, a little apart per client
+#define PHONE_EPOCH_US 1700000000000000ULL
+// device stack, from the connection event to the write callback
+#define DEVICE_STACK_US 200
+// a phone waits this long for a reply before it pings again anyway
+#define PING_TIMEOUT_US 2000000
+
+struct decoder
+{
+  uint32_t packets;
+  uint32_t decoded;
+  uint32_t sequence_gaps;
+  uint32_t bad_packets;
+  uint16_t expected_sequence;
+};
+
+struct sim_client
+{
+  uint8_t feeds;
+  decoder raw;
+  decoder stream;
+  uint32_t jumps;
+  uint32_t voltages;
+  uint32_t stats;
+  uint32_t bad_values;
+
+  // phone clock, phone_epoch_us at sim time 0 running skew fast
+  uint64_t phone_epoch_us;
+  double skew;
+  bool fast_link;
+  // next ping in sim time, and the one on its way to the device
+  uint64_t next_ping_us;
+  uint64_t last_ping_us;
+  uint32_t pings;
+  bool ping_in_flight;
+  uint64_t ping_arrival_us;
+  time_sync_ping ping;
+  // latest reply and when the app had it, in sim time
+  uint32_t replies;
+  bool has_reply;
+  uint64_t reply_seen_us;
+  time_sync_reply reply;
+  // stamps checked after the settle time, against the true phone time
+  uint32_t stamped;
+  uint64_t total_error_us;
+  uint32_t max_error_us;
+  // stamps further off than the error bound of the latest reply
+  uint32_t beyond_bound;
+};
+
+static sim_client sim_clients[BLE_MAX_CLIENTS];
+static size_t client_count = 1;
+static bool csv = false;
+static bool raw = false;
+static uint32_t sync_us = 100000;
+static uint32_t os_jitter_us = 1500;
+static uint64_t settle_us = 20000000;
+// device times of every frame sampled, to find the frame behind a stamp
+static std::vector<uint32_t> frame_times;
+
+static uint64_t phone_clock(const sim_client &c, uint64_t sim_us)
+{
+  return c.phone_epoch_us + sim_us + llround(sim_us * c.skew);
+}
+
+static uint32_t os_delay()
+{
+  return os_jitter_us > 0 ? rand() % (os_jitter_us + 1) : 0;
+}
+
+// a record stamped in phone time, delivered to the phone at delivered_us
+static void check_stamp(sim_client &c, uint32_t stamp, uint64_t delivered_us)
+{
+  // how long before delivery the phone says the sample was taken, which
+  // finds the frame as long as the stamp is off by less than half a period
+  const int32_t age = static_cast<uint32_t>(phone_clock(c, delivered_us)) - stamp;
+  const double device_us = delivered_us - age / (1 + c.skew);
+  auto after = std::lower_bound(frame_times.begin(), frame_times.end(), static_cast<uint32_t>(device_us));
+  if (after == frame_times.end() || (after != frame_times.begin() && device_us - *(after - 1) < *after - device_us))
+  {
+    after--;
+  }
+  if (*after < settle_us)
+  {
+    return;
+  }
+  const int32_t error = stamp - static_cast<uint32_t>(phone_clock(c, *after));
+  const uint32_t error_us = error < 0 ? -error : error;
+  c.stamped++;
+  c.total_error_us += error_us;
+  c.max_error_us = error_us > c.max_error_us ? error_us : c.max_error_us;
+  c.beyond_bound += error_us > c.reply.error_us;
+}
+
+static void decode_packet(sim_client &c, decoder &d, const uint8_t *data, size_t len, uint64_t delivered_us,
+                          bool print)
+{
+  stream_header header;
+  memcpy(&header, data, sizeof(header));
+  const bool phone_time = header.channels & STREAM_PHONE_TIME;
+  if (len < sizeof(header) || (header.channels & ~STREAM_PHONE_TIME) != SAMPLE_CHANNELS ||
+      len != sizeof(header) + header.count * sizeof(sample_record))
+  {
+    d.bad_packets++;
+    return;
+  }
+  if (d.packets > 0 && header.sequence != d.expected_sequence)
+  {
+    d.sequence_gaps++;
+  }
+  d.expected_sequence = header.sequence + 1;
+  d.packets++;
+
+  for (uint8_t i = 0; i < header.count; i++)
+  {
+    sample_record record;
+    memcpy(&record, data + sizeof(header) + i * sizeof(record), sizeof(record));
+    d.decoded++;
+    if (phone_time)
+    {
+      check_stamp(c, record.t_us, delivered_us);
+    }
+    if (!print)
+    {
+      continue;
+    }
+    printf("%u", static_cast<unsigned>(record.t_us));
+    for (uint8_t c = 0; c < SAMPLE_CHANNELS; c++)
+    {
+      printf(",%d", record.values[c]);
+    }
+    printf("\n");
+  }
+}
+
+void sim_ble_received(uint16_t conn_id, notify_channel channel, const uint8_t *data, size_t len,
+                      uint64_t delivered_us)
+{
+  sim_client &c = sim_clients[conn_id];
+  switch (channel)
+  {
+  case notify_channel::RAW_STREAM:
+    decode_packet(c, c.raw, data, len, delivered_us, csv && raw && conn_id == 0);
+    break;
+  case notify_channel::FILTERED_STREAM:
+    decode_packet(c, c.stream, data, len, delivered_us, csv && !raw && conn_id == 0);
+    break;
+  case notify_channel::JUMP:
+    c.jumps++;
+    c.bad_values += len != sizeof(jump_summary);
+    break;
+  case notify_channel::VOLTAGE:
+  {
+    c.voltages++;
+    // the sampler's battery reading, 3.7 V in mV
+    char text[8] = {};
+    memcpy(text, data, len < sizeof(text) - 1 ? len : sizeof(text) - 1);
+    const unsigned long mv = strtoul(text, nullptr, 10);
+    c.bad_values += mv < 3600 || mv > 3800;
+    break;
+  }
+  case notify_channel::STREAM_STATS:
+    c.stats++;
+    c.bad_values += len != sizeof(stream_stats);
+    break;
+  case notify_channel::SYNC_REPLY:
+    if (len != sizeof(time_sync_reply))
+    {
+      c.bad_values++;
+      break;
+    }
+    memcpy(&c.reply, data, len);
+    c.replies++;
+    c.has_reply = true;
+    c.reply_seen_us = delivered_us + os_delay();
+    break;
+  }
+}
+
+// the phones' pings up to until_us in time order. a ping is written at a
+// random point of its period after the reply to the previous one arrived,
+// reaches the device with the first connection event after the phone's OS
+// passed it on and carries the arrival of that reply
+static void run_phones(uint64_t until_us)
+{
+  for (;;)
+  {
+    sim_client *next = nullptr;
+    uint64_t next_us = until_us + 1;
+    for (size_t i = 0; i < client_count && sync_us > 0; i++)
+    {
+      sim_client &c = sim_clients[i];
+      uint64_t at_us = c.ping_in_flight ? c.ping_arrival_us : c.next_ping_us;
+      if (!c.ping_in_flight && c.pings > 0)
+      {
+        const bool answered = c.has_reply && c.reply.sequence == c.ping.sequence;
+        const uint64_t wait_us = answered ? c.reply_seen_us : c.last_ping_us + PING_TIMEOUT_US;
+        at_us = at_us > wait_us ? at_us : wait_us;
+      }
+      if (at_us < next_us)
+      {
+        next = &c;
+        next_us = at_us;
+      }
+    }
+    if (!next)
+    {
+      return;
+    }
+    sim_client &c = *next;
+    const uint16_t conn_id = next - sim_clients;
+    if (!c.ping_in_flight)
+    {
+      c.ping.sequence = c.pings++;
+      c.ping.phone_us = phone_clock(c, next_us);
+      const bool seen = c.has_reply && c.reply_seen_us <= next_us;
+      c.ping.reply_sequence = seen ? c.reply.sequence : 0;
+      c.ping.reply_phone_us = seen ? phone_clock(c, c.reply_seen_us) : 0;
+      c.ping_arrival_us = sim_ble_next_event(conn_id, next_us + os_delay()) + DEVICE_STACK_US;
+      c.ping_in_flight = true;
+      c.last_ping_us = next_us;
+      c.next_ping_us = next_us + sync_us / 2 + rand() % sync_us;
+      continue;
+    }
+    if (sim_now_us < next_us)
+    {
+      sim_now_us = next_us;
+    }
+    clients.time_ping(conn_id, c.ping, sim_now_us);
+    c.ping_in_flight = false;
+  }
+}
+
+static void print_log(const log_entry &entry)
+{
+  fprintf(stderr, "log,%u,%s,%.*s\n", static_cast<unsigned>(entry.t_ms), log_level_name(entry.level), entry.len,
+          entry.text);
+}
+
+// frames offered to each feed, what every subscribed client should account for
+static uint32_t raw_pushed = 0;
+static uint32_t filtered_pushed = 0;
+static uint32_t window_pushed = 0;
+
+static void raw_frame(const sample_record &frame)
+{
+  raw_pushed++;
+  frame_times.push_back(frame.t_us);
+  clients.push_raw(frame);
+}
+
+static void window_frame(const sample_record &frame)
+{
+  window_pushed++;
+  clients.push_window(frame);
+}
+
+static void filter_frame(const sample_record &frame)
+{
+  filters.push(frame);
+}
+
+static void filtered_frame(const sample_record &frame)
+{
+  filtered_pushed++;
+  jumps.push(frame);
+  clients.push_filtered(frame);
+}
+
+static void jump_done(const jump_summary &s)
+{
+  clients.push_jump(s);
+  fprintf(stderr, "jump,%u,%u,%u,%u,%u,%u,%d,%d,%d,%d,%u\n", s.sequence, static_cast<unsigned>(s.start_us),
+          s.descend_ms, s.accelerate_ms, s.flight_ms, s.height_mm, s.max_bend, s.descend_rate, s.accelerate_rate,
+          s.landing_bend, s.peak_accel);
+}
+
+static uint32_t voltages_sent = 0;
+static uint64_t next_poll = POLL_US;
+static uint64_t next_stats = STATS_US;
+static uint64_t next_voltage = VOLTAGE_US;
+
+// the BLE task's jobs that are due up to until_us, without the periodic
+// status while draining
+static void run_ble_task(uint64_t until_us, bool status = true)
+{
+  while (next_poll <= until_us)
+  {
+    run_phones(next_poll);
+    if (sim_now_us < next_poll)
+    {
+      sim_now_us = next_poll;
+    }
+    clients.poll();
+    if (status && next_poll >= next_stats)
+    {
+      clients.send_stats(sim_now_us / 1000);
+      next_stats += STATS_US;
+    }
+    // like voltage_control_loop(), from the sampler's latest reading
+    if (status && next_poll >= next_voltage && sampler.voltage() >= 0)
+    {
+      char voltage[8];
+      const int len = snprintf(voltage, sizeof(voltage), "%u", static_cast<unsigned>(sampler.voltage() * 2.5));
+      clients.send_voltage(reinterpret_cast<const uint8_t *>(voltage), len);
+      voltages_sent++;
+      next_voltage += VOLTAGE_US;
+    }
+    log_drain(print_log);
+    next_poll += POLL_US;
+  }
+}
+
+// samples of a stream not yet accounted for by its client
+static uint32_t unaccounted(size_t slot, uint8_t feed, uint32_t pushed, const decoder &d, stream_stats &stats)
+{
+  if (!clients.stream_stats_of(slot, feed, sim_now_us / 1000, stats))
+  {
+    return 0;
+  }
+  const uint32_t accounted = d.decoded + stats.samples_dropped + stats.samples_decimated + stats.queue_overflows;
+  return pushed > accounted ? pushed - accounted : 0;
+}
+
+static bool drained(size_t client_count)
+{
+  for (size_t i = 0; i < client_count; i++)
+  {
+    stream_stats stats;
+    if (unaccounted(i, FEED_RAW, raw_pushed, sim_clients[i].raw, stats) > 0 ||
+        unaccounted(i, FEED_FILTERED, filtered_pushed, sim_clients[i].stream, stats) > 0 ||
+        unaccounted(i, FEED_JUMPS, window_pushed, sim_clients[i].stream, stats) > 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static const char *feed_name(uint8_t feed)
+{
+  return feed == FEED_RAW ? "raw" : feed == FEED_FILTERED ? "filtered"
+                                                          : "windows";
+}
+
+// prints one stream of a client and returns whether every sample is accounted for
+static bool report_stream(size_t slot, uint8_t feed, uint32_t pushed, const decoder &d)
+{
+  stream_stats stats;
+  if (!clients.stream_stats_of(slot, feed, sim_now_us / 1000, stats))
+  {
+    return true;
+  }
+  const uint32_t accounted = d.decoded + stats.samples_dropped + stats.samples_decimated + stats.queue_overflows;
+  fprintf(stderr, "stream,%u,%s,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", static_cast<unsigned>(slot), feed_name(feed),
+          pushed, d.packets, d.decoded, stats.samples_dropped, stats.samples_decimated, stats.queue_overflows,
+          d.sequence_gaps, d.bad_packets, stats.avg_latency_us, stats.queue_high_water, stats.stride);
+  return accounted == pushed && d.decoded == stats.samples_sent && d.sequence_gaps == 0 && d.bad_packets == 0;
+}
+
+int main(int argc, char **argv)
+{
+  double seconds = 10;
+  uint32_t jitter_us = 0;
+  uint16_t mtu = BLE_MTU;
+  uint32_t stall_every = 0;
+  bool continuous = false;
+  uint32_t slow_ms = 0;
+  double skew_ppm = 40;
+  uint32_t max_error_us = 1000;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--csv") == 0)
+    {
+      csv = true;
+    }
+    else if (strcmp(argv[i], "--raw") == 0)
+    {
+      raw = true;
+    }
+    else if (strcmp(argv[i], "--continuous") == 0)
+    {
+      continuous = true;
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "--seconds") == 0)
+    {
+      seconds = atof(argv[++i]);
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "--jitter-us") == 0)
+    {
+      jitter_us = atoi(argv[++i]);
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "--mtu") == 0)
+    {
+      mtu = atoi(argv[++i]);
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "--stall-every") == 0)
+    {
+      stall_every = atoi(argv[++i]);
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "--clients") == 0)
+    {
+      client_count = atoi(argv[++i]);
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "--slow-ms") == 0)
+    {
+      slow_ms = atoi(argv[++i]);
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "--sync-ms") == 0)
+    {
+      sync_us = atoi(argv[++i]) * 1000;
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "--skew-ppm") == 0)
+    {
+      skew_ppm = atof(argv[++i]);
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "--os-jitter-us") == 0)
+    {
+      os_jitter_us = atoi(argv[++i]);
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "--settle-s") == 0)
+    {
+      settle_us = atof(argv[++i]) * 1e6;
+    }
+    else if (i + 1 < argc && strcmp(argv[i], "--max-error-us") == 0)
+    {
+      max_error_us = atoi(argv[++i]);
+    }
+    else
+    {
+      fprintf(stderr, "unknown argument %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (client_count < 1 || client_count > BLE_MAX_CLIENTS)
+  {
+    fprintf(stderr, "--clients must be 1 to %d\n", BLE_MAX_CLIENTS);
+    return 1;
+  }
+
+  if (csv)
+  {
+    printf("t_us");
+    for (uint8_t c = 0; c < SAMPLE_CHANNELS; c++)
+    {
+      printf(",%s", c < ANALOG_CHANNELS ? adc_sampler::channels[c].name : "unused");
+    }
+    printf("\n");
+  }
+
+  // connection ids double as slots, the clients connect in order
+  for (size_t i = 0; i < client_count; i++)
+  {
+    sim_client &c = sim_clients[i];
+    c.feeds = CLIENT_DEFAULT_FEEDS | (raw ? FEED_RAW : 0) | (continuous ? FEED_FILTERED : 0);
+    if (i > 0)
+    {
+      c.feeds = FEED_ALL;
+    }
+    const bool slow = i > 0 && slow_ms > 0;
+    // phones alternately fast and slow, none agreeing with the device
+    c.phone_epoch_us = PHONE_EPOCH_US + i * 123456789ULL;
+    c.skew = (i % 2 ? -skew_ppm : skew_ppm) * 1e-6;
+    c.fast_link = !slow;
+    c.next_ping_us = rand() % (sync_us + 1);
+    sim_ble_link(i, mtu, slow ? slow_ms * 1000 : FAST_INTERVAL_US, slow ? 1 : FAST_PER_EVENT);
+    clients.connect(i);
+    clients.set_mtu(i, mtu);
+    clients.subscribe(i, c.feeds);
+  }
+  // the BLE task is up before sampling starts, like on the device
+  clients.poll();
+
+  fprintf(stderr, "jump,sequence,start_us,descend_ms,accelerate_ms,flight_ms,height_mm,max_bend,descend_rate,"
+                  "accelerate_rate,landing_bend,peak_accel\n");
+  jumps.begin(jump_done, JUMP_RAW_WINDOWS ? window_frame : nullptr);
+  filters.begin(filtered_frame);
+  sampler.add_consumer(raw_frame);
+  sampler.add_consumer(filter_frame);
+  sampler.begin(SAMPLE_RATE_HZ);
+
+  const uint64_t end_us = seconds * 1e6;
+  for (uint32_t n = 1;; n++)
+  {
+    const uint64_t period_start = static_cast<uint64_t>(n) * sampler.period_us();
+    if (period_start >= end_us)
+    {
+      break;
+    }
+    const uint64_t tick_us = period_start + (jitter_us > 0 ? rand() % (jitter_us + 1) : 0);
+    run_ble_task(tick_us);
+    if (sim_now_us < tick_us)
+    {
+      sim_now_us = tick_us;
+    }
+    sampler.tick(sim_now_us);
+    if (stall_every == 0 || n % stall_every != 0)
+    {
+      sampler.sample();
+    }
+  }
+  // slow clients work off their backlog, partial packets flush
+  const uint64_t drain_end_us = sim_now_us + DRAIN_US;
+  do
+  {
+    run_ble_task(sim_now_us + POLL_US, false);
+  } while (!drained(client_count) && sim_now_us < drain_end_us);
+  log_drain(print_log);
+
+  const sampler_stats sampling = sampler.stats();
+  fprintf(stderr, "sampler,frames,%u\n", sampling.frames);
+  fprintf(stderr, "sampler,missed,%u\n", sampling.missed);
+  fprintf(stderr, "sampler,avg_jitter_us,%u\n", sampling.avg_jitter_us);
+  fprintf(stderr, "sampler,max_jitter_us,%u\n", sampling.max_jitter_us);
+  fprintf(stderr, "sampler,max_latency_us,%u\n", sampling.max_latency_us);
+  fprintf(stderr, "sampler,read_us,%u\n", sampling.last_read_us);
+  const jump_stats jumping = jumps.stats();
+  fprintf(stderr, "jumps,detected,%u\n", jumping.jumps);
+  fprintf(stderr, "jumps,aborted,%u\n", jumping.aborted);
+  fprintf(stderr, "jumps,window_frames,%u\n", jumping.window_frames);
+
+  bool ok = true;
+  fprintf(stderr, "stream,client,feed,pushed,packets,decoded,dropped,decimated,overflows,sequence_gaps,bad_packets,"
+                  "avg_latency_us,high_water,stride\n");
+  for (size_t i = 0; i < client_count; i++)
+  {
+    const sim_client &c = sim_clients[i];
+    ok = report_stream(i, FEED_RAW, raw_pushed, c.raw) && ok;
+    ok = report_stream(i, FEED_FILTERED, filtered_pushed, c.stream) && ok;
+    ok = report_stream(i, FEED_JUMPS, window_pushed, c.stream) && ok;
+  }
+  fprintf(stderr, "client,client,feeds,jumps,jumps_dropped,voltages,voltages_dropped,stats,notifications,refused,"
+                  "oversized\n");
+  for (size_t i = 0; i < client_count; i++)
+  {
+    const sim_client &c = sim_clients[i];
+    const client_info info = clients.info(i);
+    const sim_link_stats link = sim_ble_stats(i);
+    fprintf(stderr, "client,%u,0x%02x,%u,%u,%u,%u,%u,%u,%u,%u\n", static_cast<unsigned>(i), c.feeds, c.jumps,
+            info.jumps_dropped, c.voltages, info.voltage_dropped, c.stats, link.notifications, link.refused,
+            link.oversized);
+    const bool jumps_ok =
+        !(c.feeds & FEED_JUMPS) || c.jumps + info.jumps_dropped + info.jumps_waiting == jumping.jumps;
+    const bool voltages_ok = !(c.feeds & FEED_VOLTAGE) ||
+                             c.voltages + info.voltage_dropped + info.voltage_waiting == voltages_sent;
+    ok = ok && jumps_ok && voltages_ok && link.oversized == 0 && c.bad_values == 0;
+  }
+  fprintf(stderr, "sync,client,pings,replies,exchanges,drift_ppb,true_drift_ppb,error_bound_us,stamped,"
+                  "avg_error_us,max_error_us,beyond_bound\n");
+  for (size_t i = 0; i < client_count && sync_us > 0; i++)
+  {
+    const sim_client &c = sim_clients[i];
+    const time_sync &clock = clients.time_base(i);
+    fprintf(stderr, "sync,%u,%u,%u,%u,%d,%d,%u,%u,%u,%u,%u\n", static_cast<unsigned>(i), c.pings, c.replies,
+            static_cast<unsigned>(clock.exchanges()), clock.drift_ppb(), static_cast<int>(c.skew * 1e9),
+            c.reply.error_us, c.stamped, c.stamped > 0 ? static_cast<unsigned>(c.total_error_us / c.stamped) : 0,
+            c.max_error_us, c.beyond_bound);
+    // a slow link holds replies behind its stream packets, the phone sees
+    // that in error_us but sub-ms alignment is only expected on a fast one
+    ok = ok && (!c.fast_link || c.max_error_us <= max_error_us);
+  }
+  return ok ? 0 : 1;
+}
@@ -8,19 +8,41 @@
  *
  */
 #include <Arduino.h>
+#include <BLE2902.h>
 #include <BLEDevice.h>
 #include <BLEServer.h>
+#include <esp_gap_ble_api.h>
+#include <esp_timer.h>
 
-#include <arduino-timer.h>
+#include <atomic>
 
 #include "common.h"
 #include "ble.h"
+#include "clients.h"
+#include "cpu_stats.h"
+#include "filter_bank.h"
+#include "fixed_string.h"
 #include "logger.h"
+#include "sampler.h"
 
 #define VOLTAGE_UPDATE_RATE 2 // seconds
-#define VOLTAGE_PIN 37
 
-bool deviceConnected = false;
+// not a multiple of the 1.25 ms connection interval unit, so over a few
+// polls time sync replies are queued at every phase of the connection events
+#define STREAM_POLL_US 10100
+#define STREAM_STATS_MS 1000
+#define CPU_STATS_MS 10000
+// LE data length extension, the largest link layer payload
+#define BLE_DATA_LENGTH 251
+// 7.5 - 15 ms connection interval, in 1.25 ms units
+#define BLE_MIN_INTERVAL 6
+#define BLE_MAX_INTERVAL 12
+// supervision timeout in 10 ms units
+#define BLE_TIMEOUT 400
+
+// connections as seen by the BLE stack's callbacks, the client table
+// itself belongs to the BLE task
+std::atomic<uint8_t> connections{0};
 
 TaskHandle_t ble_task;
 
@@ -28,39 +50,83 @@ BLEServer *server = NULL;
 BLEService *service = NULL;
 BLECharacteristic *message_send_characteristic = NULL;
 BLECharacteristic *voltage_characteristic = NULL;
+BLECharacteristic *stream_characteristic = NULL;
+BLECharacteristic *stream_stats_characteristic = NULL;
+BLECharacteristic *jump_characteristic = NULL;
+BLECharacteristic *log_characteristic = NULL;
+BLECharacteristic *raw_stream_characteristic = NULL;
+BLECharacteristic *time_sync_characteristic = NULL;
+
+// by notify_channel
+BLECharacteristic *notify_characteristics[static_cast<size_t>(notify_channel::SYNC_REPLY) + 1] = {};
 
-bool voltage_control_loop(void *params)
+bool ble_hw_notify(uint16_t conn_id, notify_channel channel, const uint8_t *data, size_t len)
 {
-  if (!deviceConnected)
+  // the controller's buffers for this connection are full, the client is
+  // not keeping up and the caller decides what to drop
+  if (esp_ble_get_cur_sendable_packets_num(conn_id) == 0)
   {
-    return true;
+    return false;
   }
+  BLECharacteristic *characteristic = notify_characteristics[static_cast<size_t>(channel)];
+  return esp_ble_gatts_send_indicate(server->getGattsIf(), conn_id, characteristic->getHandle(), len,
+                                     const_cast<uint8_t *>(data), false) == ESP_OK;
+}
 
-  uint16_t voltage = analogRead(VOLTAGE_PIN) * 2.5;
-  ss << voltage;
-  voltage_characteristic->setValue(ss.str());
-  clear_ss();
-  voltage_characteristic->notify();
-
-  return true;
+void voltage_control_loop()
+{
+  // read by the sampling task, an analogRead() here could convert on ADC1
+  // in the middle of one of its frames
+  const int16_t raw = sampler.voltage();
+  if (raw < 0)
+  {
+    return;
+  }
+  fixed_string<8> voltage;
+  voltage << static_cast<unsigned>(raw * 2.5);
+  // kept for reads, notified only to the clients that subscribed
+  voltage_characteristic->setValue(reinterpret_cast<uint8_t *>(const_cast<char *>(voltage.c_str())), voltage.size());
+  clients.send_voltage(reinterpret_cast<const uint8_t *>(voltage.c_str()), voltage.size());
 }
 
 class ServerCallbacks : public BLEServerCallbacks
 {
-  void onConnect(BLEServer *pServer)
+  void onConnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
+  {
+    if (!clients.connect(param->connect.conn_id))
+    {
+      LOG_WARN("client %u: event queue full", param->connect.conn_id);
+    }
+    // advertising stops on every connection, keep it up while there is room
+    if (++connections < BLE_MAX_CLIENTS)
+    {
+      BLEDevice::startAdvertising();
+    }
+    // ask for the largest link layer packets and a short connection interval,
+    // the MTU itself is raised by the central's exchange request
+    esp_ble_gap_set_pkt_data_len(param->connect.remote_bda, BLE_DATA_LENGTH);
+    pServer->updateConnParams(param->connect.remote_bda, BLE_MIN_INTERVAL, BLE_MAX_INTERVAL, 0, BLE_TIMEOUT);
+#ifdef CONFIG_BT_BLE_50_FEATURES_SUPPORTED
+    // 2M PHY needs a BLE 5 controller, the original ESP32 only has 1M
+    esp_ble_gap_set_preferred_phy(param->connect.remote_bda, 0,
+                                  ESP_BLE_GAP_PHY_2M_PREF_MASK, ESP_BLE_GAP_PHY_2M_PREF_MASK,
+                                  ESP_BLE_GAP_PHY_OPTIONS_NO_PREF);
+#endif
+  }
+
+  void onMtuChanged(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
   {
-    deviceConnected = true;
-  };
+    clients.set_mtu(param->mtu.conn_id, param->mtu.mtu);
+  }
 
-  void onDisconnect(BLEServer *pServer)
+  void onDisconnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param)
   {
-    if (!deviceConnected)
+    clients.disconnect(param->disconnect.conn_id);
+    if (connections > 0)
     {
-      return;
+      connections--;
     }
-    deviceConnected = false;
-    delay(500);
-    server->startAdvertising();
+    BLEDevice::startAdvertising();
   }
 };
 
@@ -68,15 +134,184 @@ class MessageReceiveCallbacks : public BLECharacteristicCallbacks
 {
   void onNotify(BLECharacteristic *pCharacteristic)
   {
-    log_message("received message");
+    LOG_INFO("received message");
   }
 };
 
-Timer<> ble_timer;
+class SubscribeCallbacks : public BLECharacteristicCallbacks
+{
+  void onWrite(BLECharacteristic *pCharacteristic, esp_ble_gatts_cb_param_t *param)
+  {
+    const std::string value = pCharacteristic->getValue();
+    if (value.size() != 1)
+    {
+      LOG_WARN("subscribe: bad length %u", static_cast<unsigned>(value.size()));
+      return;
+    }
+    clients.subscribe(param->write.conn_id, static_cast<uint8_t>(value[0]));
+  }
+};
+
+class TimeSyncCallbacks : public BLECharacteristicCallbacks
+{
+  void onWrite(BLECharacteristic *pCharacteristic, esp_ble_gatts_cb_param_t *param)
+  {
+    // before anything else, the time spent in this callback would count as
+    // link delay
+    const uint32_t received_us = micros();
+    const std::string value = pCharacteristic->getValue();
+    time_sync_ping ping;
+    if (value.size() != sizeof(ping))
+    {
+      LOG_WARN("time sync: bad length %u", static_cast<unsigned>(value.size()));
+      return;
+    }
+    memcpy(&ping, value.data(), sizeof(ping));
+    if (!clients.time_ping(param->write.conn_id, ping, received_us))
+    {
+      LOG_WARN("time sync: ping queue full");
+    }
+  }
+};
+
+class FilterConfigCallbacks : public BLECharacteristicCallbacks
+{
+  void onWrite(BLECharacteristic *pCharacteristic)
+  {
+    const std::string value = pCharacteristic->getValue();
+    filter_config config;
+    if (value.size() != sizeof(config))
+    {
+      LOG_WARN("filter config: bad length %u", static_cast<unsigned>(value.size()));
+      return;
+    }
+    memcpy(&config, value.data(), sizeof(config));
+    if (!filters.configure(config))
+    {
+      LOG_WARN("filter config: rejected channel %u stage %u", config.channel, config.stage);
+    }
+  }
+};
+
+// log mirror, runs on the log drain task
+void notify_log(const log_entry &entry)
+{
+  if (connections == 0)
+  {
+    return;
+  }
+  log_characteristic->setValue(reinterpret_cast<uint8_t *>(const_cast<char *>(entry.text)), entry.len);
+  log_characteristic->notify();
+}
+
+void clients_loop()
+{
+  clients.poll();
+}
+
+void stream_stats_loop()
+{
+  clients.send_stats(millis());
+}
+
+void cpu_stats_loop();
+
+// periodic work of the BLE task. each job has an esp_timer that only sets
+// the job's notification bit, the task sleeps until one is set
+struct ble_job
+{
+  const char *name;
+  uint32_t period_us;
+  void (*run)();
+  esp_timer_handle_t timer;
+  uint32_t runs;
+  uint64_t busy_us;
+  uint32_t max_us;
+};
+
+ble_job ble_jobs[] = {
+    {"clients", STREAM_POLL_US, clients_loop},
+    {"stream_stats", STREAM_STATS_MS * 1000UL, stream_stats_loop},
+    {"voltage", VOLTAGE_UPDATE_RATE * 1000000UL, voltage_control_loop},
+    {"cpu_stats", CPU_STATS_MS * 1000UL, cpu_stats_loop},
+};
+const size_t ble_job_count = sizeof(ble_jobs) / sizeof(ble_jobs[0]);
+
+uint64_t jobs_reported_us = 0;
+
+void cpu_stats_loop()
+{
+  report_cpu_load();
+  // the task's own share, available without FreeRTOS run time stats
+  const uint64_t now = esp_timer_get_time();
+  const uint64_t elapsed = now - jobs_reported_us;
+  for (size_t i = 0; i < ble_job_count; i++)
+  {
+    ble_job &job = ble_jobs[i];
+    const unsigned load = elapsed > 0 ? static_cast<unsigned>(10000 * job.busy_us / elapsed) : 0;
+    LOG_INFO("job,%s,%u,%u.%02u,%u", job.name, static_cast<unsigned>(job.runs), load / 100, load % 100,
+             static_cast<unsigned>(job.max_us));
+    job.runs = 0;
+    job.busy_us = 0;
+    job.max_us = 0;
+  }
+  jobs_reported_us = now;
+
+  const sampler_stats sampling = sampler.stats();
+  LOG_INFO("sampler,%u,%u,%u,%u,%u,%u", static_cast<unsigned>(sampling.frames),
+           static_cast<unsigned>(sampling.missed), static_cast<unsigned>(sampling.avg_jitter_us),
+           static_cast<unsigned>(sampling.max_jitter_us), static_cast<unsigned>(sampling.max_latency_us),
+           static_cast<unsigned>(sampling.last_read_us));
+
+  const jump_stats jumping = jumps.stats();
+  LOG_INFO("jumps,%u,%u,%u,%u", static_cast<unsigned>(jumping.frames), static_cast<unsigned>(jumping.jumps),
+           static_cast<unsigned>(jumping.aborted), static_cast<unsigned>(jumping.window_frames));
+}
+
+void job_due(void *arg)
+{
+  xTaskNotify(ble_task, 1UL << reinterpret_cast<uintptr_t>(arg), eSetBits);
+}
+
+void start_jobs()
+{
+  jobs_reported_us = esp_timer_get_time();
+  for (size_t i = 0; i < ble_job_count; i++)
+  {
+    esp_timer_create_args_t args = {};
+    args.callback = job_due;
+    args.arg = reinterpret_cast<void *>(i);
+    args.name = ble_jobs[i].name;
+    esp_timer_create(&args, &ble_jobs[i].timer);
+    esp_timer_start_periodic(ble_jobs[i].timer, ble_jobs[i].period_us);
+  }
+}
+
+void run_jobs(uint32_t due)
+{
+  for (size_t i = 0; i < ble_job_count; i++)
+  {
+    if (!(due & (1UL << i)))
+    {
+      continue;
+    }
+    ble_job &job = ble_jobs[i];
+    const uint64_t start = esp_timer_get_time();
+    job.run();
+    const uint32_t took = esp_timer_get_time() - start;
+    job.runs++;
+    job.busy_us += took;
+    if (took > job.max_us)
+    {
+      job.max_us = took;
+    }
+  }
+}
 
 void setup_ble_main(void *params)
 {
   BLEDevice::init(BLUETOOTH_NAME);
+  BLEDevice::setMTU(BLE_MTU);
   server = BLEDevice::createServer();
   server->setCallbacks(new ServerCallbacks());
   service = server->createService(SERVICE_UUID);
@@ -100,7 +335,60 @@ void setup_ble_main(void *params)
           BLECharacteristic::PROPERTY_WRITE |
           BLECharacteristic::PROPERTY_NOTIFY);
 
+  stream_characteristic = service->createCharacteristic(
+      STREAM_CHARACTERISTIC_UUID,
+      BLECharacteristic::PROPERTY_NOTIFY);
+  stream_characteristic->addDescriptor(new BLE2902());
+
+  stream_stats_characteristic = service->createCharacteristic(
+      STREAM_STATS_CHARACTERISTIC_UUID,
+      BLECharacteristic::PROPERTY_READ |
+          BLECharacteristic::PROPERTY_NOTIFY);
+  stream_stats_characteristic->addDescriptor(new BLE2902());
+
+  jump_characteristic = service->createCharacteristic(
+      JUMP_CHARACTERISTIC_UUID,
+      BLECharacteristic::PROPERTY_READ |
+          BLECharacteristic::PROPERTY_NOTIFY);
+  jump_characteristic->addDescriptor(new BLE2902());
+
+  log_characteristic = service->createCharacteristic(
+      LOG_CHARACTERISTIC_UUID,
+      BLECharacteristic::PROPERTY_NOTIFY);
+  log_characteristic->addDescriptor(new BLE2902());
+
+  raw_stream_characteristic = service->createCharacteristic(
+      RAW_STREAM_CHARACTERISTIC_UUID,
+      BLECharacteristic::PROPERTY_NOTIFY);
+  raw_stream_characteristic->addDescriptor(new BLE2902());
+
+  BLECharacteristic *subscribe_characteristic = service->createCharacteristic(
+      SUBSCRIBE_CHARACTERISTIC_UUID,
+      BLECharacteristic::PROPERTY_WRITE);
+  subscribe_characteristic->setCallbacks(new SubscribeCallbacks());
+
+  // written without response, the ATT response would only hold up the reply
+  time_sync_characteristic = service->createCharacteristic(
+      TIME_SYNC_CHARACTERISTIC_UUID,
+      BLECharacteristic::PROPERTY_WRITE_NR |
+          BLECharacteristic::PROPERTY_NOTIFY);
+  time_sync_characteristic->addDescriptor(new BLE2902());
+  time_sync_characteristic->setCallbacks(new TimeSyncCallbacks());
+
+  notify_characteristics[static_cast<size_t>(notify_channel::RAW_STREAM)] = raw_stream_characteristic;
+  notify_characteristics[static_cast<size_t>(notify_channel::FILTERED_STREAM)] = stream_characteristic;
+  notify_characteristics[static_cast<size_t>(notify_channel::JUMP)] = jump_characteristic;
+  notify_characteristics[static_cast<size_t>(notify_channel::VOLTAGE)] = voltage_characteristic;
+  notify_characteristics[static_cast<size_t>(notify_channel::STREAM_STATS)] = stream_stats_characteristic;
+  notify_characteristics[static_cast<size_t>(notify_channel::SYNC_REPLY)] = time_sync_characteristic;
+
+  BLECharacteristic *filter_config_characteristic = service->createCharacteristic(
+      FILTER_CONFIG_CHARACTERISTIC_UUID,
+      BLECharacteristic::PROPERTY_WRITE);
+  filter_config_characteristic->setCallbacks(new FilterConfigCallbacks());
+
   service->start();
+  set_log_mirror(notify_log);
 
   BLEAdvertising *advertising = BLEDevice::getAdvertising();
   advertising->addServiceUUID(SERVICE_UUID);
@@ -109,23 +397,22 @@ void setup_ble_main(void *params)
   advertising->setMinPreferred(0x12);
   BLEDevice::startAdvertising();
 
-  ss << "Bluetooth set up. Connect to \"" << BLUETOOTH_NAME << "\" on your phone.";
-  log_message(ss.str());
-  clear_ss();
+  LOG_INFO("Bluetooth set up. Connect to \"%s\" on your phone.", BLUETOOTH_NAME);
 
-  ble_timer = Timer<>();
-  ble_timer.every(VOLTAGE_UPDATE_RATE * 1000, voltage_control_loop);
+  start_jobs();
 
   for (;;)
   {
-    ble_timer.tick();
+    // blocks until a job is due, the core idles in between
+    uint32_t due = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &due, portMAX_DELAY);
+    run_jobs(due);
   }
 }
 
 void setup_ble()
 {
-  log_message("Starting BLE");
-  adcAttachPin(VOLTAGE_PIN);
+  LOG_INFO("Starting BLE");
   xTaskCreatePinnedToCore(
       setup_ble_main, // task function
       "ble_task",     // name of task
@@ -138,7 +425,7 @@ void setup_ble()
 
 void send_message(std::string message)
 {
-  if (!deviceConnected)
+  if (connections == 0)
   {
     return;
   }
@@ -0,0 +1,426 @@
+#include <Arduino.h>
+#include <string.h>
+
+#include "clients.h"
+#include "logger.h"
+
+client_fanout clients;
+
+static bool send_raw_stream(uint16_t conn_id, const uint8_t *data, size_t len)
+{
+  return ble_hw_notify(conn_id, notify_channel::RAW_STREAM, data, len);
+}
+
+static bool send_stream(uint16_t conn_id, const uint8_t *data, size_t len)
+{
+  return ble_hw_notify(conn_id, notify_channel::FILTERED_STREAM, data, len);
+}
+
+bool client_fanout::push_raw(const sample_record &frame)
+{
+  return raw_feed.push(frame);
+}
+
+bool client_fanout::push_filtered(const sample_record &frame)
+{
+  return filtered_feed.push(frame);
+}
+
+bool client_fanout::push_window(const sample_record &frame)
+{
+  return window_feed.push(frame);
+}
+
+bool client_fanout::push_jump(const jump_summary &summary)
+{
+  return jump_feed.push(summary);
+}
+
+bool client_fanout::connect(uint16_t conn_id)
+{
+  return events.push(event{event_type::CONNECT, conn_id, 0});
+}
+
+bool client_fanout::disconnect(uint16_t conn_id)
+{
+  return events.push(event{event_type::DISCONNECT, conn_id, 0});
+}
+
+bool client_fanout::set_mtu(uint16_t conn_id, uint16_t mtu)
+{
+  return events.push(event{event_type::MTU, conn_id, mtu});
+}
+
+bool client_fanout::subscribe(uint16_t conn_id, uint8_t feeds)
+{
+  return events.push(event{event_type::SUBSCRIBE, conn_id, feeds});
+}
+
+bool client_fanout::time_ping(uint16_t conn_id, const time_sync_ping &value, uint32_t received_us)
+{
+  return pings.push(ping{conn_id, received_us, value});
+}
+
+int client_fanout::find(uint16_t conn_id) const
+{
+  for (size_t i = 0; i < BLE_MAX_CLIENTS; i++)
+  {
+    if (slots[i].info.connected && slots[i].info.conn_id == conn_id)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+size_t client_fanout::connected() const
+{
+  size_t count = 0;
+  for (size_t i = 0; i < BLE_MAX_CLIENTS; i++)
+  {
+    count += slots[i].info.connected;
+  }
+  return count;
+}
+
+client_info client_fanout::info(size_t slot) const
+{
+  client_info out = slots[slot].info;
+  out.jumps_waiting = out.feeds & FEED_JUMPS ? jump_feed.available(slot) : 0;
+  out.voltage_waiting = slots[slot].voltage_due;
+  return out;
+}
+
+// the stack cuts a value that does not fit, such values wait or are skipped
+static bool fits(const client_info &info, size_t len)
+{
+  return len + 3 <= info.mtu;
+}
+
+void client_fanout::apply(const event &e)
+{
+  int slot = find(e.conn_id);
+  if (e.type == event_type::CONNECT)
+  {
+    if (slot >= 0)
+    {
+      return;
+    }
+    for (size_t i = 0; i < BLE_MAX_CLIENTS && slot < 0; i++)
+    {
+      slot = slots[i].info.connected ? -1 : i;
+    }
+    if (slot < 0)
+    {
+      LOG_WARN("client %u: no free slot", e.conn_id);
+      return;
+    }
+    client &c = slots[slot];
+    c.info = client_info();
+    c.info.connected = true;
+    c.info.conn_id = e.conn_id;
+    c.info.mtu = STREAM_DEFAULT_MTU;
+    c.clock.reset();
+    c.sync = exchange();
+    c.stream_source = nullptr;
+    c.voltage_due = false;
+    c.stats_due = 0;
+    c.raw.set_mtu(STREAM_DEFAULT_MTU);
+    c.stream.set_mtu(STREAM_DEFAULT_MTU);
+    set_feeds(slot, CLIENT_DEFAULT_FEEDS);
+    LOG_INFO("client %u connected, %u of %u", e.conn_id, static_cast<unsigned>(connected()), BLE_MAX_CLIENTS);
+    return;
+  }
+  if (slot < 0)
+  {
+    return;
+  }
+  client &c = slots[slot];
+  switch (e.type)
+  {
+  case event_type::DISCONNECT:
+    set_feeds(slot, 0);
+    c.info.connected = false;
+    LOG_INFO("client %u disconnected", e.conn_id);
+    break;
+  case event_type::MTU:
+    c.info.mtu = e.value;
+    c.raw.set_mtu(e.value);
+    c.stream.set_mtu(e.value);
+    break;
+  case event_type::SUBSCRIBE:
+    set_feeds(slot, e.value & FEED_ALL);
+    LOG_INFO("client %u feeds 0x%02x", e.conn_id, c.info.feeds);
+    break;
+  default:
+    break;
+  }
+}
+
+void client_fanout::apply(const ping &p)
+{
+  const int slot = find(p.conn_id);
+  if (slot < 0)
+  {
+    return;
+  }
+  client &c = slots[slot];
+  // the ping completes the exchange of the last reply the phone received
+  if (c.sync.replied && p.value.reply_phone_us != 0 && p.value.reply_sequence == c.sync.sequence)
+  {
+    c.clock.add(c.sync.phone_us, c.sync.received_us, c.sync.replied_us, p.value.reply_phone_us);
+  }
+  c.sync = exchange();
+  c.sync.sequence = p.value.sequence;
+  c.sync.phone_us = p.value.phone_us;
+  c.sync.received_us = p.received_us;
+  c.sync.reply_due = true;
+}
+
+void client_fanout::set_feeds(size_t slot, uint8_t feeds)
+{
+  client &c = slots[slot];
+  const uint8_t changed = c.info.feeds ^ feeds;
+  if (changed & FEED_RAW)
+  {
+    c.raw.discard();
+    if (feeds & FEED_RAW)
+    {
+      raw_feed.attach(slot);
+      c.raw.open(slot, c.info.conn_id, FEED_RAW, send_raw_stream, &c.clock);
+    }
+    else
+    {
+      raw_feed.detach(slot);
+    }
+  }
+
+  // a client with every filtered frame has the jump windows already
+  sample_feed *source = nullptr;
+  if (feeds & FEED_FILTERED)
+  {
+    source = &filtered_feed;
+  }
+  else if (JUMP_RAW_WINDOWS && (feeds & FEED_JUMPS))
+  {
+    source = &window_feed;
+  }
+  if (source != c.stream_source)
+  {
+    c.stream.discard();
+    if (c.stream_source)
+    {
+      c.stream_source->detach(slot);
+    }
+    if (source)
+    {
+      source->attach(slot);
+      c.stream.open(slot, c.info.conn_id, source == &filtered_feed ? FEED_FILTERED : FEED_JUMPS, send_stream,
+                    &c.clock);
+    }
+    c.stream_source = source;
+  }
+
+  if (changed & FEED_JUMPS)
+  {
+    if (feeds & FEED_JUMPS)
+    {
+      jump_feed.attach(slot);
+    }
+    else
+    {
+      jump_feed.detach(slot);
+    }
+  }
+  c.info.feeds = feeds;
+}
+
+void client_fanout::poll_sync(client &c)
+{
+  if (!c.sync.reply_due)
+  {
+    return;
+  }
+  // stamped as late as possible, the reply leaves with the next connection
+  // event. a refused reply is stamped again on the next poll
+  const uint32_t now = micros();
+  time_sync_reply reply;
+  reply.sequence = c.sync.sequence;
+  reply.phone_us = c.clock.synced() ? c.clock.to_phone(now) : 0;
+  reply.drift_ppb = c.clock.drift_ppb();
+  reply.error_us = c.clock.error_us(now);
+  reply.exchanges = c.clock.exchanges();
+  if (ble_hw_notify(c.info.conn_id, notify_channel::SYNC_REPLY, reinterpret_cast<const uint8_t *>(&reply),
+                    sizeof(reply)))
+  {
+    c.sync.replied_us = now;
+    c.sync.reply_due = false;
+    c.sync.replied = true;
+  }
+}
+
+void client_fanout::poll_jumps(size_t slot)
+{
+  client &c = slots[slot];
+  // keep half the queue free for the producer
+  const size_t waiting = jump_feed.available(slot);
+  if (waiting > CLIENT_JUMP_QUEUE_LENGTH / 2)
+  {
+    c.info.jumps_dropped += jump_feed.skip(slot, waiting - CLIENT_JUMP_QUEUE_LENGTH / 2);
+  }
+  jump_summary summary;
+  while (fits(c.info, sizeof(summary)) && jump_feed.peek(slot, summary))
+  {
+    if (c.clock.synced())
+    {
+      summary.start_us = c.clock.to_phone(summary.start_us);
+    }
+    if (!ble_hw_notify(c.info.conn_id, notify_channel::JUMP, reinterpret_cast<const uint8_t *>(&summary),
+                       sizeof(summary)))
+    {
+      break;
+    }
+    jump_feed.skip(slot, 1);
+    c.info.jumps_sent++;
+  }
+}
+
+void client_fanout::poll_streams(client &c)
+{
+  const bool raw_open = c.info.feeds & FEED_RAW;
+  size_t raw_sent = 0;
+  size_t stream_sent = 0;
+  if (raw_open && c.raw_first)
+  {
+    raw_sent = c.raw.poll(raw_feed);
+  }
+  if (c.stream_source)
+  {
+    stream_sent = c.stream.poll(*c.stream_source);
+  }
+  if (raw_open && !c.raw_first)
+  {
+    raw_sent = c.raw.poll(raw_feed);
+  }
+  if (raw_sent != stream_sent)
+  {
+    c.raw_first = raw_sent < stream_sent;
+  }
+}
+
+void client_fanout::poll_status(size_t slot)
+{
+  client &c = slots[slot];
+  if (c.voltage_due && (!fits(c.info, voltage_len) ||
+                        ble_hw_notify(c.info.conn_id, notify_channel::VOLTAGE, voltage, voltage_len)))
+  {
+    c.voltage_due = false;
+  }
+  static const uint8_t stream_feeds[] = {FEED_RAW, FEED_FILTERED, FEED_JUMPS};
+  for (uint8_t feed : stream_feeds)
+  {
+    stream_stats stats;
+    if (!(c.stats_due & feed))
+    {
+      continue;
+    }
+    if (!fits(c.info, sizeof(stats)) || !stream_stats_of(slot, feed, stats_ms, stats))
+    {
+      c.stats_due &= ~feed;
+      continue;
+    }
+    if (!ble_hw_notify(c.info.conn_id, notify_channel::STREAM_STATS, reinterpret_cast<const uint8_t *>(&stats),
+                       sizeof(stats)))
+    {
+      return;
+    }
+    c.stats_due &= ~feed;
+  }
+}
+
+void client_fanout::poll()
+{
+  event e;
+  while (events.pop(e))
+  {
+    apply(e);
+  }
+  ping p;
+  while (pings.pop(p))
+  {
+    apply(p);
+  }
+  for (size_t i = 0; i < BLE_MAX_CLIENTS; i++)
+  {
+    client &c = slots[i];
+    if (!c.info.connected)
+    {
+      continue;
+    }
+    // sync replies ahead of everything queued on the link, which would
+    // only delay them
+    poll_sync(c);
+    // summaries next, they are small and what the app shows
+    if (c.info.feeds & FEED_JUMPS)
+    {
+      poll_jumps(i);
+    }
+    poll_status(i);
+    poll_streams(c);
+  }
+  raw_feed.release();
+  filtered_feed.release();
+  window_feed.release();
+  jump_feed.release();
+}
+
+void client_fanout::send_voltage(const uint8_t *data, size_t len)
+{
+  voltage_len = len < CLIENT_VOLTAGE_MAX ? len : CLIENT_VOLTAGE_MAX;
+  memcpy(voltage, data, voltage_len);
+  for (size_t i = 0; i < BLE_MAX_CLIENTS; i++)
+  {
+    client &c = slots[i];
+    if (!c.info.connected || !(c.info.feeds & FEED_VOLTAGE))
+    {
+      continue;
+    }
+    c.info.voltage_dropped += c.voltage_due;
+    c.voltage_due = true;
+  }
+}
+
+bool client_fanout::stream_stats_of(size_t slot, uint8_t feed, uint32_t now_ms, stream_stats &out)
+{
+  client &c = slots[slot];
+  if (!c.info.connected)
+  {
+    return false;
+  }
+  if (feed == FEED_RAW && (c.info.feeds & FEED_RAW))
+  {
+    out = c.raw.stats(raw_feed, now_ms);
+    return true;
+  }
+  const sample_feed *source = feed == FEED_FILTERED ? &filtered_feed : feed == FEED_JUMPS ? &window_feed
+                                                                                          : nullptr;
+  if (source && source == c.stream_source)
+  {
+    out = c.stream.stats(*source, now_ms);
+    return true;
+  }
+  return false;
+}
+
+void client_fanout::send_stats(uint32_t now_ms)
+{
+  stats_ms = now_ms;
+  for (size_t i = 0; i < BLE_MAX_CLIENTS; i++)
+  {
+    client &c = slots[i];
+    if (c.info.connected)
+    {
+      c.stats_due = FEED_RAW | FEED_FILTERED | FEED_JUMPS;
+    }
+  }
+}
@@ -1,9 +0,0 @@
-#include "common.h"
-
-std::ostringstream ss;
-
-void clear_ss()
-{
-  ss.str("");
-  ss.clear();
-}
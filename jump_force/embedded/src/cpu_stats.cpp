@@ -0,0 +1,95 @@
+#include "cpu_stats.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "logger.h"
+
+#if configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY
+
+struct task_counter
+{
+  TaskHandle_t handle;
+  uint32_t run_time;
+};
+
+static task_counter previous[CPU_STATS_MAX_TASKS];
+static size_t previous_count = 0;
+static uint32_t previous_total = 0;
+
+static uint32_t previous_run_time(TaskHandle_t handle)
+{
+  for (size_t i = 0; i < previous_count; i++)
+  {
+    if (previous[i].handle == handle)
+    {
+      return previous[i].run_time;
+    }
+  }
+  return 0;
+}
+
+// tenths of a percent, integer math keeps the log writer from allocating
+static unsigned permille(uint32_t part, uint32_t total)
+{
+  return total > 0 ? static_cast<unsigned>(static_cast<uint64_t>(part) * 1000 / total) : 0;
+}
+
+void report_cpu_load()
+{
+  static TaskStatus_t tasks[CPU_STATS_MAX_TASKS];
+  uint32_t total = 0;
+  const size_t count = uxTaskGetSystemState(tasks, CPU_STATS_MAX_TASKS, &total);
+  // the run time counter is the time since boot, so this is wall time
+  const uint32_t elapsed = total - previous_total;
+
+  for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++)
+  {
+    const TaskHandle_t idle = xTaskGetIdleTaskHandleForCPU(core);
+    for (size_t i = 0; i < count; i++)
+    {
+      if (tasks[i].xHandle == idle)
+      {
+        const unsigned load = permille(tasks[i].ulRunTimeCounter - previous_run_time(idle), elapsed);
+        LOG_INFO("cpu,%d,idle,%u.%u", static_cast<int>(core), load / 10, load % 10);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    const BaseType_t core = xTaskGetAffinity(tasks[i].xHandle);
+    const unsigned load = permille(tasks[i].ulRunTimeCounter - previous_run_time(tasks[i].xHandle), elapsed);
+    char core_name[12];
+    if (core == tskNO_AFFINITY)
+    {
+      snprintf(core_name, sizeof(core_name), "any");
+    }
+    else
+    {
+      snprintf(core_name, sizeof(core_name), "%d", static_cast<int>(core));
+    }
+    LOG_INFO("task,%s,%s,%u.%u,%u", tasks[i].pcTaskName, core_name, load / 10, load % 10,
+             static_cast<unsigned>(tasks[i].usStackHighWaterMark));
+  }
+
+  for (size_t i = 0; i < count; i++)
+  {
+    previous[i].handle = tasks[i].xHandle;
+    previous[i].run_time = tasks[i].ulRunTimeCounter;
+  }
+  previous_count = count;
+  previous_total = total;
+}
+
+#else
+
+void report_cpu_load()
+{
+  LOG_INFO("cpu,unavailable");
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include <math.h>
+
+#include "filter_bank.h"
+
+static constexpr biquad_coeffs flex_design[FILTER_STAGES] = {
+    biquad_highpass(SAMPLE_RATE_HZ, FLEX_HIGHPASS_HZ, 0.7071),
+    biquad_lowpass(SAMPLE_RATE_HZ, FLEX_LOWPASS_HZ, 0.7071),
+};
+
+// fourth order butterworth as two biquads
+static constexpr biquad_coeffs hall_design[FILTER_STAGES] = {
+    biquad_lowpass(SAMPLE_RATE_HZ, HALL_LOWPASS_HZ, 0.5412),
+    biquad_lowpass(SAMPLE_RATE_HZ, HALL_LOWPASS_HZ, 1.3066),
+};
+
+filter_bank filters;
+
+void filter_bank::begin(frame_consumer out)
+{
+  this->out = out;
+  for (uint8_t i = 0; i < ANALOG_CHANNELS; i++)
+  {
+    filters[i].set(i == HALL_CHANNEL ? hall_design : flex_design);
+    filters[i].reset();
+  }
+  count = 0;
+  primed = false;
+}
+
+bool filter_bank::configure(const filter_config &config)
+{
+  // copied out of the packed struct
+  const biquad_coeffs c = config.coeffs;
+  if (config.channel >= ANALOG_CHANNELS || config.stage >= FILTER_STAGES ||
+      !isfinite(c.b0) || !isfinite(c.b1) || !isfinite(c.b2) || !biquad_stable(c))
+  {
+    return false;
+  }
+  return updates.push(config);
+}
+
+void filter_bank::apply_updates()
+{
+  filter_config config;
+  while (updates.pop(config))
+  {
+    // the stage keeps its state, so a change shows as a short transient
+    const biquad_coeffs c = config.coeffs;
+    filters[config.channel].set(config.stage, c);
+  }
+}
+
+void filter_bank::push(const sample_record &frame)
+{
+  block[count++] = frame;
+  if (count == FILTER_BLOCK)
+  {
+    process_block();
+    count = 0;
+  }
+}
+
+void filter_bank::process_block()
+{
+  apply_updates();
+  typedef biquad_kernel<filter_sample> kernel;
+  if (!primed)
+  {
+    // start from the sensors' resting values instead of 0
+    for (uint8_t c = 0; c < ANALOG_CHANNELS; c++)
+    {
+      filters[c].prime(kernel::from_counts(block[0].values[c]));
+    }
+    primed = true;
+  }
+  for (uint8_t c = 0; c < ANALOG_CHANNELS; c++)
+  {
+    for (size_t i = 0; i < FILTER_BLOCK; i++)
+    {
+      channel[i] = kernel::from_counts(block[i].values[c]);
+    }
+    filters[c].process(channel, channel, FILTER_BLOCK);
+    for (size_t i = 0; i < FILTER_BLOCK; i++)
+    {
+      block[i].values[c] = kernel::to_counts(channel[i]);
+    }
+  }
+  if (out)
+  {
+    for (size_t i = 0; i < FILTER_BLOCK; i++)
+    {
+      out(block[i]);
+    }
+  }
+}
@@ -0,0 +1,218 @@
+#include <math.h>
+
+#include "jump_detector.h"
+#include "logger.h"
+
+#define GRAVITY 9.81f
+
+jump_detector jumps;
+
+static int16_t clamp16(float value)
+{
+  return value > 32767 ? 32767 : value < -32768 ? -32768
+                                                : static_cast<int16_t>(lroundf(value));
+}
+
+static float flex_bend(const sample_record &frame)
+{
+  float sum = 0;
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < ANALOG_CHANNELS; i++)
+  {
+    if (i != HALL_CHANNEL)
+    {
+      sum += frame.values[i];
+      count++;
+    }
+  }
+  return count > 0 ? sum / count : 0;
+}
+
+static uint32_t accel_magnitude(const sample_record &frame)
+{
+  float sum = 0;
+  for (uint8_t i = ACCEL_CHANNEL; i < ACCEL_CHANNEL + 3 && i < SAMPLE_CHANNELS; i++)
+  {
+    sum += static_cast<float>(frame.values[i]) * frame.values[i];
+  }
+  return sqrtf(sum);
+}
+
+void jump_detector::begin(jump_handler on_jump, frame_consumer on_window_frame)
+{
+  this->on_jump = on_jump;
+  this->on_window_frame = on_window_frame;
+  current = jump_phase::STANDING;
+  has_previous = false;
+  history_next = 0;
+  history_count = 0;
+  counters = {};
+}
+
+void jump_detector::enter(jump_phase next, uint32_t t_us)
+{
+  current = next;
+  phase_start_us = t_us;
+}
+
+void jump_detector::abort()
+{
+  LOG_DEBUG("jump aborted in phase %u", static_cast<unsigned>(current));
+  counters.aborted++;
+  current = jump_phase::STANDING;
+}
+
+void jump_detector::push(const sample_record &frame)
+{
+  counters.frames++;
+  history[history_next] = frame;
+  history_next = (history_next + 1) % JUMP_HISTORY_FRAMES;
+  if (history_count < JUMP_HISTORY_FRAMES)
+  {
+    history_count++;
+  }
+
+  const float bend = flex_bend(frame);
+  const uint32_t t_us = frame.t_us;
+  if (!has_previous || t_us == previous_us)
+  {
+    has_previous = true;
+    previous_bend = bend;
+    previous_us = t_us;
+    return;
+  }
+  const float rate = (bend - previous_bend) * 1e6f / (t_us - previous_us);
+  previous_bend = bend;
+  previous_us = t_us;
+  const uint32_t in_phase_ms = (t_us - phase_start_us) / 1000;
+
+  if (current != jump_phase::STANDING)
+  {
+    const uint32_t accel = accel_magnitude(frame);
+    peak_accel = accel > peak_accel ? accel : peak_accel;
+  }
+
+  switch (current)
+  {
+  case jump_phase::STANDING:
+    if (rate > JUMP_DESCEND_RATE)
+    {
+      summary = {};
+      summary.start_us = t_us;
+      start_bend = bend;
+      max_bend = bend;
+      min_rate = 0;
+      max_rate = rate;
+      peak_accel = accel_magnitude(frame);
+      enter(jump_phase::DESCEND, t_us);
+    }
+    break;
+
+  case jump_phase::DESCEND:
+    max_rate = rate > max_rate ? rate : max_rate;
+    if (bend > max_bend)
+    {
+      max_bend = bend;
+    }
+    if (rate < 0)
+    {
+      if (max_bend - start_bend < JUMP_MIN_BEND)
+      {
+        abort();
+        break;
+      }
+      summary.descend_ms = (t_us - summary.start_us) / 1000;
+      enter(jump_phase::ACCELERATE_UP, t_us);
+    }
+    else if (in_phase_ms > JUMP_MAX_PHASE_MS)
+    {
+      abort();
+    }
+    break;
+
+  case jump_phase::ACCELERATE_UP:
+    min_rate = rate < min_rate ? rate : min_rate;
+    if (min_rate < -JUMP_PUSH_RATE && rate > -JUMP_TAKEOFF_RATE)
+    {
+      summary.accelerate_ms = (t_us - phase_start_us) / 1000;
+      takeoff_us = t_us;
+      enter(jump_phase::FLIGHT, t_us);
+    }
+    else if (in_phase_ms > JUMP_MAX_PHASE_MS)
+    {
+      abort();
+    }
+    break;
+
+  case jump_phase::FLIGHT:
+    if (rate > JUMP_LANDING_RATE)
+    {
+      const uint32_t flight_ms = (t_us - takeoff_us) / 1000;
+      if (flight_ms < JUMP_MIN_FLIGHT_MS)
+      {
+        abort();
+        break;
+      }
+      summary.flight_ms = flight_ms;
+      touchdown_us = t_us;
+      touchdown_bend = bend;
+      landing_bend = bend;
+      enter(jump_phase::LANDING, t_us);
+    }
+    else if (in_phase_ms > JUMP_MAX_FLIGHT_MS)
+    {
+      // stood up from a squat without leaving the ground
+      abort();
+    }
+    break;
+
+  case jump_phase::LANDING:
+    landing_bend = bend > landing_bend ? bend : landing_bend;
+    if ((t_us - touchdown_us) / 1000 >= JUMP_LANDING_MS)
+    {
+      complete();
+      current = jump_phase::STANDING;
+    }
+    break;
+  }
+}
+
+void jump_detector::complete()
+{
+  const float flight_s = summary.flight_ms / 1000.0f;
+  summary.sequence = sequence++;
+  summary.height_mm = lroundf(GRAVITY * flight_s * flight_s / 8 * 1000);
+  summary.max_bend = clamp16(max_bend - start_bend);
+  summary.descend_rate = clamp16(max_rate);
+  summary.accelerate_rate = clamp16(-min_rate);
+  summary.landing_bend = clamp16(landing_bend - touchdown_bend);
+  summary.peak_accel = peak_accel > 65535 ? 65535 : peak_accel;
+  counters.jumps++;
+  LOG_INFO("jump %u: flight %u ms, %u mm", summary.sequence, summary.flight_ms, summary.height_mm);
+  if (on_jump)
+  {
+    on_jump(summary);
+  }
+  if (on_window_frame)
+  {
+    emit_window();
+  }
+}
+
+void jump_detector::emit_window()
+{
+  const uint32_t window_start_us = summary.start_us - JUMP_PRE_MS * 1000UL;
+  // oldest kept frame first, skipping those before the window
+  size_t index = (history_next + JUMP_HISTORY_FRAMES - history_count) % JUMP_HISTORY_FRAMES;
+  for (size_t i = 0; i < history_count; i++)
+  {
+    const sample_record &frame = history[index];
+    index = (index + 1) % JUMP_HISTORY_FRAMES;
+    if (static_cast<int32_t>(frame.t_us - window_start_us) < 0)
+    {
+      continue;
+    }
+    on_window_frame(frame);
+    counters.window_frames++;
+  }
+}
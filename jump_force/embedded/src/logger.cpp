@@ -1,6 +1,152 @@
-#include "common.h"
+#include <Arduino.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
 
-void log_message(const std::string &message)
+#include <atomic>
+
+#include "logger.h"
+
+/**
+ * bounded multi producer ring, one consumer. every slot carries a sequence
+ * number: a producer claims the slot whose sequence equals its position,
+ * formats into it and publishes it by bumping the sequence, the consumer
+ * frees it again by advancing the sequence one lap
+ */
+struct log_slot
+{
+  std::atomic<uint32_t> sequence;
+  log_entry entry;
+};
+
+static log_slot slots[LOG_SLOTS];
+static std::atomic<uint32_t> write_position{0};
+static uint32_t read_position = 0;
+static std::atomic<uint32_t> written{0};
+static std::atomic<uint32_t> dropped{0};
+static std::atomic<uint32_t> rejected{0};
+
+static struct log_ring_init
+{
+  log_ring_init()
+  {
+    for (uint32_t i = 0; i < LOG_SLOTS; i++)
+    {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+} ring_init;
+
+static log_slot *claim()
+{
+  uint32_t position = write_position.load(std::memory_order_relaxed);
+  for (;;)
+  {
+    log_slot &slot = slots[position & (LOG_SLOTS - 1)];
+    const int32_t diff = slot.sequence.load(std::memory_order_acquire) - position;
+    if (diff == 0)
+    {
+      if (write_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+      {
+        return &slot;
+      }
+    }
+    else if (diff < 0)
+    {
+      // the consumer has not freed this slot yet, the ring is full
+      return nullptr;
+    }
+    else
+    {
+      position = write_position.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+// whether format converts a float, which newlib's vsnprintf would format
+// through dtoa and its heap allocated buffers
+static bool has_float(const char *format)
+{
+  while ((format = strchr(format, '%')))
+  {
+    format++;
+    // flags, width, precision and length
+    format += strspn(format, "-+ #0123456789.*hlLjzt");
+    if (*format == '\0')
+    {
+      return false;
+    }
+    if (strchr("fFeEgGaA", *format))
+    {
+      return true;
+    }
+    format++;
+  }
+  return false;
+}
+
+void log_write(uint8_t level, const char *format, ...)
+{
+  log_slot *slot = claim();
+  if (!slot)
+  {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  log_entry &entry = slot->entry;
+  entry.t_ms = millis();
+  entry.level = level;
+  int len;
+  if (has_float(format))
+  {
+    len = strlen(format);
+    const size_t copied = static_cast<size_t>(len) < sizeof(entry.text) ? len : sizeof(entry.text) - 1;
+    memcpy(entry.text, format, copied);
+    entry.text[copied] = '\0';
+    rejected.fetch_add(1, std::memory_order_relaxed);
+  }
+  else
+  {
+    va_list args;
+    va_start(args, format);
+    len = vsnprintf(entry.text, sizeof(entry.text), format, args);
+    va_end(args);
+  }
+  entry.len = len < 0 ? 0 : len >= static_cast<int>(sizeof(entry.text)) ? sizeof(entry.text) - 1
+                                                                          : len;
+  // publish, claim() handed out the slot at sequence == position
+  slot->sequence.store(slot->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  written.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t log_drain(log_sink sink)
+{
+  size_t count = 0;
+  for (;;)
+  {
+    log_slot &slot = slots[read_position & (LOG_SLOTS - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != read_position + 1)
+    {
+      return count;
+    }
+    sink(slot.entry);
+    slot.sequence.store(read_position + LOG_SLOTS, std::memory_order_release);
+    read_position++;
+    count++;
+  }
+}
+
+log_stats get_log_stats()
+{
+  log_stats stats;
+  stats.written = written.load(std::memory_order_relaxed);
+  stats.dropped = dropped.load(std::memory_order_relaxed);
+  stats.rejected = rejected.load(std::memory_order_relaxed);
+  return stats;
+}
+
+const char *log_level_name(uint8_t level)
 {
-  Serial.println(message.c_str());
+  static const char *names[] = {"D", "I", "W", "E"};
+  return level < LOG_LEVEL_OFF ? names[level] : "?";
 }
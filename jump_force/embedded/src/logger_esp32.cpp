@@ -0,0 +1,56 @@
+#include <Arduino.h>
+
+#include <atomic>
+
+#include "logger.h"
+
+#define LOG_TASK_PRIORITY 1
+#define LOG_TASK_STACK 3072
+// writers never wake the drain task, it polls the ring this often
+#define LOG_DRAIN_MS 50
+// set by the BLE task once its characteristic exists, read by the drain task
+static std::atomic<log_sink> mirror{nullptr};
+static uint32_t reported_drops = 0;
+static uint32_t reported_rejects = 0;
+
+static void write_serial(const log_entry &entry)
+{
+  Serial.printf("[%u] %s ", static_cast<unsigned>(entry.t_ms), log_level_name(entry.level));
+  Serial.write(reinterpret_cast<const uint8_t *>(entry.text), entry.len);
+  Serial.println();
+  const log_sink sink = mirror.load(std::memory_order_acquire);
+  if (sink && entry.level >= LOG_MIRROR_LEVEL)
+  {
+    sink(entry);
+  }
+}
+
+static void log_main(void *params)
+{
+  for (;;)
+  {
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+    log_drain(write_serial);
+    const log_stats stats = get_log_stats();
+    if (stats.dropped != reported_drops)
+    {
+      Serial.printf("log,dropped,%u\n", static_cast<unsigned>(stats.dropped - reported_drops));
+      reported_drops = stats.dropped;
+    }
+    if (stats.rejected != reported_rejects)
+    {
+      Serial.printf("log,rejected,%u\n", static_cast<unsigned>(stats.rejected - reported_rejects));
+      reported_rejects = stats.rejected;
+    }
+  }
+}
+
+void setup_logging()
+{
+  xTaskCreate(log_main, "log_task", LOG_TASK_STACK, NULL, LOG_TASK_PRIORITY, NULL);
+}
+
+void set_log_mirror(log_sink sink)
+{
+  mirror.store(sink, std::memory_order_release);
+}
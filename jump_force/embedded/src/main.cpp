@@ -1,22 +1,60 @@
 #include <Arduino.h>
 
-#include <arduino-timer.h>
-
 #include "ble.h"
+#include "clients.h"
+#include "filter_bank.h"
+#include "jump_detector.h"
+#include "logger.h"
+#include "sampler.h"
 
 #define BAUD_RATE 115200
 
-Timer<> main_timer = timer_create_default();
+void raw_frame(const sample_record &frame)
+{
+  clients.push_raw(frame);
+}
+
+void window_frame(const sample_record &frame)
+{
+  clients.push_window(frame);
+}
+
+void filter_frame(const sample_record &frame)
+{
+  filters.push(frame);
+}
+
+void filtered_frame(const sample_record &frame)
+{
+  jumps.push(frame);
+  clients.push_filtered(frame);
+}
+
+void jump_done(const jump_summary &summary)
+{
+  clients.push_jump(summary);
+}
 
 void setup()
 {
   Serial.begin(BAUD_RATE);
+  setup_logging();
 
   setup_ble();
   delay(500);
+
+  jumps.begin(jump_done, JUMP_RAW_WINDOWS ? window_frame : nullptr);
+  filters.begin(filtered_frame);
+  sampler.add_consumer(raw_frame);
+  sampler.add_consumer(filter_frame);
+  if (!sampler.begin(SAMPLE_RATE_HZ))
+  {
+    LOG_ERROR("sampler failed to start");
+  }
 }
 
 void loop()
 {
-  main_timer.tick();
+  // everything runs in its own task, spinning here would keep core 1 busy
+  vTaskDelete(NULL);
 }
@@ -0,0 +1,103 @@
+#include "sampler.h"
+#include "logger.h"
+
+const sampler_channel adc_sampler::channels[ANALOG_CHANNELS] = ANALOG_CHANNEL_LIST;
+
+adc_sampler sampler;
+
+bool adc_sampler::begin(uint32_t rate_hz)
+{
+  period = 1000000 / rate_hz;
+  handled = ticks;
+  return sampler_hw_begin(*this);
+}
+
+bool adc_sampler::add_consumer(frame_consumer consumer)
+{
+  if (consumer_count >= SAMPLER_MAX_CONSUMERS)
+  {
+    return false;
+  }
+  consumers[consumer_count++] = consumer;
+  return true;
+}
+
+bool adc_sampler::sample()
+{
+  // the interrupt may fire again while these are read
+  uint32_t t_us;
+  uint32_t count;
+  do
+  {
+    count = ticks;
+    t_us = tick_us;
+  } while (count != ticks);
+
+  if (count == handled)
+  {
+    return false;
+  }
+  const uint32_t skipped = count - handled - 1;
+  missed += skipped;
+  if (skipped > 0)
+  {
+    LOG_WARN("sampler missed %u ticks", static_cast<unsigned>(skipped));
+  }
+
+  if (frames > 0)
+  {
+    // spread over the ticks in between when some were skipped
+    const uint32_t interval = (t_us - previous_us) / (skipped + 1);
+    const uint32_t jitter = interval > period ? interval - period : period - interval;
+    total_jitter_us += jitter;
+    if (jitter > max_jitter_us)
+    {
+      max_jitter_us = jitter;
+    }
+  }
+  handled = count;
+  previous_us = t_us;
+
+  sample_record &frame = pool[next];
+  next = (next + 1) % SAMPLER_POOL_FRAMES;
+  const uint32_t read_start = sampler_hw_micros();
+  frame.t_us = t_us;
+  for (uint8_t i = 0; i < ANALOG_CHANNELS; i++)
+  {
+    frame.values[i] = sampler_hw_read(channels[i].pin);
+  }
+  for (uint8_t i = ANALOG_CHANNELS; i < SAMPLE_CHANNELS; i++)
+  {
+    frame.values[i] = 0;
+  }
+  const uint32_t read_end = sampler_hw_micros();
+  last_read_us = read_end - read_start;
+  if (frames % VOLTAGE_READ_FRAMES == 0)
+  {
+    voltage_raw.store(sampler_hw_read(VOLTAGE_PIN), std::memory_order_relaxed);
+  }
+  frames++;
+
+  for (size_t i = 0; i < consumer_count; i++)
+  {
+    consumers[i](frame);
+  }
+  const uint32_t latency = sampler_hw_micros() - t_us;
+  if (latency > max_latency_us)
+  {
+    max_latency_us = latency;
+  }
+  return true;
+}
+
+sampler_stats adc_sampler::stats() const
+{
+  sampler_stats out;
+  out.frames = frames;
+  out.missed = missed;
+  out.avg_jitter_us = frames > 1 ? total_jitter_us / (frames - 1) : 0;
+  out.max_jitter_us = max_jitter_us;
+  out.max_latency_us = max_latency_us;
+  out.last_read_us = last_read_us;
+  return out;
+}
@@ -0,0 +1,86 @@
+#include <Arduino.h>
+#include <driver/adc.h>
+
+#include "sampler.h"
+
+// 80 MHz APB clock divided down to 1 us timer ticks
+#define SAMPLER_TIMER 0
+#define SAMPLER_TIMER_DIVIDER 80
+
+static hw_timer_t *timer = nullptr;
+static TaskHandle_t sample_task = nullptr;
+static adc_sampler *active = nullptr;
+
+static void IRAM_ATTR on_timer()
+{
+  active->tick(micros());
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(sample_task, &woken);
+  if (woken)
+  {
+    portYIELD_FROM_ISR();
+  }
+}
+
+static void sample_main(void *params)
+{
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while (active->sample())
+    {
+    }
+  }
+}
+
+// channels 0-7 are ADC1
+static bool config_channel(uint8_t pin)
+{
+  const int8_t channel = digitalPinToAnalogChannel(pin);
+  if (channel < 0 || channel > 7)
+  {
+    return false;
+  }
+  adc1_config_channel_atten(static_cast<adc1_channel_t>(channel), ADC_ATTEN_DB_11);
+  return true;
+}
+
+bool sampler_hw_begin(adc_sampler &sampler)
+{
+  active = &sampler;
+  adc1_config_width(ADC_WIDTH_BIT_12);
+  for (uint8_t i = 0; i < ANALOG_CHANNELS; i++)
+  {
+    if (!config_channel(adc_sampler::channels[i].pin))
+    {
+      return false;
+    }
+  }
+  if (!config_channel(VOLTAGE_PIN))
+  {
+    return false;
+  }
+
+  if (xTaskCreatePinnedToCore(sample_main, "sample_task", 4096, NULL, SAMPLE_TASK_PRIORITY,
+                              &sample_task, SAMPLE_CORE) != pdPASS)
+  {
+    return false;
+  }
+
+  timer = timerBegin(SAMPLER_TIMER, SAMPLER_TIMER_DIVIDER, true);
+  timerAttachInterrupt(timer, on_timer, true);
+  timerAlarmWrite(timer, sampler.period_us(), true);
+  timerAlarmEnable(timer);
+  return true;
+}
+
+// only ever called from the sampling task, it is ADC1's single user
+int16_t sampler_hw_read(uint8_t pin)
+{
+  return adc1_get_raw(static_cast<adc1_channel_t>(digitalPinToAnalogChannel(pin)));
+}
+
+uint32_t sampler_hw_micros()
+{
+  return micros();
+}
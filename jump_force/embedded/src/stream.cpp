@@ -0,0 +1,203 @@
+#include <Arduino.h>
+#include <string.h>
+
+#include "stream.h"
+
+void sample_stream::open(uint8_t reader, uint16_t conn_id, uint8_t feed, stream_send send, const time_sync *clock)
+{
+  this->reader = reader;
+  this->conn_id = conn_id;
+  this->feed = feed;
+  this->send = send;
+  this->clock = clock;
+  pending = 0;
+  sequence = 0;
+  stride = 1;
+  until_kept = 0;
+  behind = false;
+  dropped = 0;
+  decimated = 0;
+  samples_sent = 0;
+  packets_sent = 0;
+  total_latency_us = 0;
+  max_latency_us = 0;
+  high_water = 0;
+  rate_samples = 0;
+  rate_ms = millis();
+  apply_mtu();
+}
+
+void sample_stream::set_mtu(uint16_t mtu)
+{
+  this->mtu = mtu;
+}
+
+void sample_stream::apply_mtu()
+{
+  size_t payload = mtu > 3 ? mtu - 3 : 0;
+  payload = payload > STREAM_MAX_PAYLOAD ? STREAM_MAX_PAYLOAD : payload;
+  size_t count = payload > sizeof(stream_header) ? (payload - sizeof(stream_header)) / sizeof(sample_record) : 0;
+  per_packet = count > 255 ? 255 : count;
+}
+
+void sample_stream::adapt_stride(size_t waiting, uint32_t now_ms)
+{
+  if (waiting <= STREAM_DECIMATE_LAG)
+  {
+    behind = false;
+    if (waiting < STREAM_DECIMATE_LAG / 4 && stride > 1)
+    {
+      stride /= 2;
+    }
+    return;
+  }
+  if (!behind)
+  {
+    behind = true;
+    behind_ms = now_ms;
+  }
+  else if (now_ms - behind_ms >= STREAM_DECIMATE_MS && stride < STREAM_MAX_STRIDE)
+  {
+    stride *= 2;
+    behind_ms = now_ms;
+  }
+}
+
+void sample_stream::stamp(sample_record *records, size_t count)
+{
+  if (pending == 0)
+  {
+    first_us = records[0].t_us;
+    phone_time = clock && clock->synced();
+  }
+  for (size_t i = 0; phone_time && i < count; i++)
+  {
+    records[i].t_us = static_cast<uint32_t>(clock->to_phone(records[i].t_us));
+  }
+}
+
+size_t sample_stream::poll(sample_feed &source)
+{
+  const uint32_t packets_before = packets_sent;
+  size_t waiting = source.available(reader);
+  if (waiting > STREAM_MAX_LAG)
+  {
+    dropped += source.skip(reader, waiting - STREAM_MAX_LAG);
+    waiting = STREAM_MAX_LAG;
+  }
+  if (waiting > high_water)
+  {
+    high_water = waiting;
+  }
+  adapt_stride(waiting, millis());
+
+  // records are packed, so they can be popped in place behind the header
+  sample_record *records = reinterpret_cast<sample_record *>(packet + sizeof(stream_header));
+  for (;;)
+  {
+    if (pending == 0)
+    {
+      // the MTU only changes between packets
+      apply_mtu();
+      // the default 23 byte MTU cannot carry a sample, wait for the exchange
+      if (per_packet == 0)
+      {
+        dropped += source.skip(reader, STREAM_QUEUE_LENGTH);
+        return 0;
+      }
+    }
+    if (pending >= per_packet)
+    {
+      if (!send_packet())
+      {
+        return packets_sent - packets_before;
+      }
+      continue;
+    }
+    if (stride == 1)
+    {
+      const size_t popped = source.pop(reader, records + pending, per_packet - pending);
+      if (popped == 0)
+      {
+        break;
+      }
+      stamp(records + pending, popped);
+      pending += popped;
+      continue;
+    }
+    // decimated, every stride-th sample is kept
+    if (source.pop(reader, records + pending, 1) == 0)
+    {
+      break;
+    }
+    if (until_kept > 0)
+    {
+      until_kept--;
+      decimated++;
+      continue;
+    }
+    stamp(records + pending, 1);
+    pending++;
+    until_kept = stride - 1;
+  }
+  if (pending > 0 && micros() - first_us >= STREAM_FLUSH_MS * 1000UL)
+  {
+    send_packet();
+  }
+  return packets_sent - packets_before;
+}
+
+bool sample_stream::send_packet()
+{
+  stream_header header;
+  header.sequence = sequence;
+  header.count = pending;
+  header.channels = SAMPLE_CHANNELS | (phone_time ? STREAM_PHONE_TIME : 0);
+  memcpy(packet, &header, sizeof(header));
+
+  if (!send(conn_id, packet, sizeof(header) + pending * sizeof(sample_record)))
+  {
+    return false;
+  }
+  const uint32_t latency_us = micros() - first_us;
+
+  sequence++;
+  samples_sent += pending;
+  rate_samples += pending;
+  packets_sent++;
+  total_latency_us += latency_us;
+  if (latency_us > max_latency_us)
+  {
+    max_latency_us = latency_us;
+  }
+  pending = 0;
+  return true;
+}
+
+void sample_stream::discard()
+{
+  pending = 0;
+  until_kept = 0;
+}
+
+stream_stats sample_stream::stats(const sample_feed &source, uint32_t now_ms)
+{
+  stream_stats out;
+  out.samples_sent = samples_sent;
+  out.packets_sent = packets_sent;
+  out.samples_dropped = dropped;
+  out.queue_overflows = source.overflows();
+  const uint32_t elapsed_ms = now_ms - rate_ms;
+  out.samples_per_s = elapsed_ms > 0 ? static_cast<uint64_t>(rate_samples) * 1000 / elapsed_ms : 0;
+  out.avg_latency_us = packets_sent > 0 ? total_latency_us / packets_sent : 0;
+  out.max_latency_us = max_latency_us;
+  out.mtu = mtu;
+  out.samples_per_packet = per_packet;
+  out.queue_high_water = high_water;
+  out.samples_decimated = decimated;
+  out.stride = stride;
+  out.feed = feed;
+  rate_samples = 0;
+  rate_ms = now_ms;
+  return out;
+}
@@ -0,0 +1,156 @@
+#include <math.h>
+
+#include "time_sync.h"
+
+void time_sync::reset()
+{
+  in_group = 0;
+  next_point = 0;
+  points_used = 0;
+  offset = 0;
+  drift = 0;
+  oldest_x = 0;
+  fit_error_us = 0;
+  drift_error = TIME_SYNC_MAX_DRIFT_PPM * 1e-6;
+}
+
+void time_sync::add(uint64_t t1, uint32_t t2, uint32_t t3, uint64_t t4)
+{
+  // a phone clock that went backwards, or a reply it cannot have had yet
+  if (t4 < t1 || t4 - t1 < static_cast<uint32_t>(t3 - t2))
+  {
+    return;
+  }
+  group[in_group++] = exchange{t1, t2, t3, t4};
+  if (in_group == TIME_SYNC_GROUP)
+  {
+    points[next_point] = close_group();
+    next_point = (next_point + 1) % TIME_SYNC_POINTS;
+    if (points_used < TIME_SYNC_POINTS)
+    {
+      points_used++;
+    }
+    in_group = 0;
+  }
+  fit();
+}
+
+time_sync::point time_sync::close_group() const
+{
+  // relative to the group's first exchange, at its mean device time
+  const uint32_t base_device_us = group[0].t2;
+  const uint64_t base_phone_us = group[0].t1;
+  double mean_x = 0;
+  for (size_t i = 0; i < in_group; i++)
+  {
+    mean_x += static_cast<int32_t>(group[i].t2 - base_device_us) / static_cast<double>(in_group);
+  }
+  // the phone's lead over the device is above what each ping allows and
+  // below what each reply allows, once the drift found so far is taken out
+  double low = -INFINITY;
+  double high = INFINITY;
+  for (size_t i = 0; i < in_group; i++)
+  {
+    const exchange &e = group[i];
+    const double x2 = static_cast<int32_t>(e.t2 - base_device_us);
+    const double x3 = static_cast<int32_t>(e.t3 - base_device_us);
+    const double ping = static_cast<int64_t>(e.t1 - base_phone_us) - x2 - drift * (x2 - mean_x);
+    const double reply = static_cast<int64_t>(e.t4 - base_phone_us) - x3 - drift * (x3 - mean_x);
+    low = ping > low ? ping : low;
+    high = reply < high ? reply : high;
+  }
+  point p;
+  p.device_us = base_device_us + static_cast<int32_t>(lround(mean_x));
+  p.phone_us = base_phone_us + static_cast<int64_t>(llround(mean_x + (low + high) / 2));
+  p.half_range_us = high > low ? static_cast<uint32_t>(ceil((high - low) / 2)) : 0;
+  return p;
+}
+
+void time_sync::fit()
+{
+  // until the first group is complete the open one is all there is
+  point open;
+  const point *fitted[TIME_SYNC_POINTS];
+  size_t n = 0;
+  for (size_t i = 0; i < points_used; i++)
+  {
+    fitted[n++] = &points[(next_point + TIME_SYNC_POINTS - points_used + i) % TIME_SYNC_POINTS];
+  }
+  if (n == 0)
+  {
+    if (in_group == 0)
+    {
+      return;
+    }
+    open = close_group();
+    fitted[n++] = &open;
+  }
+
+  // relative to the newest point, x in device us and y the lead the phone's
+  // clock has gained over the device's since then
+  ref_device_us = fitted[n - 1]->device_us;
+  ref_phone_us = fitted[n - 1]->phone_us;
+  double x[TIME_SYNC_POINTS];
+  double y[TIME_SYNC_POINTS];
+  double mean_x = 0;
+  double mean_y = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    x[i] = static_cast<int32_t>(fitted[i]->device_us - ref_device_us);
+    y[i] = static_cast<double>(static_cast<int64_t>(fitted[i]->phone_us - ref_phone_us)) - x[i];
+    mean_x += x[i] / n;
+    mean_y += y[i] / n;
+  }
+  double sxx = 0;
+  double sxy = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    sxx += (x[i] - mean_x) * (x[i] - mean_x);
+    sxy += (x[i] - mean_x) * (y[i] - mean_y);
+  }
+  const bool has_drift = n >= 2 && sxx > 0;
+  // a few seconds of points can suggest more than any crystal does
+  const double max_drift = TIME_SYNC_MAX_DRIFT_PPM * 1e-6;
+  drift = has_drift ? sxy / sxx : 0;
+  drift = drift > max_drift ? max_drift : drift < -max_drift ? -max_drift : drift;
+  offset = mean_y - drift * mean_x;
+  oldest_x = static_cast<int32_t>(fitted[0]->device_us - ref_device_us);
+
+  // the truth at each point is within its half range of the point, the line
+  // within its residual
+  fit_error_us = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    const double error = fitted[i]->half_range_us + fabs(y[i] - offset - drift * x[i]);
+    fit_error_us = error > fit_error_us ? error : fit_error_us;
+  }
+  // a line off by that much at both ends of the fit
+  drift_error = TIME_SYNC_MAX_DRIFT_PPM * 1e-6;
+  if (has_drift && 2 * fit_error_us / -oldest_x < drift_error)
+  {
+    drift_error = 2 * fit_error_us / -oldest_x;
+  }
+}
+
+uint64_t time_sync::to_phone(uint32_t device_us) const
+{
+  if (!synced())
+  {
+    return device_us;
+  }
+  const double x = static_cast<int32_t>(device_us - ref_device_us);
+  return ref_phone_us + static_cast<int64_t>(llround(x + offset + drift * x));
+}
+
+uint32_t time_sync::error_us(uint32_t device_us) const
+{
+  if (!synced())
+  {
+    return UINT32_MAX;
+  }
+  // the line is only as good as the drift outside the points it was fitted to
+  const double x = static_cast<int32_t>(device_us - ref_device_us);
+  const double outside = x > 0 ? x : x < oldest_x ? oldest_x - x : 0;
+  const double error = ceil(fit_error_us + drift_error * outside);
+  return error < UINT32_MAX ? error : UINT32_MAX;
+}
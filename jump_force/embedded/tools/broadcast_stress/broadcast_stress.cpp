@@ -0,0 +1,247 @@
+/**
+ * @file broadcast_stress.cpp
+ *
+ * runs broadcast_queue between a producer thread and a consumer thread
+ * serving several readers, built with ThreadSanitizer, like the sampling
+ * task and the BLE task with its clients. readers 0 and 1 keep up and must
+ * see every item the producer got in. reader 2 is slow, is only served now
+ * and then and, like a slow link in stream.cpp, is skipped forward once it
+ * lags more than MAX_LAG items. reader 3 keeps attaching and detaching like
+ * a client reconnecting. every item read is checked for tearing and order,
+ * and the counts have to add up.
+ *
+ * usage: program [--count n] [--slow-every n] [--seed n]
+ *
+ * exits 1 when an item was bad or the counts do not add up, TSan exits 66
+ * on a data race.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <random>
+#include <thread>
+
+#include "broadcast_queue.h"
+
+#define QUEUE_LENGTH 64
+#define READERS 4
+#define POP_MAX 16
+// the slow reader is skipped down to half the ring, like STREAM_MAX_LAG
+#define MAX_LAG (QUEUE_LENGTH / 2)
+
+#define SLOW_READER 2
+#define RECONNECTING_READER 3
+
+struct item
+{
+  uint32_t sequence;
+  uint32_t words[7];
+};
+
+static item make_item(uint32_t sequence)
+{
+  item it;
+  it.sequence = sequence;
+  for (size_t i = 0; i < 7; i++)
+  {
+    it.words[i] = sequence * 2654435761u + i;
+  }
+  return it;
+}
+
+static bool intact(const item &it)
+{
+  for (size_t i = 0; i < 7; i++)
+  {
+    if (it.words[i] != it.sequence * 2654435761u + i)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct reader_result
+{
+  uint32_t read = 0;
+  uint32_t skipped = 0;
+  uint32_t torn = 0;
+  uint32_t reordered = 0;
+  uint32_t attaches = 0;
+  bool seen = false;
+  uint32_t last = 0;
+};
+
+static void check(reader_result &r, const item &it)
+{
+  r.torn += !intact(it);
+  r.reordered += r.seen && it.sequence <= r.last;
+  r.seen = true;
+  r.last = it.sequence;
+  r.read++;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t count = 2000000;
+  uint32_t slow_every = 8;
+  unsigned seed = 1;
+  for (int i = 1; i < argc; i++)
+  {
+    const bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--count") == 0 && has_value)
+    {
+      count = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--slow-every") == 0 && has_value)
+    {
+      slow_every = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--seed") == 0 && has_value)
+    {
+      seed = strtoul(argv[++i], nullptr, 10);
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [--count n] [--slow-every n] [--seed n]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (count < 1 || slow_every < 1)
+  {
+    fprintf(stderr, "--count and --slow-every must be at least 1\n");
+    return 1;
+  }
+
+  static broadcast_queue<item, QUEUE_LENGTH, READERS> queue;
+  std::atomic<bool> finished{false};
+  uint32_t pushed = 0;
+  uint32_t refused = 0;
+  reader_result readers[READERS];
+
+  // attached before the producer starts, so they are owed every item
+  for (size_t r = 0; r <= SLOW_READER; r++)
+  {
+    queue.attach(r);
+  }
+
+  std::thread producer([&]()
+                       {
+                         std::mt19937 rng(seed);
+                         for (uint32_t i = 0; i < count; i++)
+                         {
+                           if (queue.push(make_item(i)))
+                           {
+                             pushed++;
+                           }
+                           else
+                           {
+                             refused++;
+                           }
+                           if (rng() % 256 == 0)
+                           {
+                             std::this_thread::yield();
+                           }
+                         }
+                         // end marker, every reader that keeps up must get it
+                         while (!queue.push(make_item(count)))
+                         {
+                           std::this_thread::yield();
+                         }
+                         pushed++;
+                         finished.store(true, std::memory_order_release);
+                       });
+
+  std::thread consumer([&]()
+                       {
+                         std::mt19937 rng(seed + 1);
+                         item batch[POP_MAX];
+                         for (uint32_t round = 0;; round++)
+                         {
+                           const bool done = finished.load(std::memory_order_acquire);
+                           for (size_t r = 0; r < SLOW_READER; r++)
+                           {
+                             const size_t got = queue.pop(r, batch, 1 + rng() % POP_MAX);
+                             for (size_t i = 0; i < got; i++)
+                             {
+                               check(readers[r], batch[i]);
+                             }
+                           }
+
+                           reader_result &slow = readers[SLOW_READER];
+                           const size_t waiting = queue.available(SLOW_READER);
+                           if (waiting > MAX_LAG)
+                           {
+                             slow.skipped += queue.skip(SLOW_READER, waiting - MAX_LAG);
+                           }
+                           if (round % slow_every == 0 || done)
+                           {
+                             const size_t got = queue.pop(SLOW_READER, batch, 1 + rng() % 4);
+                             for (size_t i = 0; i < got; i++)
+                             {
+                               check(slow, batch[i]);
+                             }
+                           }
+
+                           // one item at a time through peek and skip, like the jump feed
+                           reader_result &flaky = readers[RECONNECTING_READER];
+                           if (queue.attached(RECONNECTING_READER))
+                           {
+                             item it;
+                             if (queue.peek(RECONNECTING_READER, it))
+                             {
+                               check(flaky, it);
+                               queue.skip(RECONNECTING_READER, 1);
+                             }
+                             if (rng() % 512 == 0)
+                             {
+                               queue.detach(RECONNECTING_READER);
+                             }
+                           }
+                           else if (rng() % 256 == 0)
+                           {
+                             queue.attach(RECONNECTING_READER);
+                             flaky.attaches++;
+                           }
+
+                           queue.release();
+
+                           bool drained = true;
+                           for (size_t r = 0; r < READERS; r++)
+                           {
+                             drained = drained && (!queue.attached(r) || queue.available(r) == 0);
+                           }
+                           if (done && drained)
+                           {
+                             return;
+                           }
+                         }
+                       });
+
+  producer.join();
+  consumer.join();
+
+  bool ok = refused + pushed == count + 1;
+  for (size_t r = 0; r < READERS; r++)
+  {
+    const reader_result &res = readers[r];
+    bool reader_ok = res.torn == 0 && res.reordered == 0;
+    if (r < SLOW_READER)
+    {
+      reader_ok = reader_ok && res.read == pushed && res.last == count;
+    }
+    else if (r == SLOW_READER)
+    {
+      reader_ok = reader_ok && res.read + res.skipped == pushed && res.last == count;
+    }
+    ok = ok && reader_ok;
+    printf("broadcast,reader=%u,read=%u,skipped=%u,torn=%u,reordered=%u,attaches=%u,%s\n",
+           static_cast<unsigned>(r), res.read, res.skipped, res.torn, res.reordered, res.attaches,
+           reader_ok ? "ok" : "FAIL");
+  }
+  printf("broadcast,pushed=%u,refused=%u,overflows=%u,%s\n", pushed, refused, queue.overflows(),
+         ok ? "ok" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,334 @@
+/**
+ * @file filter_bench.cpp
+ *
+ * runs the default flex (bandpass) and hall (lowpass) cascades through the
+ * float, Q15 and Q31 kernels and reports throughput (ns/sample per channel)
+ * and accuracy against a double precision reference designed with libm,
+ * so coefficient rounding and the constexpr design count as error.
+ *
+ * usage: program [--seconds s] [--block n] [--repeat n] [--seed n] [--json file]
+ *
+ * the input is a synthetic 12 bit signal at SAMPLE_RATE_HZ: a resting
+ * offset, a slow drift, squat sized bends, a 20 Hz tremor and ADC noise.
+ *
+ * exits 1 when a kernel's max error or SNR is outside its bound in
+ * kernel_bounds. Q15 is not run on designs with a highpass: at 0.2 Hz
+ * 1 + a1 + a2 is under two Q2.14 steps, so rounding the coefficients alone
+ * moves the corner by ~12% and the error reaches tens of counts.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "biquad.h"
+#include "config.h"
+#include "filter_bank.h"
+
+struct design
+{
+  const char *name;
+  bool q15;
+  // {highpass, fc, q} per stage
+  struct
+  {
+    bool highpass;
+    double fc;
+    double q;
+  } stages[FILTER_STAGES];
+};
+
+static const design designs[] = {
+    {"flex_bandpass", false, {{true, FLEX_HIGHPASS_HZ, 0.7071}, {false, FLEX_LOWPASS_HZ, 0.7071}}},
+    {"hall_lowpass", true, {{false, HALL_LOWPASS_HZ, 0.5412}, {false, HALL_LOWPASS_HZ, 1.3066}}},
+};
+
+// worst a kernel may do against the reference on any design it runs, in
+// counts. measured: float and Q31 ~0.7, Q15 ~2.8 on the lowpass
+struct kernel_bound
+{
+  const char *kernel;
+  double max_error;
+  double min_snr_db;
+};
+
+static const kernel_bound kernel_bounds[] = {
+    {"float", 1.5, 60},
+    {"q15", 5, 60},
+    {"q31", 1.5, 60},
+};
+
+struct result
+{
+  std::string design;
+  std::string kernel;
+  double ns_per_sample = 0;
+  double max_error = 0;
+  double rms_error = 0;
+  double snr_db = 0;
+  bool ok = false;
+};
+
+// reference: direct form I in double with coefficients from libm
+struct reference_biquad
+{
+  double b0, b1, b2, a1, a2;
+  double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
+  reference_biquad(bool highpass, double fs, double fc, double q)
+  {
+    const double w0 = 2 * M_PI * fc / fs;
+    const double alpha = sin(w0) / (2 * q);
+    const double c = cos(w0);
+    const double a0 = 1 + alpha;
+    b0 = (highpass ? (1 + c) / 2 : (1 - c) / 2) / a0;
+    b1 = (highpass ? -(1 + c) : 1 - c) / a0;
+    b2 = b0;
+    a1 = -2 * c / a0;
+    a2 = (1 - alpha) / a0;
+  }
+
+  void prime(double x)
+  {
+    const double y = x * (b0 + b1 + b2) / (1 + a1 + a2);
+    x1 = x2 = x;
+    y1 = y2 = y;
+  }
+
+  double step(double x)
+  {
+    const double y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+    x2 = x1;
+    x1 = x;
+    y2 = y1;
+    y1 = y;
+    return y;
+  }
+};
+
+static std::vector<int16_t> make_input(size_t n, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0, 4);
+  std::vector<int16_t> input(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    const double t = static_cast<double>(i) / SAMPLE_RATE_HZ;
+    const double phase = fmod(t, 3.0);
+    const double bend = phase > 1 && phase < 2 ? sin((phase - 1) * M_PI) : 0;
+    const double value = 900 + 100 * sin(2 * M_PI * 0.02 * t) + 1500 * bend +
+                         30 * sin(2 * M_PI * 20 * t) + noise(rng);
+    input[i] = static_cast<int16_t>(lround(value < 0 ? 0 : value > 4095 ? 4095
+                                                                        : value));
+  }
+  return input;
+}
+
+static std::vector<double> run_reference(const design &d, const std::vector<int16_t> &input)
+{
+  std::vector<reference_biquad> stages;
+  for (size_t s = 0; s < FILTER_STAGES; s++)
+  {
+    stages.emplace_back(d.stages[s].highpass, SAMPLE_RATE_HZ, d.stages[s].fc, d.stages[s].q);
+  }
+  double x0 = input[0];
+  for (reference_biquad &stage : stages)
+  {
+    stage.prime(x0);
+    x0 = x0 * (stage.b0 + stage.b1 + stage.b2) / (1 + stage.a1 + stage.a2);
+  }
+  std::vector<double> out(input.size());
+  for (size_t i = 0; i < input.size(); i++)
+  {
+    double x = input[i];
+    for (reference_biquad &stage : stages)
+    {
+      x = stage.step(x);
+    }
+    out[i] = x;
+  }
+  return out;
+}
+
+static biquad_coeffs constexpr_design(const design &d, size_t stage)
+{
+  return d.stages[stage].highpass ? biquad_highpass(SAMPLE_RATE_HZ, d.stages[stage].fc, d.stages[stage].q)
+                                  : biquad_lowpass(SAMPLE_RATE_HZ, d.stages[stage].fc, d.stages[stage].q);
+}
+
+template <typename T>
+static result run_kernel(const char *kernel_name, const design &d, const std::vector<int16_t> &input,
+                         const std::vector<double> &reference, size_t block, int repeat)
+{
+  typedef biquad_kernel<T> kernel;
+  const size_t n = input.size();
+  std::vector<T> converted(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    converted[i] = kernel::from_counts(input[i]);
+  }
+  std::vector<T> out(n);
+
+  biquad_cascade<T, FILTER_STAGES> cascade;
+  for (size_t s = 0; s < FILTER_STAGES; s++)
+  {
+    cascade.set(s, constexpr_design(d, s));
+  }
+
+  double best_ns = 0;
+  for (int r = 0; r < repeat; r++)
+  {
+    cascade.reset();
+    cascade.prime(converted[0]);
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i += block)
+    {
+      const size_t len = i + block <= n ? block : n - i;
+      cascade.process(&converted[i], &out[i], len);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    const double ns = std::chrono::duration<double, std::nano>(end - start).count() / n;
+    if (r == 0 || ns < best_ns)
+    {
+      best_ns = ns;
+    }
+  }
+
+  result res;
+  res.design = d.name;
+  res.kernel = kernel_name;
+  res.ns_per_sample = best_ns;
+  double error_sq = 0;
+  double signal_sq = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    // compared in counts, the unit that leaves the device
+    const double y = kernel::to_counts(out[i]);
+    const double error = y - reference[i];
+    error_sq += error * error;
+    signal_sq += reference[i] * reference[i];
+    res.max_error = fabs(error) > res.max_error ? fabs(error) : res.max_error;
+  }
+  res.rms_error = sqrt(error_sq / n);
+  res.snr_db = error_sq > 0 ? 10 * log10(signal_sq / error_sq) : INFINITY;
+  for (const kernel_bound &bound : kernel_bounds)
+  {
+    if (res.kernel == bound.kernel)
+    {
+      res.ok = res.max_error <= bound.max_error && res.snr_db >= bound.min_snr_db;
+    }
+  }
+  return res;
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: program [--seconds s] [--block n] [--repeat n] [--seed n] [--json file]\n");
+}
+
+int main(int argc, char **argv)
+{
+  double seconds = 600;
+  size_t block = FILTER_BLOCK;
+  int repeat = 5;
+  unsigned seed = 1;
+  std::string json_path;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value)
+    {
+      usage();
+      return 1;
+    }
+    if (strcmp(arg, "--seconds") == 0)
+    {
+      seconds = atof(value);
+    }
+    else if (strcmp(arg, "--block") == 0)
+    {
+      block = atoi(value);
+    }
+    else if (strcmp(arg, "--repeat") == 0)
+    {
+      repeat = atoi(value);
+    }
+    else if (strcmp(arg, "--seed") == 0)
+    {
+      seed = atoi(value);
+    }
+    else if (strcmp(arg, "--json") == 0)
+    {
+      json_path = value;
+    }
+    else
+    {
+      usage();
+      return 1;
+    }
+    i++;
+  }
+  const size_t n = static_cast<size_t>(seconds * SAMPLE_RATE_HZ);
+  if (n == 0 || block == 0 || repeat < 1)
+  {
+    usage();
+    return 1;
+  }
+
+  const std::vector<int16_t> input = make_input(n, seed);
+  std::vector<result> results;
+  for (const design &d : designs)
+  {
+    const std::vector<double> reference = run_reference(d, input);
+    results.push_back(run_kernel<float>("float", d, input, reference, block, repeat));
+    if (d.q15)
+    {
+      results.push_back(run_kernel<int16_t>("q15", d, input, reference, block, repeat));
+    }
+    results.push_back(run_kernel<int32_t>("q31", d, input, reference, block, repeat));
+  }
+
+  FILE *out = stdout;
+  if (!json_path.empty())
+  {
+    out = fopen(json_path.c_str(), "w");
+    if (!out)
+    {
+      fprintf(stderr, "could not write %s\n", json_path.c_str());
+      return 1;
+    }
+  }
+  fprintf(out, "{\n");
+  fprintf(out, "  \"samples\": %zu,\n", n);
+  fprintf(out, "  \"rate_hz\": %d,\n", SAMPLE_RATE_HZ);
+  fprintf(out, "  \"block\": %zu,\n", block);
+  fprintf(out, "  \"repeat\": %d,\n", repeat);
+  fprintf(out, "  \"filters\": [\n");
+  bool ok = true;
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const result &res = results[i];
+    if (!res.ok)
+    {
+      fprintf(stderr, "%s %s: max error %.3f, snr %.1f dB out of bounds\n", res.design.c_str(), res.kernel.c_str(),
+              res.max_error, res.snr_db);
+      ok = false;
+    }
+    fprintf(out, "    {\"design\": \"%s\", \"kernel\": \"%s\", \"ns_per_sample\": %.2f, ", res.design.c_str(),
+            res.kernel.c_str(), res.ns_per_sample);
+    fprintf(out, "\"max_error\": %.3f, \"rms_error\": %.4f, \"snr_db\": %.1f, \"ok\": %s}%s\n", res.max_error,
+            res.rms_error, res.snr_db, res.ok ? "true" : "false", i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  if (out != stdout)
+  {
+    fclose(out);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,372 @@
+/**
+ * @file format_bench.cpp
+ *
+ * formats the firmware's typical messages with fixed_string, a shared
+ * std::ostringstream cleared between uses (the old global ss), a fresh
+ * std::ostringstream per message and snprintf, and reports ns and heap
+ * allocations per format. every result is checked against fixed_string's
+ * output so the comparison is between equal strings.
+ *
+ * usage: program [--count n] [--repeat n] [--json file]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <iomanip>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "fixed_string.h"
+
+static size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+  allocations++;
+  void *p = malloc(size ? size : 1);
+  if (!p)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+// inputs vary per iteration so nothing is folded at compile time
+struct message
+{
+  unsigned voltage;
+  unsigned sequence;
+  unsigned flight_ms;
+  int height_mm;
+  float hz;
+};
+
+static std::vector<message> make_messages(size_t n)
+{
+  std::vector<message> messages(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    messages[i].voltage = 3000 + (i * 7) % 1200;
+    messages[i].sequence = i;
+    messages[i].flight_ms = 300 + (i * 13) % 200;
+    messages[i].height_mm = 100 + (i * 11) % 300;
+    messages[i].hz = 119.5f + (i % 100) / 100.0f;
+  }
+  return messages;
+}
+
+enum format_case
+{
+  VOLTAGE,
+  JUMP,
+  RATE,
+};
+
+static const char *case_names[] = {"voltage", "jump", "rate"};
+
+// output of one format, kept so the optimiser cannot drop the work
+static std::string last;
+static size_t checksum = 0;
+
+static void fixed_message(fixed_string<64> &out, format_case c, const message &m)
+{
+  switch (c)
+  {
+  case VOLTAGE:
+    out << m.voltage;
+    break;
+  case JUMP:
+    out << "jump " << m.sequence << ": flight " << m.flight_ms << " ms, " << m.height_mm << " mm";
+    break;
+  case RATE:
+    out << "sampling at " << m.hz << " Hz";
+    break;
+  }
+}
+
+struct fixed_formatter
+{
+  static const char *name()
+  {
+    return "fixed_string";
+  }
+
+  size_t format(format_case c, const message &m)
+  {
+    fixed_string<64> out;
+    fixed_message(out, c, m);
+    checksum += out.size() + out.c_str()[0];
+    return out.size();
+  }
+
+  const char *text(format_case c, const message &m)
+  {
+    fixed_string<64> out;
+    fixed_message(out, c, m);
+    last = out.c_str();
+    return last.c_str();
+  }
+};
+
+static void stream_message(std::ostringstream &out, format_case c, const message &m)
+{
+  switch (c)
+  {
+  case VOLTAGE:
+    out << m.voltage;
+    break;
+  case JUMP:
+    out << "jump " << m.sequence << ": flight " << m.flight_ms << " ms, " << m.height_mm << " mm";
+    break;
+  case RATE:
+    out << "sampling at " << std::fixed << std::setprecision(2) << m.hz << " Hz";
+    break;
+  }
+}
+
+struct shared_stream_formatter
+{
+  std::ostringstream ss;
+
+  static const char *name()
+  {
+    return "shared_ostringstream";
+  }
+
+  size_t format(format_case c, const message &m)
+  {
+    ss.str("");
+    ss.clear();
+    stream_message(ss, c, m);
+    // reading the result is part of the cost, it is what gets sent
+    const std::string out = ss.str();
+    checksum += out.size() + out[0];
+    return out.size();
+  }
+
+  const char *text(format_case c, const message &m)
+  {
+    ss.str("");
+    ss.clear();
+    stream_message(ss, c, m);
+    last = ss.str();
+    return last.c_str();
+  }
+};
+
+struct local_stream_formatter
+{
+  static const char *name()
+  {
+    return "local_ostringstream";
+  }
+
+  size_t format(format_case c, const message &m)
+  {
+    std::ostringstream ss;
+    stream_message(ss, c, m);
+    const std::string out = ss.str();
+    checksum += out.size() + out[0];
+    return out.size();
+  }
+
+  const char *text(format_case c, const message &m)
+  {
+    std::ostringstream ss;
+    stream_message(ss, c, m);
+    last = ss.str();
+    return last.c_str();
+  }
+};
+
+static int print_message(char *out, size_t size, format_case c, const message &m)
+{
+  switch (c)
+  {
+  case VOLTAGE:
+    return snprintf(out, size, "%u", m.voltage);
+  case JUMP:
+    return snprintf(out, size, "jump %u: flight %u ms, %d mm", m.sequence, m.flight_ms, m.height_mm);
+  case RATE:
+    return snprintf(out, size, "sampling at %.2f Hz", m.hz);
+  }
+  return 0;
+}
+
+struct snprintf_formatter
+{
+  static const char *name()
+  {
+    return "snprintf";
+  }
+
+  size_t format(format_case c, const message &m)
+  {
+    char out[64];
+    const int len = print_message(out, sizeof(out), c, m);
+    checksum += len + out[0];
+    return len;
+  }
+
+  const char *text(format_case c, const message &m)
+  {
+    char out[64];
+    print_message(out, sizeof(out), c, m);
+    last = out;
+    return last.c_str();
+  }
+};
+
+struct result
+{
+  std::string formatter;
+  std::string format;
+  double ns_per_format = 0;
+  double allocations_per_format = 0;
+  size_t mismatches = 0;
+};
+
+template <typename formatter>
+static result run(formatter &f, format_case c, const std::vector<message> &messages, int repeat)
+{
+  result res;
+  res.formatter = f.name();
+  res.format = case_names[c];
+
+  fixed_formatter reference;
+  for (const message &m : messages)
+  {
+    const std::string expected = reference.text(c, m);
+    if (expected != f.text(c, m))
+    {
+      res.mismatches++;
+    }
+  }
+
+  for (int r = 0; r < repeat; r++)
+  {
+    const size_t allocations_before = allocations;
+    const auto start = std::chrono::steady_clock::now();
+    for (const message &m : messages)
+    {
+      f.format(c, m);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    const double ns = std::chrono::duration<double, std::nano>(end - start).count() / messages.size();
+    if (r == 0 || ns < res.ns_per_format)
+    {
+      res.ns_per_format = ns;
+    }
+    res.allocations_per_format = static_cast<double>(allocations - allocations_before) / messages.size();
+  }
+  return res;
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: program [--count n] [--repeat n] [--json file]\n");
+}
+
+int main(int argc, char **argv)
+{
+  size_t count = 200000;
+  int repeat = 5;
+  std::string json_path;
+  for (int i = 1; i < argc; i++)
+  {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value)
+    {
+      usage();
+      return 1;
+    }
+    if (strcmp(arg, "--count") == 0)
+    {
+      count = atoi(value);
+    }
+    else if (strcmp(arg, "--repeat") == 0)
+    {
+      repeat = atoi(value);
+    }
+    else if (strcmp(arg, "--json") == 0)
+    {
+      json_path = value;
+    }
+    else
+    {
+      usage();
+      return 1;
+    }
+    i++;
+  }
+  if (count == 0 || repeat < 1)
+  {
+    usage();
+    return 1;
+  }
+
+  const std::vector<message> messages = make_messages(count);
+  std::vector<result> results;
+  fixed_formatter fixed;
+  shared_stream_formatter shared;
+  local_stream_formatter local;
+  snprintf_formatter printed;
+  for (int c = VOLTAGE; c <= RATE; c++)
+  {
+    const format_case fc = static_cast<format_case>(c);
+    results.push_back(run(fixed, fc, messages, repeat));
+    results.push_back(run(shared, fc, messages, repeat));
+    results.push_back(run(local, fc, messages, repeat));
+    results.push_back(run(printed, fc, messages, repeat));
+  }
+
+  FILE *out = stdout;
+  if (!json_path.empty())
+  {
+    out = fopen(json_path.c_str(), "w");
+    if (!out)
+    {
+      fprintf(stderr, "could not write %s\n", json_path.c_str());
+      return 1;
+    }
+  }
+  fprintf(out, "{\n");
+  fprintf(out, "  \"count\": %zu,\n", count);
+  fprintf(out, "  \"repeat\": %d,\n", repeat);
+  fprintf(out, "  \"checksum\": %zu,\n", checksum);
+  fprintf(out, "  \"formats\": [\n");
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const result &res = results[i];
+    fprintf(out, "    {\"format\": \"%s\", \"formatter\": \"%s\", \"ns_per_format\": %.1f, ", res.format.c_str(),
+            res.formatter.c_str(), res.ns_per_format);
+    fprintf(out, "\"allocations_per_format\": %.2f, \"mismatches\": %zu}%s\n", res.allocations_per_format,
+            res.mismatches, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  if (out != stdout)
+  {
+    fclose(out);
+  }
+  bool ok = true;
+  for (const result &res : results)
+  {
+    ok = ok && res.mismatches == 0;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+/**
+ * @file spsc_stress.cpp
+ *
+ * runs spsc_queue between a producer and a consumer thread, built with
+ * ThreadSanitizer, and checks every item the consumer gets: none torn,
+ * none reordered, and none lost except the pushes the queue refused. two
+ * passes: a producer that drops items when the queue is full, like the
+ * sampler, and one that retries until every item went through.
+ *
+ * usage: program [--count n] [--seed n]
+ *
+ * exits 1 when an item was bad or the counts do not add up, TSan
+ * exits 66 on a data race.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <random>
+#include <thread>
+
+#include "spsc_queue.h"
+
+#define QUEUE_LENGTH 64
+#define POP_MAX 16
+
+// wide enough that a torn copy shows up as a mismatched word
+struct item
+{
+  uint32_t sequence;
+  uint32_t words[7];
+};
+
+static item make_item(uint32_t sequence)
+{
+  item it;
+  it.sequence = sequence;
+  for (size_t i = 0; i < 7; i++)
+  {
+    it.words[i] = sequence * 2654435761u + i;
+  }
+  return it;
+}
+
+static bool intact(const item &it)
+{
+  for (size_t i = 0; i < 7; i++)
+  {
+    if (it.words[i] != it.sequence * 2654435761u + i)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct pass_result
+{
+  uint32_t pushed = 0;
+  // refused pushes before the end marker
+  uint32_t refused = 0;
+  uint32_t popped = 0;
+  uint32_t torn = 0;
+  uint32_t reordered = 0;
+  uint32_t gaps = 0;
+  uint32_t cleared = 0;
+};
+
+// retry: the producer spins until each push is taken, so every item must
+// arrive in sequence. otherwise refused pushes are dropped and the
+// consumer also clear()s now and then. either way the producer ends with
+// item count as a marker
+static bool run_pass(const char *name, uint32_t count, bool retry, unsigned seed)
+{
+  spsc_queue<item, QUEUE_LENGTH> queue;
+  std::atomic<bool> finished{false};
+  pass_result res;
+
+  std::thread producer([&]()
+                       {
+                         std::mt19937 rng(seed);
+                         for (uint32_t i = 0; i < count; i++)
+                         {
+                           const item it = make_item(i);
+                           if (retry)
+                           {
+                             while (!queue.push(it))
+                             {
+                               std::this_thread::yield();
+                             }
+                             res.pushed++;
+                           }
+                           else if (queue.push(it))
+                           {
+                             res.pushed++;
+                           }
+                           else
+                           {
+                             res.refused++;
+                           }
+                           // bursts, then a pause, like a sampler and a slow radio
+                           if (rng() % 256 == 0)
+                           {
+                             std::this_thread::yield();
+                           }
+                         }
+                         while (!queue.push(make_item(count)))
+                         {
+                           std::this_thread::yield();
+                         }
+                         res.pushed++;
+                         finished.store(true, std::memory_order_release);
+                       });
+
+  std::thread consumer([&]()
+                       {
+                         std::mt19937 rng(seed + 1);
+                         item batch[POP_MAX];
+                         bool first = true;
+                         uint32_t last = 0;
+                         for (;;)
+                         {
+                           // read before popping, so an empty queue after it means the end
+                           // marker was popped or cleared
+                           const bool done = finished.load(std::memory_order_acquire);
+                           size_t got = 0;
+                           if (!retry && rng() % 1024 == 0)
+                           {
+                             res.cleared += queue.clear();
+                           }
+                           else if (rng() % 2 == 0)
+                           {
+                             got = queue.pop(batch[0]) ? 1 : 0;
+                           }
+                           else
+                           {
+                             got = queue.pop(batch, 1 + rng() % POP_MAX);
+                           }
+                           for (size_t i = 0; i < got; i++)
+                           {
+                             const item &it = batch[i];
+                             res.torn += !intact(it);
+                             if (!first)
+                             {
+                               res.reordered += it.sequence <= last;
+                               res.gaps += retry && it.sequence != last + 1;
+                             }
+                             first = false;
+                             last = it.sequence;
+                             res.popped++;
+                           }
+                           if ((!first && last == count) || (done && queue.size() == 0))
+                           {
+                             return;
+                           }
+                           if (got == 0)
+                           {
+                             std::this_thread::yield();
+                           }
+                         }
+                       });
+
+  producer.join();
+  consumer.join();
+
+  // every accepted push was popped or cleared, and without retries every
+  // item was either accepted or refused
+  const bool counts_ok = res.pushed == res.popped + res.cleared && queue.size() == 0 &&
+                         (retry ? res.pushed == count + 1 : res.pushed - 1 + res.refused == count);
+  const bool ok = counts_ok && res.torn == 0 && res.reordered == 0 && res.gaps == 0;
+  printf("spsc,%s,pushed=%u,refused=%u,popped=%u,cleared=%u,overflows=%u,high_water=%u,torn=%u,"
+         "reordered=%u,gaps=%u,%s\n",
+         name, res.pushed, res.refused, res.popped, res.cleared, queue.overflows(), queue.high_water(),
+         res.torn, res.reordered, res.gaps, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t count = 2000000;
+  unsigned seed = 1;
+  for (int i = 1; i < argc; i++)
+  {
+    const bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--count") == 0 && has_value)
+    {
+      count = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--seed") == 0 && has_value)
+    {
+      seed = strtoul(argv[++i], nullptr, 10);
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [--count n] [--seed n]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (count < 2)
+  {
+    fprintf(stderr, "--count must be at least 2\n");
+    return 1;
+  }
+
+  bool ok = run_pass("lossy", count, false, seed);
+  ok = run_pass("retry", count, true, seed) && ok;
+  return ok ? 0 : 1;
+}